@@ -47,6 +47,7 @@
 #include <KoStoreDevice.h>
 
 #include <klocalizedstring.h>
+#include <kundo2commandextradata.h>
 #include <kis_debug.h>
 #include <kdesktopfile.h>
 #include <kconfiggroup.h>
@@ -62,6 +63,7 @@
 #include <QDomElement>
 #include <QFileInfo>
 #include <QImage>
+#include <QHash>
 #include <QList>
 #include <QPainter>
 #include <QRect>
@@ -69,10 +71,12 @@
 #include <QSize>
 #include <QStringList>
 #include <QtGlobal>
+#include <QThread>
 #include <QTimer>
 #include <QWidget>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QtConcurrent>
 
 // Krita Image
 #include <kis_config.h>
@@ -87,6 +91,7 @@
 #include <kis_selection.h>
 #include <kis_fill_painter.h>
 #include <kis_document_undo_store.h>
+#include <kis_memory_statistics_server.h>
 #include <kis_painting_assistants_decoration.h>
 #include <kis_idle_watcher.h>
 #include <kis_signal_auto_connection.h>
@@ -135,6 +140,129 @@ using namespace std;
 namespace {
 constexpr int errorMessageTimeout = 5000;
 constexpr int successMessageTimeout = 1000;
+
+struct PreviewPatchJob
+{
+    KisPaintDeviceSP device;
+    QRect srcRect;
+    int step;
+    QImage result;
+};
+
+/**
+ * Reduces the patch by averaging square blocks of job.step x job.step
+ * pixels. The blocks on the right and bottom edges may be incomplete.
+ */
+void reducePreviewPatch(PreviewPatchJob &job)
+{
+    const QImage src =
+        job.device->convertToQImage(0, job.srcRect.x(), job.srcRect.y(),
+                                    job.srcRect.width(), job.srcRect.height())
+        .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const int step = job.step;
+    const int srcWidth = job.srcRect.width();
+    const int srcHeight = job.srcRect.height();
+    const int dstWidth = (srcWidth + step - 1) / step;
+    const int dstHeight = (srcHeight + step - 1) / step;
+
+    job.result = QImage(dstWidth, dstHeight, QImage::Format_ARGB32_Premultiplied);
+
+    QVector<quint64> sums(dstWidth * 4);
+
+    for (int dstY = 0; dstY < dstHeight; dstY++) {
+        sums.fill(0);
+
+        const int firstRow = dstY * step;
+        const int numRows = qMin(step, srcHeight - firstRow);
+
+        for (int y = firstRow; y < firstRow + numRows; y++) {
+            const QRgb *srcLine = reinterpret_cast<const QRgb*>(src.constScanLine(y));
+
+            for (int x = 0; x < srcWidth; x++) {
+                const QRgb pixel = srcLine[x];
+                quint64 *sum = sums.data() + (x / step) * 4;
+
+                sum[0] += qRed(pixel);
+                sum[1] += qGreen(pixel);
+                sum[2] += qBlue(pixel);
+                sum[3] += qAlpha(pixel);
+            }
+        }
+
+        QRgb *dstLine = reinterpret_cast<QRgb*>(job.result.scanLine(dstY));
+
+        for (int dstX = 0; dstX < dstWidth; dstX++) {
+            const int numColumns = qMin(step, srcWidth - dstX * step);
+            const quint64 count = numRows * numColumns;
+            const quint64 *sum = sums.constData() + dstX * 4;
+
+            dstLine[dstX] = qRgba((sum[0] + count / 2) / count,
+                                  (sum[1] + count / 2) / count,
+                                  (sum[2] + count / 2) / count,
+                                  (sum[3] + count / 2) / count);
+        }
+    }
+}
+
+/**
+ * Scales \p bounds of \p device down to \p size. The area is first
+ * reduced by the biggest power-of-two factor that keeps it not smaller
+ * than \p size. The reduction is done in patches in parallel, so we
+ * never have to keep the whole area in memory as a QImage. The rest
+ * of the scaling is done by QImage on a much smaller image.
+ */
+QImage generateScaledPreview(KisPaintDeviceSP device, const QRect &bounds, const QSize &size)
+{
+    if (size.isEmpty() || bounds.isEmpty()) return QImage();
+
+    int levels = 0;
+    while ((bounds.width() >> (levels + 1)) >= size.width() &&
+           (bounds.height() >> (levels + 1)) >= size.height()) {
+
+        levels++;
+    }
+
+    if (!levels) {
+        return device->convertToQImage(0, bounds.x(), bounds.y(), bounds.width(), bounds.height())
+            .scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    const int step = 1 << levels;
+    const int patchSize = qMax(1, 512 / step) * step;
+
+    QVector<PreviewPatchJob> jobs;
+
+    for (int y = 0; y < bounds.height(); y += patchSize) {
+        for (int x = 0; x < bounds.width(); x += patchSize) {
+            PreviewPatchJob job;
+            job.device = device;
+            job.srcRect = QRect(bounds.x() + x, bounds.y() + y,
+                                qMin(patchSize, bounds.width() - x),
+                                qMin(patchSize, bounds.height() - y));
+            job.step = step;
+            jobs.append(job);
+        }
+    }
+
+    QtConcurrent::blockingMap(jobs, reducePreviewPatch);
+
+    QImage reduced((bounds.width() + step - 1) / step,
+                   (bounds.height() + step - 1) / step,
+                   QImage::Format_ARGB32_Premultiplied);
+
+    QPainter gc(&reduced);
+    gc.setCompositionMode(QPainter::CompositionMode_Source);
+
+    Q_FOREACH (const PreviewPatchJob &job, jobs) {
+        gc.drawImage((job.srcRect.topLeft() - bounds.topLeft()) / step, job.result);
+    }
+    gc.end();
+
+    return reduced.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+        .convertToFormat(QImage::Format_ARGB32);
+}
+
 }
 
 
@@ -153,6 +281,22 @@ QString KisDocument::newObjectName()
 }
 
 
+/**
+ * The amount of undo data an undo step created. It is attached to
+ * the step when the step is pushed to the stack, so it lives and dies
+ * together with the step.
+ */
+struct UndoStepMemoryData : public KUndo2CommandExtraData
+{
+    UndoStepMemoryData(qint64 _size) : size(_size) {}
+
+    KUndo2CommandExtraData* clone() const {
+        return new UndoStepMemoryData(size.load());
+    }
+
+    QAtomicInteger<qint64> size;
+};
+
 class UndoStack : public KUndo2Stack
 {
 public:
@@ -167,6 +311,7 @@ public:
         image->requestStrokeCancellation();
         if(image->tryBarrierLock()) {
             KUndo2Stack::setIndex(idx);
+            resetUndoStepMemory();
             image->unlock();
         }
     }
@@ -195,6 +340,7 @@ public:
 
         if(image->tryBarrierLock()) {
             KUndo2Stack::undo();
+            resetUndoStepMemory();
             image->unlock();
         }
     }
@@ -203,10 +349,73 @@ public:
         KisImageWSP image = this->image();
         if(image->tryBarrierLock()) {
             KUndo2Stack::redo();
+            resetUndoStepMemory();
             image->unlock();
         }
     }
 
+    /**
+     * Pushes \p command and attaches the undo data it has created to
+     * it. The data is measured on the thread that adds the command,
+     * right after the command has been executed, as the growth of the
+     * historical tile data since the previous step of this document.
+     */
+    void pushMeasured(KUndo2Command *command) {
+        m_pendingStepMemory += takeHistoricalMemoryGrowth();
+
+        if (m_macroDepth) {
+            push(command);
+            return;
+        }
+
+        const qint64 stepSize = m_pendingStepMemory;
+        m_pendingStepMemory = 0;
+
+        // the command is not visible to the GUI yet
+        if (!command->extraData()) {
+            command->setExtraData(new UndoStepMemoryData(stepSize));
+        }
+
+        push(command);
+
+        // the command has been merged into the previous step
+        const KUndo2Command *presentCommand = this->command(index() - 1);
+        if (presentCommand && presentCommand != command) {
+            addStepMemory(presentCommand, stepSize);
+        }
+    }
+
+    void beginMeasuredMacro(const KUndo2MagicString &text) {
+        m_macroDepth++;
+        beginMacro(text);
+    }
+
+    void endMeasuredMacro() {
+        m_pendingStepMemory += takeHistoricalMemoryGrowth();
+        endMacro();
+
+        KIS_SAFE_ASSERT_RECOVER_RETURN(m_macroDepth > 0);
+        if (--m_macroDepth) return;
+
+        const qint64 stepSize = m_pendingStepMemory;
+        m_pendingStepMemory = 0;
+
+        const KUndo2Command *presentCommand = this->command(index() - 1);
+        if (!presentCommand) return;
+
+        if (!presentCommand->extraData()) {
+            const_cast<KUndo2Command*>(presentCommand)->setExtraData(new UndoStepMemoryData(stepSize));
+        } else {
+            addStepMemory(presentCommand, stepSize);
+        }
+    }
+
+    static qint64 stepMemory(const KUndo2Command *command) {
+        const UndoStepMemoryData *data =
+            command ? dynamic_cast<const UndoStepMemoryData*>(command->extraData()) : 0;
+        return data ? data->size.load() : 0;
+    }
+
 private:
     KisImageWSP image() {
         KisImageWSP currentImage = m_doc->image();
@@ -214,8 +423,40 @@ private:
         return currentImage;
     }
 
+    static qint64 historicalMemorySize() {
+        return KisMemoryStatisticsServer::instance()->fetchMemoryStatistics(0).historicalMemorySize;
+    }
+
+    qint64 takeHistoricalMemoryGrowth() {
+        const qint64 currentSize = historicalMemorySize();
+        const qint64 growth = qMax(Q_INT64_C(0), currentSize - m_lastHistoricalMemorySize);
+        m_lastHistoricalMemorySize = currentSize;
+        return growth;
+    }
+
+    /**
+     * Undo and redo move the tile data in and out of the history. They
+     * are executed under the barrier lock of the image, so no stroke
+     * can be adding data at the same time.
+     */
+    void resetUndoStepMemory() {
+        if (!m_macroDepth) {
+            m_lastHistoricalMemorySize = historicalMemorySize();
+        }
+    }
+
+    static void addStepMemory(const KUndo2Command *command, qint64 size) {
+        const UndoStepMemoryData *data = dynamic_cast<const UndoStepMemoryData*>(command->extraData());
+        if (data) {
+            const_cast<UndoStepMemoryData*>(data)->size.fetchAndAddOrdered(size);
+        }
+    }
+
 private:
     KisDocument *m_doc;
+    qint64 m_lastHistoricalMemorySize = 0;
+    qint64 m_pendingStepMemory = 0;
+    int m_macroDepth = 0;
 };
 
 class Q_DECL_HIDDEN KisDocument::Private
@@ -289,7 +530,7 @@ public:
     bool isAutosaving = false;
     bool disregardAutosaveFailure = false;
 
-    KUndo2Stack *undoStack = 0;
+    UndoStack *undoStack = 0;
 
     KisGuidesConfig guidesConfig;
 
@@ -331,8 +572,20 @@ public:
 
     bool batchMode { false };
 
+    /**
+     * Incremented on every change of the image. The previews are
+     * cached only for the current revision.
+     */
+    QAtomicInt imageRevision;
+    QMutex previewCacheLock;
+    int previewCacheRevision = -1;
+    QHash<QPair<int, int>, QImage> previewCache;
+
+    QImage fetchPreview(KisImageSP image, const QSize &size);
+
     void setImageAndInitIdleWatcher(KisImageSP _image) {
         image = _image;
+        imageRevision.ref();
 
         imageIdleWatcher.setTrackedImage(image);
 
@@ -394,11 +647,55 @@ private:
     KisImageBarrierLockAdapter m_imageLock;
 };
 
+QImage KisDocument::Private::fetchPreview(KisImageSP image, const QSize &size)
+{
+    const QPair<int, int> key(size.width(), size.height());
+    const int revision = imageRevision.load();
+
+    /**
+     * The revision is incremented as soon as the image is changed, but
+     * the projection is updated asynchronously afterwards. The preview
+     * of a busy image may show the old projection, so it should not be
+     * cached under the new revision.
+     */
+    const bool imageWasIdle = image->isIdle(true);
+
+    {
+        QMutexLocker locker(&previewCacheLock);
+
+        if (previewCacheRevision != revision) {
+            previewCache.clear();
+            previewCacheRevision = revision;
+        }
+
+        auto it = previewCache.constFind(key);
+        if (it != previewCache.constEnd()) {
+            return it.value();
+        }
+    }
+
+    const QImage preview = generateScaledPreview(image->projection(), image->bounds(), size);
+
+    if (!imageWasIdle || !image->isIdle(true) ||
+        imageRevision.load() != revision) {
+
+        return preview;
+    }
+
+    QMutexLocker locker(&previewCacheLock);
+    if (previewCacheRevision == revision) {
+        previewCache.insert(key, preview);
+    }
+
+    return preview;
+}
+
 KisDocument::KisDocument()
     : d(new Private(this))
 {
     connect(KisConfigNotifier::instance(), SIGNAL(configChanged()), SLOT(slotConfigChanged()));
     connect(d->undoStack, SIGNAL(cleanChanged(bool)), this, SLOT(slotUndoStackCleanChanged(bool)));
+    connect(d->undoStack, SIGNAL(indexChanged(int)), this, SLOT(slotUndoStackIndexChanged()));
     connect(&d->autoSaveTimer, SIGNAL(timeout()), this, SLOT(slotAutoSave()));
     setObjectName(newObjectName());
 
@@ -417,6 +714,7 @@ KisDocument::KisDocument(const KisDocument &rhs)
 {
     connect(KisConfigNotifier::instance(), SIGNAL(configChanged()), SLOT(slotConfigChanged()));
     connect(d->undoStack, SIGNAL(cleanChanged(bool)), this, SLOT(slotUndoStackCleanChanged(bool)));
+    connect(d->undoStack, SIGNAL(indexChanged(int)), this, SLOT(slotUndoStackIndexChanged()));
     connect(&d->autoSaveTimer, SIGNAL(timeout()), this, SLOT(slotAutoSave()));
     setObjectName(rhs.objectName());
 
@@ -429,6 +727,16 @@ KisDocument::KisDocument(const KisDocument &rhs)
     // NOTE: we expect the image to be locked!
     setCurrentImage(rhs.image()->clone(true));
 
+    {
+        // the cloned image is identical to the original one, so its previews are still valid
+        QMutexLocker locker(&rhs.d->previewCacheLock);
+
+        if (rhs.d->previewCacheRevision == rhs.d->imageRevision.load()) {
+            d->previewCache = rhs.d->previewCache;
+            d->previewCacheRevision = d->imageRevision.load();
+        }
+    }
+
     if (rhs.d->preActivatedNode) {
         // since we clone uuid's, we can use them for lacating new
         // nodes. Otherwise we would need to use findSymmetricClone()
@@ -680,6 +988,46 @@ bool KisDocument::exportDocumentSync(const QUrl &url, const QByteArray &mimeType
     return status == KisImportExportFilter::OK;
 }
 
+QFuture<KisImportExportFilter::ConversionStatus>
+KisDocument::exportDocumentConcurrently(const QUrl &url,
+                                        const QByteArray &mimeType,
+                                        KisImportExportFilter::ConversionStatus &initializationStatus,
+                                        KisPropertiesConfigurationSP exportConfiguration)
+{
+    d->savingImage = d->image;
+
+    const QString fileName = url.toLocalFile();
+
+    QFuture<KisImportExportFilter::ConversionStatus> future =
+        d->importExportManager->exportDocumentAsyc(fileName,
+                                                   fileName,
+                                                   mimeType,
+                                                   initializationStatus,
+                                                   false,
+                                                   exportConfiguration);
+
+    if (initializationStatus != KisImportExportFilter::OK) {
+        d->savingImage = 0;
+        return QFuture<KisImportExportFilter::ConversionStatus>();
+    }
+
+    // the watcher is deleted together with the document if the
+    // latter is deleted before the finished() signal is delivered
+    typedef QFutureWatcher<KisImportExportFilter::ConversionStatus> StatusWatcher;
+    StatusWatcher *watcher = new StatusWatcher(this);
+    watcher->setFuture(future);
+
+    connect(watcher, SIGNAL(finished()), SLOT(finishExportConcurrently()));
+    connect(watcher, SIGNAL(finished()), watcher, SLOT(deleteLater()));
+
+    return future;
+}
+
+void KisDocument::finishExportConcurrently()
+{
+    d->savingImage.clear();
+}
+
 bool KisDocument::initiateSavingInBackground(const QString actionName,
                                              const QObject *receiverObject, const char *receiverMethod,
                                              const KritaUtils::ExportFileJob &job,
@@ -910,7 +1258,7 @@ QPixmap KisDocument::generatePreview(const QSize& size)
         QRect bounds = image->bounds();
         QSize newSize = bounds.size();
         newSize.scale(size, Qt::KeepAspectRatio);
-        QPixmap px = QPixmap::fromImage(image->convertToQImage(newSize, 0));
+        QPixmap px = QPixmap::fromImage(d->fetchPreview(image, newSize));
         if (px.size() == QSize(0,0)) {
             px = QPixmap(newSize);
             QPainter gc(&px);
@@ -1351,17 +1699,17 @@ KisImportExportManager *KisDocument::importExportManager() const
 void KisDocument::addCommand(KUndo2Command *command)
 {
     if (command)
-        d->undoStack->push(command);
+        d->undoStack->pushMeasured(command);
 }
 
 void KisDocument::beginMacro(const KUndo2MagicString & text)
 {
-    d->undoStack->beginMacro(text);
+    d->undoStack->beginMeasuredMacro(text);
 }
 
 void KisDocument::endMacro()
 {
-    d->undoStack->endMacro();
+    d->undoStack->endMeasuredMacro();
 }
 
 void KisDocument::slotUndoStackCleanChanged(bool value)
@@ -1369,6 +1717,12 @@ void KisDocument::slotUndoStackCleanChanged(bool value)
     setModified(!value);
 }
 
+void KisDocument::slotUndoStackIndexChanged()
+{
+    // undo and redo change the image without notifying us via setImageModified()
+    d->imageRevision.ref();
+}
+
 void KisDocument::slotConfigChanged()
 {
     KisConfig cfg;
@@ -1381,6 +1735,12 @@ void KisDocument::clearUndoHistory()
     d->undoStack->clear();
 }
 
+qint64 KisDocument::undoStepMemorySize(const KUndo2Command *command)
+{
+    KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(QThread::currentThread() == qApp->thread(), 0);
+    return UndoStack::stepMemory(command);
+}
+
 KisGridConfig KisDocument::gridConfig() const
 {
     return d->gridConfig;
@@ -1664,6 +2024,7 @@ void KisDocument::hackPreliminarySetImage(KisImageSP image)
 
 void KisDocument::setImageModified()
 {
+    d->imageRevision.ref();
     setModified(true);
 }
 
@@ -24,6 +24,7 @@
 #include <QDateTime>
 #include <QTransform>
 #include <QList>
+#include <QFuture>
 
 #include <klocalizedstring.h>
 
@@ -151,6 +152,22 @@ public:
 private:
     bool exportDocumentImpl(const KritaUtils::ExportFileJob &job, KisPropertiesConfigurationSP exportConfiguration);
 
+    friend class KisSaveGroupVisitor;
+
+    /**
+     * Starts exporting the document as \p url in a worker thread. The
+     * export filter is created in the calling thread and no dialogs are
+     * shown. No saving lock is taken, so it is meant only for the
+     * temporary documents of KisSaveGroupVisitor, which are not shown
+     * to the user and are not changed or deleted until the returned
+     * future is finished. Several documents can be exported this way
+     * concurrently.
+     *
+     * \p initializationStatus is set to the result of the filter
+     * initialization; if it is not OK, the returned future is invalid.
+     */
+    QFuture<KisImportExportFilter::ConversionStatus> exportDocumentConcurrently(const QUrl &url, const QByteArray &mimeType, KisImportExportFilter::ConversionStatus &initializationStatus, KisPropertiesConfigurationSP exportConfiguration = 0);
+
 public:
     /**
      * @brief Sets whether the document can be edited or is read only.
@@ -228,6 +245,8 @@ public:
     /**
      * @brief Generates a preview picture of the document
      * @note The preview is used in the File Dialog and also to create the Thumbnail
+     * @note The previews are cached until the image is changed, so it is
+     *       cheap to call this method several times for the same size
      */
     QPixmap generatePreview(const QSize& size);
 
@@ -338,6 +357,17 @@ public:
 
     void clearUndoHistory();
 
+    /**
+     * \return the approximate amount of undo data (in bytes) created by
+     *         the undo step \p command of a document. The size is
+     *         attached to the step when it is added to the undo stack
+     *         of the document. It is zero for the steps that already
+     *         carry other extra data.
+     *
+     * Must be called from the GUI thread only.
+     */
+    static qint64 undoStepMemorySize(const KUndo2Command *command);
+
 
     /**
      *  Sets the modified flag on the document. This means that it has
@@ -435,6 +465,7 @@ Q_SIGNALS:
 
 private Q_SLOTS:
     void finishExportInBackground();
+    void finishExportConcurrently();
     void slotChildCompletedSavingInBackground(KisImportExportFilter::ConversionStatus status, const QString &errorMessage);
     void slotCompleteAutoSaving(const KritaUtils::ExportFileJob &job, KisImportExportFilter::ConversionStatus status, const QString &errorMessage);
 
@@ -575,6 +606,8 @@ private Q_SLOTS:
 
     void slotUndoStackCleanChanged(bool value);
 
+    void slotUndoStackIndexChanged();
+
     void slotConfigChanged();
 
 
@@ -21,6 +21,10 @@
 #include <kis_painter.h>
 #include <kis_paint_layer.h>
 #include <KisPart.h>
+#include <kis_memory_statistics_server.h>
+#include <KoColorSpace.h>
+
+#include <QThread>
 
 KisSaveGroupVisitor::KisSaveGroupVisitor(KisImageWSP image,
                                          bool saveInvisible,
@@ -36,11 +40,46 @@ KisSaveGroupVisitor::KisSaveGroupVisitor(KisImageWSP image,
     , m_baseName(baseName)
     , m_extension(extension)
     , m_mimeFilter(mimeFilter)
+    , m_pendingMemory(0)
 {
+    /**
+     * Let the image copies of the pending exports take at most half
+     * of the tile memory that is still free before the export starts
+     */
+    KisMemoryStatisticsServer::Statistics stats =
+        KisMemoryStatisticsServer::instance()->fetchMemoryStatistics(0);
+
+    m_memoryBudget = qMax(Q_INT64_C(0), stats.tilesHardLimit - stats.totalMemorySize) / 2;
 }
 
 KisSaveGroupVisitor::~KisSaveGroupVisitor()
 {
+    waitForPendingExports(0);
+}
+
+void KisSaveGroupVisitor::waitForPendingExports(int maxPendingExports, qint64 maxPendingMemory)
+{
+    while (m_pendingExports.size() > maxPendingExports ||
+           (maxPendingMemory >= 0 && !m_pendingExports.isEmpty() && m_pendingMemory > maxPendingMemory)) {
+
+        PendingExport pendingExport = m_pendingExports.takeFirst();
+        pendingExport.future.waitForFinished();
+        m_pendingMemory -= pendingExport.memorySize;
+
+        if (pendingExport.future.result() != KisImportExportFilter::OK) {
+            warnKrita << "Failed to export a group layer:" << pendingExport.path;
+        }
+
+        delete pendingExport.document;
+    }
+}
+
+bool KisSaveGroupVisitor::hasPendingExport(const QString &path) const
+{
+    Q_FOREACH (const PendingExport &pendingExport, m_pendingExports) {
+        if (pendingExport.path == path) return true;
+    }
+    return false;
 }
 
 bool KisSaveGroupVisitor::visit(KisNode* ) {
@@ -98,11 +137,36 @@ bool KisSaveGroupVisitor::visit(KisGroupLayer *layer)
             child = qobject_cast<KisLayer*>(child->nextSibling().data());
         }
 
+        waitForPendingExports(0);
     }
     else if (layer->visible() || m_saveInvisible) {
 
         QRect r = m_image->bounds();
 
+        /**
+         * Every pending export owns a full-size copy of the image: the
+         * pixels of the layer and the projection of the copy. Limit
+         * their number to the number of worker threads and their memory
+         * to the budget; a single export is always allowed.
+         */
+        const qint64 exportMemorySize =
+            2 * qint64(r.width()) * r.height() * m_image->colorSpace()->pixelSize();
+
+        waitForPendingExports(qMax(1, QThread::idealThreadCount()) - 1,
+                              qMax(Q_INT64_C(0), m_memoryBudget - exportMemorySize));
+
+        QString path = m_path + "/" + m_baseName + "_" + layer->name().replace(' ', '_') + '.' + m_extension;
+        QUrl url = QUrl::fromLocalFile(path);
+
+        /**
+         * The groups with the same name are saved into the same file.
+         * Let the previous export finish first, so that the last group
+         * wins, as if they were saved one by one.
+         */
+        while (hasPendingExport(path)) {
+            waitForPendingExports(m_pendingExports.size() - 1);
+        }
+
         KisDocument *exportDocument = KisPart::instance()->createDocument();
 
         KisImageSP dst = new KisImage(exportDocument->createUndoStore(), r.width(), r.height(), m_image->colorSpace(), layer->name());
@@ -115,13 +179,24 @@ bool KisSaveGroupVisitor::visit(KisGroupLayer *layer)
 
         dst->refreshGraph();
 
-
-
-        QString path = m_path + "/" + m_baseName + "_" + layer->name().replace(' ', '_') + '.' + m_extension;
-        QUrl url = QUrl::fromLocalFile(path);
-
         exportDocument->setFileBatchMode(true);
-        exportDocument->exportDocumentSync(url, m_mimeFilter.toLatin1());
+
+        KisImportExportFilter::ConversionStatus initializationStatus;
+        QFuture<KisImportExportFilter::ConversionStatus> future =
+            exportDocument->exportDocumentConcurrently(url, m_mimeFilter.toLatin1(), initializationStatus);
+
+        if (initializationStatus == KisImportExportFilter::OK) {
+            PendingExport pendingExport;
+            pendingExport.document = exportDocument;
+            pendingExport.path = path;
+            pendingExport.memorySize = exportMemorySize;
+            pendingExport.future = future;
+            m_pendingExports.append(pendingExport);
+            m_pendingMemory += exportMemorySize;
+        } else {
+            warnKrita << "Failed to start exporting a group layer:" << path;
+            delete exportDocument;
+        }
 
         if (!m_saveTopLevelOnly) {
             KisGroupLayerSP child = dynamic_cast<KisGroupLayer*>(layer->firstChild().data());
@@ -130,10 +205,7 @@ bool KisSaveGroupVisitor::visit(KisGroupLayer *layer)
                 child = dynamic_cast<KisGroupLayer*>(child->nextSibling().data());
             }
         }
-        delete exportDocument;
     }
 
     return true;
 }
-
-
@@ -22,6 +22,8 @@
 
 #include <QUrl>
 #include <QString>
+#include <QList>
+#include <QFuture>
 
 #include <kis_types.h>
 #include <kis_node_visitor.h>
@@ -29,11 +31,24 @@
 #include <kis_group_layer.h>
 #include <kis_node.h>
 #include <kis_image.h>
+#include <KisImportExportFilter.h>
+
+class KisDocument;
 
 
 /**
  * @brief The KisSaveGroupVisitor class saves the groups in
  * a Krita image to separate images.
+ *
+ * The export documents are prepared in the GUI thread in the order of
+ * traversal, but the files are encoded concurrently in worker threads.
+ * Every file is written by its own export filter, and the exports into
+ * the same file are serialized, so the result is the same as if the
+ * groups were saved one by one. The number of the pending exports is
+ * limited by the number of worker threads and by the free tile memory,
+ * since every export keeps its own copy of the image. All the exports
+ * are finished when the root layer is visited completely or the visitor
+ * is destroyed.
  */
 class KRITAUI_EXPORT KisSaveGroupVisitor : public KisNodeVisitor
 {
@@ -88,6 +103,27 @@ public:
 
     bool visit(KisGroupLayer *layer) override;
 
+private:
+
+    struct PendingExport {
+        KisDocument *document;
+        QString path;
+        qint64 memorySize;
+        QFuture<KisImportExportFilter::ConversionStatus> future;
+    };
+
+    /**
+     * Waits until no more than \p maxPendingExports exports are still
+     * running and their image copies take no more than \p maxPendingMemory
+     * bytes, oldest first, and deletes their documents
+     */
+    void waitForPendingExports(int maxPendingExports, qint64 maxPendingMemory = -1);
+
+    /**
+     * Returns true if the file \p path is still being written
+     */
+    bool hasPendingExport(const QString &path) const;
+
 private:
 
     KisImageWSP m_image;
@@ -97,6 +133,9 @@ private:
     QString m_baseName;
     QString m_extension;
     QString m_mimeFilter;
+    QList<PendingExport> m_pendingExports;
+    qint64 m_pendingMemory;
+    qint64 m_memoryBudget;
 };
 
 
@@ -26,9 +26,13 @@
 #include <klocalizedstring.h>
 #include <kstandardshortcut.h>
 
+#include "KisDocument.h"
+#include "kis_statusbar.h"
+
 KisUndoStackAction::KisUndoStackAction(KUndo2Stack* stack, Type type)
     : QAction(stack)
     , m_type(type)
+    , m_stack(stack)
 {
     if (m_type == UNDO) {
         connect(this, SIGNAL(triggered()), stack, SLOT(undo()));
@@ -47,6 +51,8 @@ KisUndoStackAction::KisUndoStackAction(KUndo2Stack* stack, Type type)
         setShortcuts(KStandardShortcut::redo());
         setEnabled(stack->canRedo());
     }
+
+    connect(this, SIGNAL(hovered()), this, SLOT(slotUpdateToolTip()));
 }
 
 void KisUndoStackAction::slotUndoTextChanged(const QString& text)
@@ -54,3 +60,13 @@ void KisUndoStackAction::slotUndoTextChanged(const QString& text)
     QString actionText = (m_type == UNDO) ? i18n("Undo %1", text) : i18n("Redo %1", text);
     setText(actionText);
 }
+
+void KisUndoStackAction::slotUpdateToolTip()
+{
+    const int index = m_type == UNDO ? m_stack->index() - 1 : m_stack->index();
+    const qint64 size = KisDocument::undoStepMemorySize(m_stack->command(index));
+
+    setToolTip(size > 0 ?
+               i18nc("tooltip of undo/redo action", "%1 (undo data: %2)", text(), KisStatusBar::formatSize(size)) :
+               text());
+}
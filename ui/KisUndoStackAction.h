@@ -34,12 +34,18 @@ public:
         RED0
     };
 
+    /**
+     * The tooltip of the action shows the amount of undo data
+     * of the step it would undo (or redo)
+     */
     KisUndoStackAction(KUndo2Stack* stack, Type type);
 
 private Q_SLOTS:
     void slotUndoTextChanged(const QString& text);
+    void slotUpdateToolTip();
 
 private:
     Type m_type;
+    KUndo2Stack *m_stack;
 };
 #endif // KOUNDOSTACKACTION_H
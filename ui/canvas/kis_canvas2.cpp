@@ -28,6 +28,11 @@
 #include <QLabel>
 #include <QMouseEvent>
 #include <QDesktopWidget>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QThread>
 
 #include <kis_debug.h>
 
@@ -62,6 +67,8 @@
 #include "kis_selection_component.h"
 #include "flake/kis_shape_selection.h"
 #include "kis_image_config.h"
+#include "kis_algebra_2d.h"
+#include "krita_utils.h"
 #include "kis_infinity_manager.h"
 #include "kis_signal_compressor.h"
 #include "kis_display_color_converter.h"
@@ -137,11 +144,68 @@ public:
     QPointer<KoShapeManager> currentlyActiveShapeManager;
     KisInputActionGroupsMask inputActionGroupsMask = AllActionGroup;
 
+    /**
+     * Patches of the image that are currently outside the viewport and
+     * still wait for being converted into the canvas cache. They are
+     * processed lazily by offscreenPatchesTimer in the GUI thread.
+     *
+     * The patches are kept sorted in the order of increasing priority,
+     * that is, the patch closest to the viewport is the last one and can
+     * be taken in O(1). The list is resorted only when new patches arrive
+     * or the viewport changes.
+     *
+     * visibleImageRect is a snapshot of the viewport taken in the GUI
+     * thread, because startUpdateInPatches() may be called from the image
+     * threads, where the coordinates converter must not be accessed.
+     *
+     * All the three members are guarded by offscreenPatchesLock.
+     */
+    QMutex offscreenPatchesLock;
+    QVector<QRect> pendingOffscreenPatches;
+    bool pendingOffscreenPatchesSorted = true;
+    QRect visibleImageRect;
+    QTimer offscreenPatchesTimer;
+
     bool effectiveLodAllowedInCanvas() {
         return lodAllowedInCanvas && !bootstrapLodBlocked;
     }
+
+    void updateVisibleImageRect() {
+        KIS_SAFE_ASSERT_RECOVER_RETURN(QThread::currentThread() == qApp->thread());
+        if (!canvasWidget) return;
+
+        const QRectF widgetRect = canvasWidget->widget()->rect();
+        const QRect rect = coordinatesConverter->widgetToImage(widgetRect).toAlignedRect();
+
+        QMutexLocker l(&offscreenPatchesLock);
+        if (rect != visibleImageRect) {
+            visibleImageRect = rect;
+            pendingOffscreenPatchesSorted = false;
+        }
+    }
 };
 
+namespace {
+
+/**
+ * Sorts the patches in the order of their distance from the center
+ * of \p rect, the closest ones go first. If \p closestLast is true,
+ * the order is reversed.
+ */
+void sortPatchesFromCenter(QVector<QRect> &patches, const QRect &rect, bool closestLast = false)
+{
+    const QPointF center = QRectF(rect).center();
+
+    std::sort(patches.begin(), patches.end(),
+              [center, closestLast] (const QRect &lhs, const QRect &rhs) {
+                  const qreal lhsDistance = KisAlgebra2D::norm(QRectF(lhs).center() - center);
+                  const qreal rhsDistance = KisAlgebra2D::norm(QRectF(rhs).center() - center);
+                  return closestLast ? lhsDistance > rhsDistance : lhsDistance < rhsDistance;
+              });
+}
+
+}
+
 namespace {
 KoShapeManager* fetchShapeManagerFromNode(KisNodeSP node)
 {
@@ -185,6 +249,11 @@ KisCanvas2::KisCanvas2(KisCoordinatesConverter *coordConverter, KoCanvasResource
 
     m_d->updateSignalCompressor.setDelay(1000 / config.fpsLimit());
     m_d->updateSignalCompressor.setMode(KisSignalCompressor::FIRST_ACTIVE);
+
+    m_d->offscreenPatchesTimer.setSingleShot(true);
+    m_d->offscreenPatchesTimer.setInterval(0);
+    connect(&m_d->offscreenPatchesTimer, SIGNAL(timeout()), SLOT(slotUpdateOffscreenPatches()));
+    connect(this, SIGNAL(sigOffscreenPatchesQueued()), &m_d->offscreenPatchesTimer, SLOT(start()));
 }
 
 void KisCanvas2::setup()
@@ -462,6 +531,7 @@ void KisCanvas2::createQPainterCanvas()
                                                 m_d->displayColorConverter.conversionFlags());
     m_d->prescaledProjection->setDisplayFilter(m_d->displayColorConverter.displayFilter());
     canvasWidget->setPrescaledProjection(m_d->prescaledProjection);
+    connect(m_d->prescaledProjection.data(), SIGNAL(sigPrescaledImageRegenerated()), SLOT(updateCanvas()));
     setCanvasWidget(canvasWidget);
 }
 
@@ -565,20 +635,114 @@ void KisCanvas2::resetCanvas(bool useOpenGL)
 
 void KisCanvas2::startUpdateInPatches(const QRect &imageRect)
 {
-    if (m_d->currentCanvasIsOpenGL) {
-        startUpdateCanvasProjection(imageRect);
-    } else {
-        KisImageConfig imageConfig;
-        int patchWidth = imageConfig.updatePatchWidth();
-        int patchHeight = imageConfig.updatePatchHeight();
-
-        for (int y = 0; y < imageRect.height(); y += patchHeight) {
-            for (int x = 0; x < imageRect.width(); x += patchWidth) {
-                QRect patchRect(x, y, patchWidth, patchHeight);
-                startUpdateCanvasProjection(patchRect);
-            }
+    /**
+     * Converting the whole image at once makes the user wait for the
+     * offscreen areas as well. So only the patches visible in the viewport
+     * are converted right now (starting from the center of the viewport),
+     * the rest of the image is converted lazily in the GUI thread.
+     */
+
+    KisImageConfig imageConfig;
+    const QSize patchSize(imageConfig.updatePatchWidth(), imageConfig.updatePatchHeight());
+
+    const QVector<QRect> patches = KritaUtils::splitRectIntoPatches(imageRect, patchSize);
+
+    if (QThread::currentThread() == qApp->thread()) {
+        m_d->updateVisibleImageRect();
+    }
+
+    QRect visibleRect;
+    {
+        QMutexLocker l(&m_d->offscreenPatchesLock);
+        visibleRect = m_d->visibleImageRect;
+    }
+
+    QVector<QRect> visiblePatches;
+    QVector<QRect> offscreenPatches;
+
+    Q_FOREACH (const QRect &patch, patches) {
+        if (wrapAroundViewingMode() || patch.intersects(visibleRect)) {
+            visiblePatches << patch;
+        } else {
+            offscreenPatches << patch;
+        }
+    }
+
+    {
+        QMutexLocker l(&m_d->offscreenPatchesLock);
+
+        // the pending patches covered by the new request are obsolete now
+        QVector<QRect> &pending = m_d->pendingOffscreenPatches;
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                     [imageRect] (const QRect &rc) {
+                                         return imageRect.contains(rc);
+                                     }),
+                      pending.end());
+
+        if (!offscreenPatches.isEmpty()) {
+            pending += offscreenPatches;
+            m_d->pendingOffscreenPatchesSorted = false;
         }
     }
+
+    sortPatchesFromCenter(visiblePatches, visibleRect);
+
+    Q_FOREACH (const QRect &patch, visiblePatches) {
+        startUpdateCanvasProjection(patch);
+    }
+
+    if (!offscreenPatches.isEmpty()) {
+        // this method may be called from a non-GUI thread, so the timer
+        // is started via a (queued) signal
+        emit sigOffscreenPatchesQueued();
+    }
+}
+
+void KisCanvas2::slotUpdateOffscreenPatches()
+{
+    /**
+     * Convert the patches closest to the viewport first, but don't
+     * block the GUI thread for too long: the rest of the patches will
+     * be processed on the next iteration of the event loop.
+     */
+    const int timeBudget = 10; // ms
+
+    const QRect imageBounds = image()->bounds();
+
+    m_d->updateVisibleImageRect();
+
+    {
+        QMutexLocker l(&m_d->offscreenPatchesLock);
+        if (!m_d->pendingOffscreenPatchesSorted) {
+            sortPatchesFromCenter(m_d->pendingOffscreenPatches, m_d->visibleImageRect, true);
+            m_d->pendingOffscreenPatchesSorted = true;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (timer.elapsed() < timeBudget) {
+        QRect patch;
+
+        {
+            QMutexLocker l(&m_d->offscreenPatchesLock);
+            if (m_d->pendingOffscreenPatches.isEmpty()) break;
+            patch = m_d->pendingOffscreenPatches.takeLast();
+        }
+
+        // the image might have been resized meanwhile
+        patch &= imageBounds;
+
+        if (!patch.isEmpty()) {
+            startUpdateCanvasProjection(patch);
+        }
+    }
+
+    QMutexLocker l(&m_d->offscreenPatchesLock);
+    if (!m_d->pendingOffscreenPatches.isEmpty()) {
+        m_d->offscreenPatchesTimer.start();
+    }
 }
 
 void KisCanvas2::setDisplayFilter(QSharedPointer<KisDisplayFilter> displayFilter)
@@ -719,11 +883,6 @@ void KisCanvas2::updateCanvasProjection()
             updateCanvasWidgetImpl(m_d->coordinatesConverter->viewportToWidget(vRect).toAlignedRect());
         }
     }
-
-    // TODO: Implement info->dirtyViewportRect() for KisOpenGLCanvas2 to avoid updating whole canvas
-    if (m_d->currentCanvasIsOpenGL) {
-        updateCanvasWidgetImpl();
-    }
 }
 
 void KisCanvas2::slotDoCanvasUpdate()
@@ -761,17 +920,18 @@ void KisCanvas2::updateCanvas()
 
 void KisCanvas2::updateCanvas(const QRectF& documentRect)
 {
-    if (m_d->currentCanvasIsOpenGL && m_d->canvasWidget->decorations().size() > 0) {
-        updateCanvasWidgetImpl();
-    }
-    else {
-        // updateCanvas is called from tools, never from the projection
-        // updates, so no need to prescale!
-        QRect widgetRect = m_d->coordinatesConverter->documentToWidget(documentRect).toAlignedRect();
-        widgetRect.adjust(-2, -2, 2, 2);
-        if (!widgetRect.isEmpty()) {
-            updateCanvasWidgetImpl(widgetRect);
-        }
+    /**
+     * The openGL canvas supports partial updates as well (it clips the
+     * decorations to the update rect), so the rect is passed to both
+     * kinds of the canvas widgets.
+     *
+     * updateCanvas is called from tools and decorations, never from the
+     * projection updates, so no need to prescale!
+     */
+    QRect widgetRect = m_d->coordinatesConverter->documentToWidget(documentRect).toAlignedRect();
+    widgetRect.adjust(-2, -2, 2, 2);
+    if (!widgetRect.isEmpty()) {
+        updateCanvasWidgetImpl(widgetRect);
     }
 }
 
@@ -789,9 +949,15 @@ void KisCanvas2::notifyZoomChanged()
     }
 
     notifyLevelOfDetailChange();
+    m_d->updateVisibleImageRect();
     updateCanvas(); // update the canvas, because that isn't done when zooming using KoZoomAction
 }
 
+void KisCanvas2::notifyCanvasWidgetResized()
+{
+    m_d->updateVisibleImageRect();
+}
+
 void KisCanvas2::slotTrySwitchShapeManager()
 {
     QPointer<KoShapeManager> oldManager = m_d->currentlyActiveShapeManager;
@@ -859,6 +1025,8 @@ void KisCanvas2::documentOffsetMoved(const QPoint &documentOffset)
 
     QPointF moveOffset = offsetAfter - offsetBefore;
 
+    m_d->updateVisibleImageRect();
+
     if (!m_d->currentCanvasIsOpenGL)
         m_d->prescaledProjection->viewportMoved(moveOffset);
 
@@ -81,6 +81,11 @@ public:
 
     void notifyZoomChanged();
 
+    /**
+     * Called by the canvas widget when its size has changed
+     */
+    void notifyCanvasWidgetResized();
+
     void disconnectCanvasObserver(QObject *object) override;
 
 public: // KoCanvasBase implementation
@@ -211,6 +216,7 @@ Q_SIGNALS:
 
     void sigCanvasCacheUpdated();
     void sigContinueResizeImage(qint32 w, qint32 h);
+    void sigOffscreenPatchesQueued();
 
     void documentOffsetUpdateFinished();
 
@@ -258,6 +264,9 @@ private Q_SLOTS:
     void startUpdateCanvasProjection(const QRect & rc);
     void updateCanvasProjection();
 
+    /// Converts the offscreen patches left after startUpdateInPatches()
+    void slotUpdateOffscreenPatches();
+
 
     /**
      * Called whenever the view widget needs to show a different part of
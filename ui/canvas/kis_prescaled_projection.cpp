@@ -27,6 +27,8 @@
 #include <QPoint>
 #include <QSize>
 #include <QPainter>
+#include <QRegion>
+#include <QtConcurrent>
 
 #include <KoColorProfile.h>
 #include <KoViewConverter.h>
@@ -36,6 +38,7 @@
 #include "kis_config_notifier.h"
 #include "kis_image.h"
 #include "krita_utils.h"
+#include "kis_signal_compressor.h"
 
 #include "kis_coordinates_converter.h"
 #include "kis_projection_backend.h"
@@ -44,42 +47,93 @@
 
 #define ceiledSize(sz) QSize(ceil((sz).width()), ceil((sz).height()))
 
-inline void copyQImageBuffer(uchar* dst, const uchar* src , qint32 deltaX, qint32 width)
+/**
+ * The prescaled image is bigger than the viewport by this margin on
+ * every side, so small pans don't need any rendering at all
+ */
+const int OVERSCAN_MARGIN = 256;
+
+/**
+ * The delay after which the subpixel error accumulated by panning is
+ * corrected with a full prescale
+ */
+const int SUBPIXEL_CORRECTION_DELAY = 300;
+
+namespace {
+
+void drawPatchUsingBackend(KisProjectionBackend *backend, QPainter &gc, KisPPUpdateInfoSP info)
 {
-    if (deltaX >= 0) {
-        memcpy(dst + 4 * deltaX, src, 4 *(width - deltaX) * sizeof(uchar));
-    } else {
-        memcpy(dst, src - 4 * deltaX, 4 *(width + deltaX) * sizeof(uchar));
+    if (info->imageRect.isEmpty()) return;
+
+    if (info->transfer == KisPPUpdateInfo::DIRECT) {
+        backend->drawFromOriginalImage(gc, info);
+    } else /* if info->transfer == KisPPUpdateInformation::PATCH */ {
+        KisImagePatch patch = backend->getNearestPatch(info);
+        // prescale the patch because otherwise we'd scale using QPainter, which gives
+        // a crap result compared to QImage's smoothscale
+        patch.preScale(info->viewportRect);
+        patch.drawMe(gc, info->viewportRect, info->renderHints);
     }
 }
 
-void copyQImage(qint32 deltaX, qint32 deltaY, QImage* dstImage, const QImage& srcImage)
+struct RenderPatchJob
 {
-    qint32 height = dstImage->height();
-    qint32 width = dstImage->width();
-    Q_ASSERT(dstImage->width() == srcImage.width() && dstImage->height() == srcImage.height());
-    if (deltaY >= 0) {
-        for (int y = 0; y < height - deltaY; y ++) {
-            const uchar* src = srcImage.scanLine(y);
-            uchar* dst = dstImage->scanLine(y + deltaY);
-            copyQImageBuffer(dst, src, deltaX, width);
-        }
-    } else {
-        for (int y = 0; y < height + deltaY; y ++) {
-            const uchar* src = srcImage.scanLine(y - deltaY);
-            uchar* dst = dstImage->scanLine(y);
-            copyQImageBuffer(dst, src, deltaX, width);
-        }
+    KisProjectionBackend *backend;
+    KisPPUpdateInfoSP info;
+    QPoint viewportOrigin;
+    QRect bufferRect;
+    QImage result;
+};
+
+/**
+ * Renders a patch into a separate image, so that several patches could
+ * be rendered in parallel. Is called in the context of a worker thread.
+ */
+void renderPatch(RenderPatchJob &job)
+{
+    job.result = QImage(job.bufferRect.size(), QImage::Format_ARGB32);
+    job.result.fill(0);
+
+    QPainter gc(&job.result);
+    gc.setCompositionMode(QPainter::CompositionMode_Source);
+    gc.translate(job.viewportOrigin - job.bufferRect.topLeft());
+    drawPatchUsingBackend(job.backend, gc, job.info);
+}
+
+void copyQImageRect(const QImage &srcImage, const QRect &srcRect, QImage *dstImage, const QPoint &dstPos)
+{
+    const int bytesPerPixel = 4;
+
+    for (int y = 0; y < srcRect.height(); y++) {
+        const uchar *src = srcImage.constScanLine(srcRect.y() + y) + bytesPerPixel * srcRect.x();
+        uchar *dst = dstImage->scanLine(dstPos.y() + y) + bytesPerPixel * dstPos.x();
+        memcpy(dst, src, bytesPerPixel * srcRect.width());
     }
 }
 
+}
+
 struct KisPrescaledProjection::Private {
     Private()
-        : viewportSize(0, 0)
+        : subpixelCorrectionCompressor(SUBPIXEL_CORRECTION_DELAY, KisSignalCompressor::POSTPONE)
+        , viewportSize(0, 0)
         , projectionBackend(0) {
     }
 
+    /**
+     * The prescaled image of the viewport with the overscan margins.
+     * The viewport's origin is placed at \p viewportOrigin.
+     */
     QImage prescaledQImage;
+    QImage spareQImage;
+    QPoint viewportOrigin;
+
+    /**
+     * The part of the pan offsets that is not represented in the
+     * prescaled image yet, because it is smaller than a pixel
+     */
+    QPointF subpixelOffset;
+    KisSignalCompressor subpixelCorrectionCompressor;
 
     QSize updatePatchSize;
     QSize canvasSize;
@@ -87,6 +141,10 @@ struct KisPrescaledProjection::Private {
     KisImageWSP image;
     KisCoordinatesConverter *coordinatesConverter;
     KisProjectionBackend* projectionBackend;
+
+    QRect bufferRectInViewport() const {
+        return QRect(-viewportOrigin, prescaledQImage.size());
+    }
 };
 
 KisPrescaledProjection::KisPrescaledProjection()
@@ -100,6 +158,7 @@ KisPrescaledProjection::KisPrescaledProjection()
     m_d->projectionBackend = new KisImagePyramid(1);
 
     connect(KisConfigNotifier::instance(), SIGNAL(configChanged()), SLOT(updateSettings()));
+    connect(&m_d->subpixelCorrectionCompressor, SIGNAL(timeout()), SLOT(slotCorrectSubpixelOffset()));
 }
 
 KisPrescaledProjection::~KisPrescaledProjection()
@@ -118,6 +177,14 @@ void KisPrescaledProjection::setImage(KisImageWSP image)
 
 QImage KisPrescaledProjection::prescaledQImage() const
 {
+    if (m_d->prescaledQImage.isNull()) return QImage();
+
+    return m_d->prescaledQImage.copy(QRect(m_d->viewportOrigin, m_d->viewportSize));
+}
+
+QImage KisPrescaledProjection::overscanQImage(QPoint *viewportOrigin) const
+{
+    *viewportOrigin = m_d->viewportOrigin;
     return m_d->prescaledQImage;
 }
 
@@ -139,56 +206,62 @@ void KisPrescaledProjection::viewportMoved(const QPointF &offset)
     if (m_d->prescaledQImage.isNull()) return;
     if (offset.isNull()) return;
 
-    QPoint alignedOffset = offset.toPoint();
+    /**
+     * The fractional part of the offset is accumulated and the content
+     * is moved by whole pixels only, so it may be shifted by a fraction
+     * of a pixel while the user is panning. The error is corrected
+     * by a full prescale after the panning has stopped.
+     */
+    const QPointF totalOffset = offset + m_d->subpixelOffset;
+    const QPoint alignedOffset = totalOffset.toPoint();
+    m_d->subpixelOffset = totalOffset - alignedOffset;
+
+    if (!qFuzzyIsNull(m_d->subpixelOffset.x()) ||
+        !qFuzzyIsNull(m_d->subpixelOffset.y())) {
 
-    if(offset != alignedOffset) {
-        /**
-         * We can't optimize anything when offset is float :(
-         * Just prescale entire image.
-         */
-        dbgRender << "prescaling the entire image because the offset is float";
-        preScale();
-        return;
+        m_d->subpixelCorrectionCompressor.start();
     }
 
-    QImage newImage = QImage(m_d->viewportSize, QImage::Format_ARGB32);
-    newImage.fill(0);
+    if (alignedOffset.isNull()) return;
+
+    const QRect bufferRect(QPoint(), m_d->prescaledQImage.size());
+    const QPoint newOrigin = m_d->viewportOrigin - alignedOffset;
+
+    // the viewport is still inside the overscan area
+    if (bufferRect.contains(QRect(newOrigin, m_d->viewportSize))) {
+        m_d->viewportOrigin = newOrigin;
+        return;
+    }
 
     /**
-     * TODO: viewport rects should be cropped by the borders of
-     * the image, because it may be requested to read/write
-     * outside QImage and copyQImage will not catch it
+     * The margin has run out, so recenter the viewport in the buffer,
+     * reuse the overlapping part and render the rest
      */
-    QRect newViewportRect = QRect(QPoint(0,0), m_d->viewportSize);
-    QRect oldViewportRect = newViewportRect.translated(alignedOffset);
-
-    QRegion updateRegion = newViewportRect;
-    QRect savedArea = newViewportRect & oldViewportRect;
-    if(!savedArea.isEmpty()) {
-        copyQImage(alignedOffset.x(), alignedOffset.y(), &newImage, m_d->prescaledQImage);
-        updateRegion -= savedArea;
-    }
+    const QPoint centeredOrigin(OVERSCAN_MARGIN, OVERSCAN_MARGIN);
+    const QPoint shift = centeredOrigin - newOrigin;
 
-    QPainter gc(&newImage);
-    QVector<QRect> rects = updateRegion.rects();
+    if (m_d->spareQImage.size() != m_d->prescaledQImage.size()) {
+        m_d->spareQImage = QImage(m_d->prescaledQImage.size(), QImage::Format_ARGB32);
+    }
+    m_d->spareQImage.fill(0);
 
-    Q_FOREACH (const QRect &rect, rects) {
-        QRect imageRect =
-            m_d->coordinatesConverter->viewportToImage(rect).toAlignedRect();
-        QVector<QRect> patches =
-            KritaUtils::splitRectIntoPatches(imageRect, m_d->updatePatchSize);
+    const QRect savedArea = bufferRect & bufferRect.translated(shift);
+    if (!savedArea.isEmpty()) {
+        copyQImageRect(m_d->prescaledQImage, savedArea.translated(-shift),
+                       &m_d->spareQImage, savedArea.topLeft());
+    }
 
-        Q_FOREACH (const QRect& rc, patches) {
-            QRect viewportPatch =
-                m_d->coordinatesConverter->imageToViewport(rc).toAlignedRect();
+    std::swap(m_d->prescaledQImage, m_d->spareQImage);
+    m_d->viewportOrigin = centeredOrigin;
 
-            KisPPUpdateInfoSP info = getInitialUpdateInformation(QRect());
-            fillInUpdateInformation(viewportPatch, info);
-            drawUsingBackend(gc, info);
-        }
-    }
+    const QRegion exposedRegion = QRegion(bufferRect) - savedArea;
+    renderViewportRects(exposedRegion.translated(-centeredOrigin).rects());
+}
 
-    m_d->prescaledQImage = newImage;
+void KisPrescaledProjection::slotCorrectSubpixelOffset()
+{
+    preScale();
+    emit sigPrescaledImageRegenerated();
 }
 
 void KisPrescaledProjection::slotImageSizeChanged(qint32 w, qint32 h)
@@ -241,24 +314,56 @@ void KisPrescaledProjection::preScale()
 {
     if (!m_d->image) return;
 
+    m_d->subpixelOffset = QPointF();
+    m_d->subpixelCorrectionCompressor.stop();
+
+    m_d->viewportOrigin = QPoint(OVERSCAN_MARGIN, OVERSCAN_MARGIN);
     m_d->prescaledQImage.fill(0);
 
-    QRect viewportRect(QPoint(0, 0), m_d->viewportSize);
-    QRect imageRect =
-        m_d->coordinatesConverter->viewportToImage(viewportRect).toAlignedRect();
+    renderViewportRects({m_d->bufferRectInViewport()});
+}
+
+void KisPrescaledProjection::renderViewportRects(const QVector<QRect> &viewportRects)
+{
+    QVector<RenderPatchJob> jobs;
 
-    QVector<QRect> patches =
-        KritaUtils::splitRectIntoPatches(imageRect, m_d->updatePatchSize);
+    Q_FOREACH (const QRect &rect, viewportRects) {
+        QRect imageRect =
+            m_d->coordinatesConverter->viewportToImage(rect).toAlignedRect();
+        QVector<QRect> patches =
+            KritaUtils::splitRectIntoPatches(imageRect, m_d->updatePatchSize);
 
-    Q_FOREACH (const QRect& rc, patches) {
-        QRect viewportPatch = m_d->coordinatesConverter->imageToViewport(rc).toAlignedRect();
-        KisPPUpdateInfoSP info = getInitialUpdateInformation(QRect());
-        fillInUpdateInformation(viewportPatch, info);
-        QPainter gc(&m_d->prescaledQImage);
-        gc.setCompositionMode(QPainter::CompositionMode_Source);
-        drawUsingBackend(gc, info);
+        Q_FOREACH (const QRect& rc, patches) {
+            QRect viewportPatch =
+                m_d->coordinatesConverter->imageToViewport(rc).toAlignedRect();
+
+            KisPPUpdateInfoSP info = getInitialUpdateInformation(QRect());
+            fillInUpdateInformation(viewportPatch, info);
+
+            const QRect bufferRect =
+                info->viewportRect.toAlignedRect().translated(m_d->viewportOrigin) &
+                QRect(QPoint(), m_d->prescaledQImage.size());
+
+            if (info->imageRect.isEmpty() || bufferRect.isEmpty()) continue;
+
+            jobs.append({m_d->projectionBackend, info, m_d->viewportOrigin, bufferRect, QImage()});
+        }
     }
 
+    /**
+     * The patches are rendered in parallel, and then copied into the
+     * prescaled image in the original order, so that the overlapping
+     * borders of the patches are resolved the same way as if they were
+     * painted sequentially.
+     */
+    QtConcurrent::blockingMap(jobs, renderPatch);
+
+    QPainter gc(&m_d->prescaledQImage);
+    gc.setCompositionMode(QPainter::CompositionMode_Source);
+
+    Q_FOREACH (const RenderPatchJob &job, jobs) {
+        gc.drawImage(job.bufferRect.topLeft(), job.result);
+    }
 }
 
 void KisPrescaledProjection::setMonitorProfile(const KoColorProfile *monitorProfile, KoColorConversionTransformation::Intent renderingIntent, KoColorConversionTransformation::ConversionFlags conversionFlags)
@@ -286,11 +391,15 @@ void KisPrescaledProjection::updateViewportSize()
 
     m_d->viewportSize = m_d->coordinatesConverter->widgetToViewport(minimalRect).toAlignedRect().size();
 
+    const QSize bufferSize =
+        m_d->viewportSize + QSize(2 * OVERSCAN_MARGIN, 2 * OVERSCAN_MARGIN);
+
     if (m_d->prescaledQImage.isNull() ||
-        m_d->prescaledQImage.size() != m_d->viewportSize) {
+        m_d->prescaledQImage.size() != bufferSize) {
 
-        m_d->prescaledQImage = QImage(m_d->viewportSize, QImage::Format_ARGB32);
+        m_d->prescaledQImage = QImage(bufferSize, QImage::Format_ARGB32);
         m_d->prescaledQImage.fill(0);
+        m_d->viewportOrigin = QPoint(OVERSCAN_MARGIN, OVERSCAN_MARGIN);
     }
 }
 
@@ -327,8 +436,9 @@ void KisPrescaledProjection::fillInUpdateInformation(const QRect &viewportRect,
 {
     m_d->coordinatesConverter->imageScale(&info->scaleX, &info->scaleY);
 
-    // first, crop the part of the view rect that is outside of the canvas
-    QRect croppedViewRect = viewportRect.intersected(QRect(QPoint(0, 0), m_d->viewportSize));
+    // first, crop the part of the view rect that is outside of the
+    // canvas and its overscan margins
+    QRect croppedViewRect = viewportRect.intersected(m_d->bufferRectInViewport());
 
     // second, align this rect to the KisImage's pixels and pixels
     // of projection backend.
@@ -380,21 +490,12 @@ void KisPrescaledProjection::updateScaledImage(KisPPUpdateInfoSP info)
 {
     QPainter gc(&m_d->prescaledQImage);
     gc.setCompositionMode(QPainter::CompositionMode_Source);
+    gc.translate(m_d->viewportOrigin);
     drawUsingBackend(gc, info);
 }
 
 void KisPrescaledProjection::drawUsingBackend(QPainter &gc, KisPPUpdateInfoSP info)
 {
-    if (info->imageRect.isEmpty()) return;
-
-    if (info->transfer == KisPPUpdateInfo::DIRECT) {
-        m_d->projectionBackend->drawFromOriginalImage(gc, info);
-    } else /* if info->transfer == KisPPUpdateInformation::PATCH */ {
-        KisImagePatch patch = m_d->projectionBackend->getNearestPatch(info);
-        // prescale the patch because otherwise we'd scale using QPainter, which gives
-        // a crap result compared to QImage's smoothscale
-        patch.preScale(info->viewportRect);
-        patch.drawMe(gc, info->viewportRect, info->renderHints);
-    }
+    drawPatchUsingBackend(m_d->projectionBackend, gc, info);
 }
 
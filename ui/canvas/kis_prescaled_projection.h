@@ -19,6 +19,7 @@
 #define KIS_PRESCALED_PROJECTION_H
 
 #include <QObject>
+#include <QVector>
 
 #include <kritaui_export.h>
 #include <kis_shared.h>
@@ -61,6 +62,15 @@ public:
      */
     QImage prescaledQImage() const;
 
+    /**
+     * Return the prescaled image together with its overscan margins
+     * without copying any pixels.
+     *
+     * @param viewportOrigin receives the position of the viewport's
+     *        origin inside the returned image
+     */
+    QImage overscanQImage(QPoint *viewportOrigin) const;
+
     void setCoordinatesConverter(KisCoordinatesConverter *coordinatesConverter);
 
 public Q_SLOTS:
@@ -123,6 +133,16 @@ public Q_SLOTS:
      */
     void preScale();
 
+Q_SIGNALS:
+    /**
+     * Emitted when the prescaled image has been regenerated on its own,
+     * without any request from the canvas
+     */
+    void sigPrescaledImageRegenerated();
+
+private Q_SLOTS:
+    void slotCorrectSubpixelOffset();
+
 private:
 
     friend class KisPrescaledProjectionTest;
@@ -132,6 +152,12 @@ private:
 
     void updateViewportSize();
 
+    /**
+     * Renders the passed rects of the viewport (and its overscan
+     * margins) into the prescaled image using worker threads
+     */
+    void renderViewportRects(const QVector<QRect> &viewportRects);
+
     /**
      * This creates an empty update information and fills it with the only
      * parameter: @p dirtyImageRect
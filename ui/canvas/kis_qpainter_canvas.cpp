@@ -149,9 +149,12 @@ void KisQPainterCanvas::drawImage(QPainter & gc, const QRect &updateWidgetRect)
 
     QRectF viewportRect = converter->widgetToViewport(updateWidgetRect);
 
+    QPoint viewportOrigin;
+    const QImage prescaledImage = m_d->prescaledProjection->overscanQImage(&viewportOrigin);
+
     gc.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    gc.drawImage(viewportRect, m_d->prescaledProjection->prescaledQImage(),
-                 viewportRect);
+    gc.drawImage(viewportRect, prescaledImage,
+                 viewportRect.translated(viewportOrigin));
 }
 
 QVariant KisQPainterCanvas::inputMethodQuery(Qt::InputMethodQuery query) const
@@ -236,6 +239,7 @@ void KisQPainterCanvas::resizeEvent(QResizeEvent *e)
 
     coordinatesConverter()->setCanvasWidgetSize(size);
     m_d->prescaledProjection->notifyCanvasSizeChanged(size);
+    canvas()->notifyCanvasWidgetResized();
 }
 
 void KisQPainterCanvas::slotConfigChanged()
@@ -61,11 +61,6 @@ KisOpenGLUpdateInfo::KisOpenGLUpdateInfo(ConversionOptions options)
 {
 }
 
-QRect KisOpenGLUpdateInfo::dirtyViewportRect() {
-    qFatal("Not implemented yet!");
-    return QRect();
-}
-
 void KisOpenGLUpdateInfo::assignDirtyImageRect(const QRect &rect)
 {
     m_dirtyImageRect = rect;
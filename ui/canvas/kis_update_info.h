@@ -34,6 +34,10 @@ public:
     KisUpdateInfo();
     virtual ~KisUpdateInfo();
 
+    /**
+     * The part of the viewport changed by the update, if the info knows
+     * it. An empty rect means that the canvas should compute it itself.
+     */
     virtual QRect dirtyViewportRect();
     virtual QRect dirtyImageRect() const = 0;
     virtual int levelOfDetail() const = 0;
@@ -71,7 +75,11 @@ public:
 
     KisTextureTileUpdateInfoSPList tileList;
 
-    QRect dirtyViewportRect() override;
+    /**
+     * The info doesn't know the viewport, so the dirty viewport rect
+     * is computed by KisOpenGLCanvas2::updateCanvasProjection() from
+     * dirtyImageRect() and levelOfDetail()
+     */
     QRect dirtyImageRect() const override;
 
     void assignDirtyImageRect(const QRect &rect);
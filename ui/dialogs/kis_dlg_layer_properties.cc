@@ -210,13 +210,11 @@ KisDlgLayerProperties::~KisDlgLayerProperties()
         KisPostExecutionUndoAdapter *adapter =
             d->view->image()->postExecutionUndoAdapter();
         KisSavedMacroCommand *macro = adapter->createMacro(kundo2_i18n("Change Layer Properties"));
-        macro->addCommand(toQShared(new KisLayerUtils::KisSimpleUpdateCommand(d->nodes, false)));
+        KisMultinodePropertyBatchCommand *batch = new KisMultinodePropertyBatchCommand(d->nodes);
         Q_FOREACH(auto prop, d->allProperties()) {
-            if (!prop->isIgnored()) {
-                macro->addCommand(toQShared(prop->createPostExecutionUndoCommand()));
-            }
+            batch->addProperty(prop);
         }
-        macro->addCommand(toQShared(new KisLayerUtils::KisSimpleUpdateCommand(d->nodes, true)));
+        macro->addCommand(toQShared(batch));
         adapter->addMacro(macro);
     }
     else /* if (result() == QDialog::Rejected) */ {
@@ -292,5 +290,5 @@ void KisDlgLayerProperties::slotFlagsValueChangedInternally()
 
 void KisDlgLayerProperties::updatePreview()
 {
-    KisLayerUtils::KisSimpleUpdateCommand::updateNodes(d->nodes);
+    KisMultinodePropertyBatchCommand::updateNodes(d->nodes);
 }
@@ -18,6 +18,7 @@
 
 #include "kis_node_dummies_graph.h"
 #include "kis_node_shape.h"
+#include "kis_selection_mask.h"
 
 
 /********************************************************************/
@@ -26,7 +27,10 @@
 
 KisNodeDummy::KisNodeDummy(KisNodeShape *nodeShape, KisNodeSP node)
     : m_nodeShape(nodeShape),
-      m_node(node)
+      m_node(node),
+      m_isSelectionMask(dynamic_cast<KisSelectionMask*>(node.data())),
+      m_index(-1),
+      m_nonSelectionMaskIndex(0)
 {
 }
 
@@ -49,7 +53,7 @@ KisNodeDummy* KisNodeDummy::nextSibling() const
 {
     if(!parent()) return 0;
 
-    int index = parent()->m_children.indexOf(const_cast<KisNodeDummy*>(this));
+    int index = m_index;
     Q_ASSERT(index >= 0);
 
     index++;
@@ -61,7 +65,7 @@ KisNodeDummy* KisNodeDummy::prevSibling() const
 {
     if(!parent()) return 0;
 
-    int index = parent()->m_children.indexOf(const_cast<KisNodeDummy*>(this));
+    int index = m_index;
     Q_ASSERT(index >= 0);
 
     index--;
@@ -95,7 +99,56 @@ int KisNodeDummy::childCount() const
 
 int KisNodeDummy::indexOf(KisNodeDummy *child) const
 {
-    return m_children.indexOf(child);
+    if (!child || child->m_index < 0 ||
+        child->m_index >= m_children.size() ||
+        m_children[child->m_index] != child) {
+
+        return -1;
+    }
+
+    return child->m_index;
+}
+
+int KisNodeDummy::nonSelectionMaskChildCount() const
+{
+    return m_nonSelectionMaskChildren.size();
+}
+
+KisNodeDummy* KisNodeDummy::nonSelectionMaskChildAt(int index) const
+{
+    return m_nonSelectionMaskChildren.at(index);
+}
+
+int KisNodeDummy::nonSelectionMaskChildrenBefore(int index) const
+{
+    return index < m_children.size() ?
+        m_children[index]->m_nonSelectionMaskIndex :
+        m_nonSelectionMaskChildren.size();
+}
+
+void KisNodeDummy::updateChildIndexes(int firstChangedIndex)
+{
+    int nonSelectionMaskIndex = 0;
+
+    if (firstChangedIndex > 0) {
+        KisNodeDummy *prevChild = m_children[firstChangedIndex - 1];
+        nonSelectionMaskIndex =
+            prevChild->m_nonSelectionMaskIndex + !prevChild->m_isSelectionMask;
+    }
+
+    m_nonSelectionMaskChildren.resize(nonSelectionMaskIndex);
+
+    for (int i = firstChangedIndex; i < m_children.size(); i++) {
+        KisNodeDummy *child = m_children[i];
+
+        child->m_index = i;
+        child->m_nonSelectionMaskIndex = nonSelectionMaskIndex;
+
+        if (!child->m_isSelectionMask) {
+            m_nonSelectionMaskChildren.append(child);
+            nonSelectionMaskIndex++;
+        }
+    }
 }
 
 /********************************************************************/
@@ -128,11 +181,12 @@ void KisNodeDummiesGraph::addNode(KisNodeDummy *node, KisNodeDummy *parent, KisN
         int insertionIndex = parent->m_children.size();
 
         insertionIndex = aboveThis ?
-            parent->m_children.indexOf(aboveThis) + 1: 0;
+            parent->indexOf(aboveThis) + 1: 0;
 
-        Q_ASSERT(!aboveThis || parent->m_children.indexOf(aboveThis) >= 0);
+        Q_ASSERT(!aboveThis || parent->indexOf(aboveThis) >= 0);
 
         parent->m_children.insert(insertionIndex, node);
+        parent->updateChildIndexes(insertionIndex);
     }
 
     m_dummiesMap[node->node()] = node;
@@ -150,7 +204,12 @@ void KisNodeDummiesGraph::removeNode(KisNodeDummy *node)
         m_rootDummy = 0;
     }
     else {
-        parent->m_children.removeOne(node);
+        const int index = parent->indexOf(node);
+        Q_ASSERT(index >= 0);
+
+        parent->m_children.removeAt(index);
+        parent->updateChildIndexes(index);
+        node->m_index = -1;
     }
 }
 
@@ -21,6 +21,7 @@
 
 #include <QList>
 #include <QMap>
+#include <QVector>
 
 #include "kritaui_export.h"
 #include "kis_types.h"
@@ -42,6 +43,11 @@ class KisNodeShape;
  *
  * The ownership on the KisNodeShape is taken by the dummy.
  * The ownership on the children of the dummy is taken as well.
+ *
+ * Every dummy caches its position among the siblings, so index and
+ * sibling queries take constant time even for huge layer stacks. The
+ * positions are updated by KisNodeDummiesGraph when the children of a
+ * dummy change.
  */
 
 class KRITAUI_EXPORT KisNodeDummy : public QObject
@@ -71,6 +77,21 @@ public:
     int childCount() const;
     int indexOf(KisNodeDummy *child) const;
 
+    /**
+     * The children that are not selection masks. When the root
+     * dummy is shown without the global selection, these are the
+     * only visible children of the root.
+     */
+    int nonSelectionMaskChildCount() const;
+    KisNodeDummy* nonSelectionMaskChildAt(int index) const;
+
+    /**
+     * \return the number of children that are not selection masks
+     *         and are placed below position \p index. \p index may
+     *         be equal to childCount().
+     */
+    int nonSelectionMaskChildrenBefore(int index) const;
+
     KisNodeSP node() const;
 
 private:
@@ -79,10 +100,17 @@ private:
     KisNodeShape* nodeShape() const;
 
     friend class KisNodeDummiesGraph;
+    void updateChildIndexes(int firstChangedIndex);
+
     QList<KisNodeDummy*> m_children;
+    QVector<KisNodeDummy*> m_nonSelectionMaskChildren;
 
     KisNodeShape *m_nodeShape;
     KisNodeSP m_node;
+    bool m_isSelectionMask;
+
+    int m_index;
+    int m_nonSelectionMaskIndex;
 };
 
 /**
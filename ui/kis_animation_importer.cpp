@@ -19,8 +19,19 @@
 #include "kis_animation_importer.h"
 
 #include <QStatusBar>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QImageReader>
+#include <QQueue>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <kis_debug.h>
 
 #include "KoColorSpace.h"
+#include <KoColorSpaceRegistry.h>
 #include <KoUpdater.h>
 #include <QApplication>
 #include "KisPart.h"
@@ -30,8 +41,114 @@
 #include "kis_paint_layer.h"
 #include "kis_group_layer.h"
 #include "kis_raster_keyframe_channel.h"
+#include "kis_keyframe.h"
+#include "kis_paint_device.h"
 #include "commands/kis_image_layer_add_command.h"
 
+namespace {
+
+struct DecodedFrame {
+    QString file;
+
+    /// the hash of the frame content, empty if the file cannot be read
+    QByteArray contentHash;
+
+    /// the decoded frame, null if the file should be loaded with a
+    /// full document import
+    KisPaintDeviceSP device;
+};
+
+/**
+ * Only the images that Krita's own PNG import would load as 8-bit
+ * sRGB (RGB, RGBA or palette images without an embedded profile) can
+ * be decoded directly with QImageReader. Everything else goes through
+ * a full document import.
+ */
+bool canDecodeDirectly(const QByteArray &data)
+{
+    static const QByteArray pngSignature("\x89PNG\r\n\x1a\n", 8);
+    if (!data.startsWith(pngSignature)) return false;
+
+    bool ihdrIsSuitable = false;
+    int pos = pngSignature.size();
+
+    while (pos + 8 <= data.size()) {
+        const uchar *chunk = reinterpret_cast<const uchar*>(data.constData()) + pos;
+        const quint32 length = qFromBigEndian<quint32>(chunk);
+        const QByteArray type = data.mid(pos + 4, 4);
+        const uchar *chunkData = chunk + 8;
+
+        if (quint64(pos) + 12 + length > quint64(data.size())) return false;
+
+        if (type == "IHDR") {
+            if (length < 13) return false;
+
+            const int bitDepth = chunkData[8];
+            const int colorType = chunkData[9];
+
+            ihdrIsSuitable =
+                bitDepth <= 8 &&
+                (colorType == 2 || colorType == 3 || colorType == 6);
+
+        } else if (type == "iCCP") {
+            return false;
+        } else if (type == "IDAT") {
+            break;
+        }
+
+        pos += 12 + length;
+    }
+
+    return ihdrIsSuitable;
+}
+
+QByteArray imageContentHash(const QImage &image)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const QSize size = image.size();
+    hash.addData(reinterpret_cast<const char*>(&size), sizeof(size));
+
+    const int lineSize = image.width() * image.depth() / 8;
+    for (int y = 0; y < image.height(); y++) {
+        hash.addData(reinterpret_cast<const char*>(image.constScanLine(y)), lineSize);
+    }
+
+    return "image:" + hash.result();
+}
+
+DecodedFrame decodeFrame(const QString &file)
+{
+    DecodedFrame result;
+    result.file = file;
+
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly)) return result;
+
+    const QByteArray data = f.readAll();
+    f.close();
+
+    if (canDecodeDirectly(data)) {
+        QBuffer buffer(const_cast<QByteArray*>(&data));
+        QImageReader reader(&buffer, "png");
+
+        QImage image = reader.read();
+        if (!image.isNull()) {
+            image = image.convertToFormat(QImage::Format_ARGB32);
+
+            result.device = new KisPaintDevice(KoColorSpaceRegistry::instance()->rgb8());
+            result.device->convertFromQImage(image, 0);
+            result.contentHash = imageContentHash(image);
+
+            return result;
+        }
+    }
+
+    result.contentHash = "file:" + QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    return result;
+}
+
+}
+
 struct KisAnimationImporter::Private
 {
     KisImageSP image;
@@ -64,31 +181,72 @@ KisImportExportFilter::ConversionStatus KisAnimationImporter::import(QStringList
 {
     Q_ASSERT(step > 0);
 
+    QElapsedTimer importTime;
+    importTime.start();
+
     m_d->image->lock();
     KisUndoAdapter *undo = m_d->image->undoAdapter();
     undo->beginMacro(kundo2_i18n("Import animation"));
 
-    QScopedPointer<KisDocument> importDoc(KisPart::instance()->createDocument());
-    importDoc->setFileBatchMode(true);
+    QScopedPointer<KisDocument> importDoc;
 
     KisImportExportFilter::ConversionStatus status = KisImportExportFilter::OK;
     int frame = firstFrame;
     int filesProcessed = 0;
+    int framesDeduplicated = 0;
 
     if (m_d->updater) {
         m_d->updater->setRange(0, files.size() - 1);
     }
 
+    /**
+     * The files are prefetched and decoded by a bounded pool of workers,
+     * while the keyframes are inserted here, in order, as soon as the
+     * result of the next file arrives.
+     */
+    QThreadPool decodingPool;
+    decodingPool.setMaxThreadCount(QThread::idealThreadCount());
+    const int maxPrefetchedFrames = 2 * decodingPool.maxThreadCount();
+
+    QQueue<QFuture<DecodedFrame>> pendingFrames;
+    int nextFileToDecode = 0;
+
+    QHash<QByteArray, KisKeyframeSP> importedKeyframes;
+
     KisRasterKeyframeChannel *contentChannel = 0;
-    Q_FOREACH(QString file, files) {
-        bool successfullyLoaded = importDoc->openUrl(QUrl::fromLocalFile(file), KisDocument::DontAddToRecent);
-        if (!successfullyLoaded) {
+    while (filesProcessed < files.size()) {
+        while (nextFileToDecode < files.size() &&
+               pendingFrames.size() < maxPrefetchedFrames) {
+
+            pendingFrames.enqueue(QtConcurrent::run(&decodingPool, decodeFrame, files[nextFileToDecode]));
+            nextFileToDecode++;
+        }
+
+        DecodedFrame decodedFrame = pendingFrames.dequeue().result();
+        if (decodedFrame.contentHash.isEmpty()) {
             status = KisImportExportFilter::InternalError;
             break;
         }
 
+        KisPaintDeviceSP device = decodedFrame.device;
+
+        if (!device) {
+            if (!importDoc) {
+                importDoc.reset(KisPart::instance()->createDocument());
+                importDoc->setFileBatchMode(true);
+            }
+
+            bool successfullyLoaded = importDoc->openUrl(QUrl::fromLocalFile(decodedFrame.file), KisDocument::DontAddToRecent);
+            if (!successfullyLoaded) {
+                status = KisImportExportFilter::InternalError;
+                break;
+            }
+
+            device = importDoc->image()->projection();
+        }
+
         if (frame == firstFrame) {
-            const KoColorSpace *cs = importDoc->image()->colorSpace();
+            const KoColorSpace *cs = device->colorSpace();
             KisPaintLayerSP paintLayer = new KisPaintLayer(m_d->image, m_d->image->nextLayerName(), OPACITY_OPAQUE_U8, cs);
             undo->addCommand(new KisImageLayerAddCommand(m_d->image, paintLayer, m_d->image->rootLayer(), m_d->image->rootLayer()->childCount()));
 
@@ -113,14 +271,31 @@ KisImportExportFilter::ConversionStatus KisAnimationImporter::import(QStringList
             break;
         }
 
-        contentChannel->importFrame(frame, importDoc->image()->projection(), NULL);
+        // frames with the same content share the tiles of the first one
+        KisKeyframeSP sameKeyframe = importedKeyframes.value(decodedFrame.contentHash);
+        if (sameKeyframe) {
+            contentChannel->copyKeyframe(sameKeyframe, frame, NULL);
+            framesDeduplicated++;
+        } else {
+            contentChannel->importFrame(frame, device, NULL);
+            importedKeyframes.insert(decodedFrame.contentHash, contentChannel->keyframeAt(frame));
+        }
+
         frame += step;
         filesProcessed++;
     }
 
+    // the pool would wait for the prefetched frames anyway
+    decodingPool.waitForDone();
+
     undo->endMacro();
     m_d->image->unlock();
 
+    const qint64 elapsed = qMax(qint64(1), importTime.elapsed());
+    dbgFile << "Imported" << filesProcessed << "frames in" << elapsed << "ms,"
+            << qreal(filesProcessed) * 1000.0 / elapsed << "frames/s,"
+            << framesDeduplicated << "duplicated frames";
+
     return status;
 }
 
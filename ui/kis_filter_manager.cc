@@ -22,6 +22,9 @@
 
 #include <QHash>
 #include <QSignalMapper>
+#include <QTimer>
+
+#include <algorithm>
 
 #include <QMessageBox>
 #include <kactionmenu.h>
@@ -39,6 +42,7 @@
 // krita/ui
 #include "KisViewManager.h"
 #include "kis_canvas2.h"
+#include "kis_coordinates_converter.h"
 #include <kis_bookmarked_configuration_manager.h>
 
 #include "kis_action.h"
@@ -69,6 +73,14 @@ struct KisFilterManager::Private {
     KisStrokeId currentStrokeId;
     QRect initialApplyRect;
 
+    /**
+     * The patches outside the viewport are queued only when the user
+     * stops adjusting the filter for a while (or accepts the dialog),
+     * so the visible area is updated first
+     */
+    QVector<QRect> deferredPatches;
+    QTimer deferredPatchesTimer;
+
     QSignalMapper actionsMapper;
 
     QPointer<KisDlgFilter> filterDialog;
@@ -78,6 +90,10 @@ KisFilterManager::KisFilterManager(KisViewManager * view)
     : d(new Private)
 {
     d->view = view;
+
+    d->deferredPatchesTimer.setSingleShot(true);
+    d->deferredPatchesTimer.setInterval(300);
+    connect(&d->deferredPatchesTimer, SIGNAL(timeout()), SLOT(slotQueueDeferredPatches()));
 }
 
 KisFilterManager::~KisFilterManager()
@@ -246,11 +262,39 @@ void KisFilterManager::showFilterDialog(const QString &filterId)
     }
 }
 
+namespace {
+
+bool isSameConfiguration(KisFilterConfigurationSP lhs, KisFilterConfigurationSP rhs)
+{
+    // the same object might have been changed in place, so compare
+    // only distinct objects
+    return lhs && rhs && lhs != rhs &&
+        lhs->name() == rhs->name() &&
+        lhs->channelFlags() == rhs->channelFlags() &&
+        lhs->toXML() == rhs->toXML();
+}
+
+}
+
 void KisFilterManager::apply(KisFilterConfigurationSP filterConfig)
 {
+    /**
+     * The dialog may request the preview for the configuration that is
+     * already being applied (e.g. when a slider is released). There is
+     * no need to restart the filter in that case.
+     */
+    if (d->currentStrokeId &&
+        isSameConfiguration(filterConfig, d->currentlyAppliedConfiguration)) {
+
+        return;
+    }
+
     KisFilterSP filter = KisFilterRegistry::instance()->value(filterConfig->name());
     KisImageWSP image = d->view->image();
 
+    d->deferredPatchesTimer.stop();
+    d->deferredPatches.clear();
+
     if (d->currentStrokeId) {
         image->addJob(d->currentStrokeId, new KisFilterStrokeStrategy::CancelSilentlyMarker);
         image->cancelStroke(d->currentStrokeId);
@@ -289,9 +333,35 @@ void KisFilterManager::apply(KisFilterConfigurationSP filterConfig)
         QSize size = KritaUtils::optimalPatchSize();
         QVector<QRect> rects = KritaUtils::splitRectIntoPatches(processRect, size);
 
+        /**
+         * Process the patches in the order of their distance from the
+         * center of the viewport, so the part of the image the user
+         * looks at is updated first. The patches outside the viewport
+         * are deferred.
+         */
+        const QRect visibleRect = visibleImageRect() & processRect;
+
+        if (!visibleRect.isEmpty()) {
+            const QPoint center = visibleRect.center();
+
+            std::stable_sort(rects.begin(), rects.end(),
+                             [center] (const QRect &lhs, const QRect &rhs) {
+                                 return (lhs.center() - center).manhattanLength() <
+                                        (rhs.center() - center).manhattanLength();
+                             });
+        }
+
         Q_FOREACH (const QRect &rc, rects) {
-            image->addJob(d->currentStrokeId,
-                          new KisFilterStrokeStrategy::Data(rc, true));
+            if (visibleRect.isEmpty() || rc.intersects(visibleRect)) {
+                image->addJob(d->currentStrokeId,
+                              new KisFilterStrokeStrategy::Data(rc, true));
+            } else {
+                d->deferredPatches.append(rc);
+            }
+        }
+
+        if (!d->deferredPatches.isEmpty()) {
+            d->deferredPatchesTimer.start();
         }
     } else {
         image->addJob(d->currentStrokeId,
@@ -301,10 +371,40 @@ void KisFilterManager::apply(KisFilterConfigurationSP filterConfig)
     d->currentlyAppliedConfiguration = filterConfig;
 }
 
+QRect KisFilterManager::visibleImageRect() const
+{
+    KisCanvas2 *canvas = d->view->canvasBase();
+    if (!canvas || !canvas->canvasWidget()) return QRect();
+
+    const QRectF widgetRect = canvas->canvasWidget()->rect();
+    return canvas->coordinatesConverter()->widgetToImage(widgetRect).toAlignedRect();
+}
+
+void KisFilterManager::slotQueueDeferredPatches()
+{
+    if (!d->currentStrokeId) {
+        d->deferredPatches.clear();
+        return;
+    }
+
+    KisImageWSP image = d->view->image();
+
+    Q_FOREACH (const QRect &rc, d->deferredPatches) {
+        image->addJob(d->currentStrokeId,
+                      new KisFilterStrokeStrategy::Data(rc, true));
+    }
+
+    d->deferredPatches.clear();
+}
+
 void KisFilterManager::finish()
 {
     Q_ASSERT(d->currentStrokeId);
 
+    // the whole layer must be filtered before the stroke is ended
+    d->deferredPatchesTimer.stop();
+    slotQueueDeferredPatches();
+
     d->view->image()->endStroke(d->currentStrokeId);
 
     KisFilterSP filter = KisFilterRegistry::instance()->value(d->currentlyAppliedConfiguration->name());
@@ -325,6 +425,9 @@ void KisFilterManager::cancel()
 {
     Q_ASSERT(d->currentStrokeId);
 
+    d->deferredPatchesTimer.stop();
+    d->deferredPatches.clear();
+
     d->view->image()->cancelStroke(d->currentStrokeId);
 
     d->currentStrokeId.clear();
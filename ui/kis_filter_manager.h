@@ -60,6 +60,11 @@ private Q_SLOTS:
     void slotStrokeEndRequested();
     void slotStrokeCancelRequested();
 
+    void slotQueueDeferredPatches();
+
+private:
+    QRect visibleImageRect() const;
+
 private:
     struct Private;
     Private * const d;
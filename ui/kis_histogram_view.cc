@@ -32,45 +32,84 @@
 #include <QLinearGradient>
 #include <QImage>
 #include <QPaintEvent>
+#include <QtConcurrent>
+#include <QHash>
 
 #include <kis_debug.h>
 
 #include "KoChannelInfo.h"
 #include "KoBasicHistogramProducers.h"
+#include "KoHistogramProducer.h"
 #include "KoColorSpace.h"
+#include "KoColor.h"
 
 #include "kis_global.h"
 #include "kis_layer.h"
 #include <kis_signal_compressor.h>
 #include "kis_paint_device.h"
+#include "kis_sequential_iterator.h"
+#include "krita_utils.h"
+
+/**
+ * The size of the tile the device is split into for binning. Every
+ * tile is processed by a separate worker thread.
+ */
+static const int HISTOGRAM_TILE_SIZE = 256;
 
 KisHistogramView::KisHistogramView(QWidget *parent, const char *name, Qt::WindowFlags f)
         : QLabel(parent, f),
           m_currentDev(nullptr), m_currentProducer(nullptr),
-          m_smoothHistogram(false),m_histogram_type(LINEAR)
+          m_smoothHistogram(false),m_histogram_type(LINEAR),
+          m_tilesGeneration(0),
+          m_runningGeneration(-1),
+          m_recalculationPending(false),
+          m_mergedHighest(0),
+          m_binsDependOnView(false),
+          m_producerUpToDate(false)
 {
     setObjectName(name);
+
+    connect(&m_tilesWatcher, SIGNAL(finished()), SLOT(slotTileCalculationFinished()));
 }
 
 KisHistogramView::~KisHistogramView()
 {
+    m_tilesWatcher.cancel();
+    m_tilesWatcher.waitForFinished();
 }
 
 
 KoHistogramProducer *KisHistogramView::currentProducer()
 {
+    /**
+     * The bins are calculated by the copies of the producer in the
+     * worker threads, so the producer itself is filled only when
+     * somebody asks for it
+     */
+    if (m_currentProducer && !m_producerUpToDate && !m_histogram.isNull()) {
+        m_histogram->updateHistogram();
+        m_producerUpToDate = true;
+    }
+
     return m_currentProducer;
 }
 
 void KisHistogramView::startUpdateCanvasProjection()
 {
+    startUpdateCanvasProjection(m_currentBounds);
+}
+
+void KisHistogramView::startUpdateCanvasProjection(const QRect &dirtyRect)
+{
+    invalidateTiles(dirtyRect);
     updateHistogramCalculation();
 }
 
 void KisHistogramView::setChannels(QList<KoChannelInfo*> & channels)
 {
+    // the channels are used for painting only, the bins are the same
     m_channels = channels;
-    updateHistogramCalculation();
+    update();
 }
 
 void KisHistogramView::setProducer(KoHistogramProducer* producer)
@@ -80,6 +119,8 @@ void KisHistogramView::setProducer(KoHistogramProducer* producer)
     if( !m_histogram.isNull() ){
         m_histogram->setProducer( m_currentProducer );
     }
+    m_binsDependOnView = m_currentDev && binsDependOnView(m_currentProducer, m_currentDev->colorSpace());
+    resetTileCache();
     updateHistogramCalculation();
 }
 
@@ -90,7 +131,9 @@ void KisHistogramView::setPaintDevice(KisPaintDeviceSP dev, KoHistogramProducer*
     m_currentDev = dev;
     m_currentBounds = bounds;
     m_histogram = new KisHistogram(m_currentDev, m_currentBounds, m_currentProducer, m_histogram_type);
+    m_binsDependOnView = binsDependOnView(m_currentProducer, m_currentDev->colorSpace());
 
+    resetTileCache();
     updateHistogramCalculation();
 }
 
@@ -101,6 +144,10 @@ void KisHistogramView::setView(double from, double size)
     if (m_from + m_width > 1.0)
         m_from = 1.0 - m_width;
     m_histogram->producer()->setView(m_from, m_width);
+    m_producerUpToDate = false;
+
+    // the tiles are binned for the full view, so the bins
+    // for the new view are just merged from the cache
     updateHistogramCalculation();
 }
 
@@ -119,8 +166,9 @@ void KisHistogramView::setColor(bool set)
 
 void KisHistogramView::setHistogramType(enumHistogramType type)
 {
+    // the type affects the scale of the painted graph only
     m_histogram_type = type;
-    updateHistogramCalculation();
+    update();
 }
 
 void KisHistogramView::updateHistogramCalculation()
@@ -128,8 +176,332 @@ void KisHistogramView::updateHistogramCalculation()
     if (!m_currentProducer || m_currentDev.isNull() || m_histogram.isNull() ) { // Something's very wrong: not initialized
         return;
     }
-    m_histogram->updateHistogram();
-    update();
+
+    if (m_tilesWatcher.isRunning()) {
+        m_recalculationPending = true;
+        return;
+    }
+
+    KoHistogramProducerFactory *factory =
+        KoHistogramProducerFactoryRegistry::instance()->value(m_currentProducer->id().id());
+
+    if (!factory) {
+        /**
+         * The producer doesn't come from the registry, so we cannot
+         * create copies of it for the worker threads. Just do the
+         * calculation in the old, synchronous way.
+         */
+        m_histogram->updateHistogram();
+        m_producerUpToDate = true;
+        fetchBinsFromProducer();
+        update();
+        return;
+    }
+
+    QList<TileJob> jobs;
+
+    for (int i = 0; i < m_tiles.size(); i++) {
+        const TileData &tile = m_tiles[i];
+        if (tile.cachedRevision == tile.revision) continue;
+
+        TileJob job;
+        job.device = m_currentDev;
+        job.producerId = m_currentProducer->id().id();
+        job.rect = tile.rect;
+        job.index = i;
+        job.revision = tile.revision;
+        job.hasCachedBins = tile.cachedRevision >= 0;
+        job.cachedChecksum = tile.checksum;
+
+        jobs << job;
+    }
+
+    if (jobs.isEmpty()) {
+        mergeTileBins();
+        update();
+        return;
+    }
+
+    m_recalculationPending = false;
+    m_runningGeneration = m_tilesGeneration;
+    m_tilesWatcher.setFuture(QtConcurrent::mapped(jobs, &KisHistogramView::calculateTileBins));
+}
+
+KisHistogramView::TileResult KisHistogramView::calculateTileBins(const TileJob &job)
+{
+    TileResult result;
+    result.index = job.index;
+    result.revision = job.revision;
+    result.checksum = 0;
+    result.binsChanged = false;
+
+    const KoColorSpace *cs = job.device->colorSpace();
+    const int pixelSize = cs->pixelSize();
+
+    /**
+     * Reading the pixels is much cheaper than converting them into
+     * bins, so check first if the tile has changed at all. Two hashes
+     * with different seeds make a 64-bit checksum.
+     */
+    {
+        uint lowHash = 0;
+        uint highHash = 0x9e3779b9;
+
+        KisSequentialConstIterator it(job.device, job.rect);
+
+        int numConseqPixels = it.nConseqPixels();
+        while (it.nextPixels(numConseqPixels)) {
+            numConseqPixels = it.nConseqPixels();
+            lowHash = qHashBits(it.oldRawData(), numConseqPixels * pixelSize, lowHash);
+            highHash = qHashBits(it.oldRawData(), numConseqPixels * pixelSize, highHash);
+        }
+
+        result.checksum = (quint64(highHash) << 32) | lowHash;
+    }
+
+    if (job.hasCachedBins && result.checksum == job.cachedChecksum) {
+        return result;
+    }
+
+    KoHistogramProducerFactory *factory =
+        KoHistogramProducerFactoryRegistry::instance()->value(job.producerId);
+    KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(factory, result);
+
+    QScopedPointer<KoHistogramProducer> producer(factory->generate());
+    producer->setView(0.0, 1.0);
+    producer->clear();
+
+    KisSequentialConstIterator it(job.device, job.rect);
+
+    int numConseqPixels = it.nConseqPixels();
+    while (it.nextPixels(numConseqPixels)) {
+        numConseqPixels = it.nConseqPixels();
+        producer->addRegionToBin(it.oldRawData(), 0, numConseqPixels, cs);
+    }
+
+    result.binsChanged = true;
+
+    const int numChannels = producer->channels().size();
+    const int numBins = producer->numberOfBins();
+
+    result.bins.resize(numChannels);
+    for (int chan = 0; chan < numChannels; chan++) {
+        QVector<quint32> &bins = result.bins[chan];
+        bins.resize(numBins);
+
+        for (int i = 0; i < numBins; i++) {
+            bins[i] = producer->getBinAt(chan, i);
+        }
+    }
+
+    return result;
+}
+
+void KisHistogramView::slotTileCalculationFinished()
+{
+    if (m_runningGeneration == m_tilesGeneration && !m_tilesWatcher.isCanceled()) {
+        const QList<TileResult> results = m_tilesWatcher.future().results();
+
+        Q_FOREACH (const TileResult &result, results) {
+            KIS_SAFE_ASSERT_RECOVER(result.index < m_tiles.size()) { continue; }
+
+            TileData &tile = m_tiles[result.index];
+
+            /**
+             * If the tile has been changed while we were binning it,
+             * the result is dropped and the tile stays dirty
+             */
+            if (tile.revision != result.revision) continue;
+
+            if (result.binsChanged) {
+                tile.bins = result.bins;
+            }
+            tile.checksum = result.checksum;
+            tile.cachedRevision = result.revision;
+        }
+
+        mergeTileBins();
+        update();
+    }
+
+    if (m_recalculationPending || m_runningGeneration != m_tilesGeneration) {
+        updateHistogramCalculation();
+    }
+}
+
+void KisHistogramView::resetTileCache()
+{
+    m_tilesGeneration++;
+    m_tiles.clear();
+    m_mergedBins.clear();
+    m_mergedHighest = 0;
+    m_producerUpToDate = false;
+
+    if (m_currentBounds.isEmpty()) return;
+
+    const QVector<QRect> rects =
+        KritaUtils::splitRectIntoPatches(m_currentBounds,
+                                         QSize(HISTOGRAM_TILE_SIZE, HISTOGRAM_TILE_SIZE));
+
+    m_tiles.reserve(rects.size());
+    Q_FOREACH (const QRect &rc, rects) {
+        TileData tile;
+        tile.rect = rc;
+        m_tiles.append(tile);
+    }
+}
+
+void KisHistogramView::invalidateTiles(const QRect &rc)
+{
+    for (auto it = m_tiles.begin(); it != m_tiles.end(); ++it) {
+        if (it->rect.intersects(rc)) {
+            it->revision++;
+        }
+    }
+    m_producerUpToDate = false;
+}
+
+bool KisHistogramView::binsDependOnView(KoHistogramProducer *producer, const KoColorSpace *cs)
+{
+    KoHistogramProducerFactory *factory =
+        KoHistogramProducerFactoryRegistry::instance()->value(producer->id().id());
+    if (!factory) return true;
+
+    /**
+     * Some producers (e.g. the 8-bit ones) put every value into its
+     * own bin whatever the view is, others distribute the values
+     * inside the view only. Bin a light gray pixel for two different
+     * views to find out.
+     */
+    QScopedPointer<KoHistogramProducer> fullView(factory->generate());
+    QScopedPointer<KoHistogramProducer> halfView(factory->generate());
+
+    fullView->setView(0.0, 1.0);
+    fullView->clear();
+    halfView->setView(0.5, 0.5);
+    halfView->clear();
+
+    KoColor color(QColor(192, 192, 192), cs);
+    fullView->addRegionToBin(color.data(), 0, 1, cs);
+    halfView->addRegionToBin(color.data(), 0, 1, cs);
+
+    const int numChannels = fullView->channels().size();
+    const int numBins = fullView->numberOfBins();
+
+    for (int chan = 0; chan < numChannels; chan++) {
+        for (int i = 0; i < numBins; i++) {
+            if (fullView->getBinAt(chan, i) != halfView->getBinAt(chan, i)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+QVector<quint32> KisHistogramView::rebinForView(const QVector<quint32> &bins, qreal viewFrom, qreal viewWidth)
+{
+    /**
+     * Every bin of the full view is spread over the bins of the view it
+     * overlaps, proportionally to the overlap. The resolution of a
+     * zoomed view is therefore limited by the bins of the full view.
+     */
+    const int numBins = bins.size();
+    const qreal srcBinWidth = 1.0 / numBins;
+    const qreal dstBinWidth = viewWidth / numBins;
+
+    QVector<qreal> values(numBins, 0.0);
+
+    for (int k = 0; k < numBins; k++) {
+        if (!bins[k]) continue;
+
+        const qreal srcStart = k * srcBinWidth;
+        const qreal srcEnd = srcStart + srcBinWidth;
+
+        const int first = qMax(0, int(std::floor((srcStart - viewFrom) / dstBinWidth)));
+        const int last = qMin(numBins - 1, int(std::ceil((srcEnd - viewFrom) / dstBinWidth)) - 1);
+
+        for (int j = first; j <= last; j++) {
+            const qreal dstStart = viewFrom + j * dstBinWidth;
+            const qreal overlap = qMin(srcEnd, dstStart + dstBinWidth) - qMax(srcStart, dstStart);
+
+            if (overlap > 0) {
+                values[j] += bins[k] * overlap / srcBinWidth;
+            }
+        }
+    }
+
+    QVector<quint32> result(numBins);
+    for (int j = 0; j < numBins; j++) {
+        result[j] = qRound(values[j]);
+    }
+
+    return result;
+}
+
+void KisHistogramView::mergeTileBins()
+{
+    if (!m_currentProducer) return;
+
+    const int numChannels = m_currentProducer->channels().size();
+    const int numBins = m_currentProducer->numberOfBins();
+
+    m_mergedBins.fill(QVector<quint32>(numBins, 0), numChannels);
+    m_mergedHighest = 0;
+
+    Q_FOREACH (const TileData &tile, m_tiles) {
+        if (tile.bins.size() != numChannels) continue;
+
+        for (int chan = 0; chan < numChannels; chan++) {
+            const QVector<quint32> &src = tile.bins[chan];
+            if (src.size() != numBins) continue;
+
+            quint32 *dst = m_mergedBins[chan].data();
+            for (int i = 0; i < numBins; i++) {
+                dst[i] += src[i];
+            }
+        }
+    }
+
+    const qreal viewFrom = m_currentProducer->viewFrom();
+    const qreal viewWidth = m_currentProducer->viewWidth();
+
+    if (m_binsDependOnView && (viewFrom != 0.0 || viewWidth != 1.0)) {
+        for (int chan = 0; chan < numChannels; chan++) {
+            m_mergedBins[chan] = rebinForView(m_mergedBins[chan], viewFrom, viewWidth);
+        }
+    }
+
+    for (int chan = 0; chan < numChannels; chan++) {
+        if (m_currentProducer->channels().at(chan)->channelType() == KoChannelInfo::ALPHA) continue;
+
+        Q_FOREACH (quint32 value, m_mergedBins[chan]) {
+            m_mergedHighest = qMax(m_mergedHighest, value);
+        }
+    }
+}
+
+void KisHistogramView::fetchBinsFromProducer()
+{
+    const int numChannels = m_currentProducer->channels().size();
+    const int numBins = m_currentProducer->numberOfBins();
+
+    m_mergedBins.resize(numChannels);
+    m_mergedHighest = 0;
+
+    for (int chan = 0; chan < numChannels; chan++) {
+        QVector<quint32> &bins = m_mergedBins[chan];
+        bins.resize(numBins);
+
+        const bool isAlpha = m_currentProducer->channels().at(chan)->channelType() == KoChannelInfo::ALPHA;
+
+        for (int i = 0; i < numBins; i++) {
+            bins[i] = m_currentProducer->getBinAt(chan, i);
+            if (!isAlpha) {
+                m_mergedHighest = qMax(m_mergedHighest, bins[i]);
+            }
+        }
+    }
 }
 
 void KisHistogramView::mousePressEvent(QMouseEvent * e)
@@ -179,22 +551,13 @@ void KisHistogramView::paintEvent(QPaintEvent *event)
             selTo = 2;
         }
 
-        float highest = 0;
-
         if(m_channels.count()==0){
             m_channels=m_currentProducer->channels();
         }
-        int nChannels = m_channels.size();
+        int nChannels = qMin(m_channels.size(), m_mergedBins.size());
 
-        // First we iterate once, so that we have the overall maximum. This is a bit inefficient,
-        // but not too much since the histogram caches the calculations
-        for (int chan = 0; chan < m_channels.size(); chan++) {
-            if( m_channels.at(chan)->channelType() != KoChannelInfo::ALPHA ){
-                m_histogram->setChannel(chan);
-                if ((float)m_histogram->calculations().getHighest() > highest)
-                    highest = (float)m_histogram->calculations().getHighest();
-            }
-        }
+        // the maximum is calculated when the tile bins are merged
+        float highest = m_mergedHighest;
         highest = (m_histogram_type==LINEAR)? highest: std::log2(highest);
 
         painter.setWindow(QRect(-1,0,bins+1,highest));
@@ -213,10 +576,10 @@ void KisHistogramView::paintEvent(QPaintEvent *event)
                 if (m_smoothHistogram){
                     QPainterPath path;
 
-                    m_histogram->setChannel(chan);
+                    const QVector<quint32> &values = m_mergedBins[chan];
                     path.moveTo(QPointF(-1,highest));
-                    for (qint32 i = 0; i < bins; ++i) {
-                        float v = (m_histogram_type==LINEAR)? highest-m_histogram->getValue(i): highest-std::log2(m_histogram->getValue(i));
+                    for (qint32 i = 0; i < bins && i < values.size(); ++i) {
+                        float v = (m_histogram_type==LINEAR)? highest-values[i]: highest-std::log2(values[i]);
                         path.lineTo(QPointF(i,v));
 
                     }
@@ -227,9 +590,9 @@ void KisHistogramView::paintEvent(QPaintEvent *event)
                 else {
                     pen.setWidth(1);
                     painter.setPen(pen);
-                    m_histogram->setChannel(chan);
-                    for (qint32 i = 0; i < bins; ++i) {
-                        float v = (m_histogram_type==LINEAR)? highest-m_histogram->getValue(i): highest-std::log2(m_histogram->getValue(i));
+                    const QVector<quint32> &values = m_mergedBins[chan];
+                    for (qint32 i = 0; i < bins && i < values.size(); ++i) {
+                        float v = (m_histogram_type==LINEAR)? highest-values[i]: highest-std::log2(values[i]);
                         painter.drawLine(QPointF(i,highest),QPointF(i,v));
                     }
                 }
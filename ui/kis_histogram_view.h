@@ -25,6 +25,7 @@
 #include <QStringList>
 #include <QMouseEvent>
 #include <QSharedPointer>
+#include <QFutureWatcher>
 
 #include "kis_types.h"
 #include "kis_histogram.h"
@@ -33,6 +34,7 @@
 
 
 class KoChannelInfo;
+class KoColorSpace;
 
 /**
  * This class displays a histogram. It has a list of channels it can
@@ -52,6 +54,15 @@ class KoChannelInfo;
  * listProducers(). Setting a histogram will discard info on the
  * layer, and setting a layer will discard info on the histogram.
  *
+ * The bins are calculated asynchronously. The bounds of the device are
+ * split into tiles, every tile is binned on its own in a worker thread,
+ * and the result is merged from the cached per-tile bins. An update
+ * rebins only the tiles whose content has changed: the tiles outside
+ * the passed dirty rect are not touched at all, and the tiles inside it
+ * are compared by a checksum first. The tiles are binned for the full
+ * view, so changing the view, the histogram type or the displayed
+ * channels doesn't touch the pixels at all.
+ *
  **/
 class KRITAUI_EXPORT KisHistogramView : public QLabel
 {
@@ -81,6 +92,13 @@ public Q_SLOTS:
     virtual void setHistogramType(enumHistogramType type);
     virtual void startUpdateCanvasProjection();
 
+    /**
+     * Updates the histogram after the pixels in \p dirtyRect of the
+     * device have changed. Only the tiles intersecting the rect are
+     * checked for changes.
+     */
+    virtual void startUpdateCanvasProjection(const QRect &dirtyRect);
+
 Q_SIGNALS:
     void rightClicked(const QPoint& pos);
 
@@ -88,6 +106,45 @@ protected:
 
     void mousePressEvent(QMouseEvent * e) override;
 
+private Q_SLOTS:
+    void slotTileCalculationFinished();
+
+private:
+    struct TileData {
+        QRect rect;
+        int revision = 0;
+        int cachedRevision = -1;
+        quint64 checksum = 0;
+        QVector<QVector<quint32>> bins;
+    };
+
+    struct TileJob {
+        KisPaintDeviceSP device;
+        QString producerId;
+        QRect rect;
+        int index;
+        int revision;
+        bool hasCachedBins;
+        quint64 cachedChecksum;
+    };
+
+    struct TileResult {
+        int index;
+        int revision;
+        quint64 checksum;
+        bool binsChanged;
+        QVector<QVector<quint32>> bins;
+    };
+
+    static TileResult calculateTileBins(const TileJob &job);
+    static bool binsDependOnView(KoHistogramProducer *producer, const KoColorSpace *cs);
+    static QVector<quint32> rebinForView(const QVector<quint32> &bins, qreal viewFrom, qreal viewWidth);
+
+    void resetTileCache();
+    void invalidateTiles(const QRect &rc);
+    void mergeTileBins();
+    void fetchBinsFromProducer();
+
 private:
 
     void setChannels(void);
@@ -101,6 +158,18 @@ private:
     bool m_color;
     bool m_smoothHistogram;
     enumHistogramType m_histogram_type;
+
+    QVector<TileData> m_tiles;
+    int m_tilesGeneration;
+    int m_runningGeneration;
+    bool m_recalculationPending;
+    QFutureWatcher<TileResult> m_tilesWatcher;
+
+    QVector<QVector<quint32>> m_mergedBins;
+    quint32 m_mergedHighest;
+
+    bool m_binsDependOnView;
+    bool m_producerUpToDate;
 };
 
 #endif // _KIS_HISTOGRAM_VIEW_
@@ -107,6 +107,8 @@
 
 #include "KisSaveGroupVisitor.h"
 
+#include <QtConcurrent>
+
 KisLayerManager::KisLayerManager(KisViewManager * view)
     : m_view(view)
     , m_imageView(0)
@@ -373,72 +375,148 @@ void KisLayerManager::layerProperties()
     }
 }
 
-void KisLayerManager::convertNodeToPaintLayer(KisNodeSP source)
+namespace {
+
+struct RasterizeNodeJob {
+    KisNodeSP source;
+    KisPaintDeviceSP srcDevice;
+    const KoColorSpace *dstColorSpace = 0;
+    QString compositeOp;
+    bool putBehind = false;
+
+    KisPaintDeviceSP result;
+};
+
+void rasterizeNode(RasterizeNodeJob &job)
 {
-    KisImageWSP image = m_view->image();
-    if (!image) return;
+    KisPaintDeviceSP srcDevice = job.srcDevice;
 
+    if (*srcDevice->colorSpace() == *job.dstColorSpace) {
+        // the copy shares the tiles with the source device
+        job.result = new KisPaintDevice(*srcDevice);
+    } else {
+        job.result = new KisPaintDevice(job.dstColorSpace);
 
-    KisLayer *srcLayer = qobject_cast<KisLayer*>(source.data());
-    if (srcLayer && (srcLayer->inherits("KisGroupLayer") || srcLayer->layerStyle() || srcLayer->childCount() > 0)) {
-        image->flattenLayer(srcLayer);
-        return;
+        QRect rc(srcDevice->exactBounds());
+        KisPainter::copyAreaOptimized(rc.topLeft(), srcDevice, job.result, rc);
     }
+}
+
+/**
+ * Rasterizes the devices of all \p jobs concurrently, one job per node
+ */
+void rasterizeNodesConcurrently(QVector<RasterizeNodeJob> &jobs)
+{
+    QtConcurrent::blockingMap(jobs, rasterizeNode);
+}
+
+/**
+ * Removes the nodes that have one of their parents in the list,
+ * because they are rasterized together with that parent
+ */
+KisNodeList filterTopmostNodes(const KisNodeList &nodes)
+{
+    KisNodeList result;
 
+    Q_FOREACH (KisNodeSP node, nodes) {
+        bool hasSelectedParent = false;
 
-    KisPaintDeviceSP srcDevice =
-        source->paintDevice() ? source->projection() : source->original();
+        KisNodeSP parent = node->parent();
+        while (parent && !hasSelectedParent) {
+            hasSelectedParent = nodes.contains(parent);
+            parent = parent->parent();
+        }
 
-    bool putBehind = false;
-    QString newCompositeOp = source->compositeOpId();
-    KisColorizeMask *colorizeMask = dynamic_cast<KisColorizeMask*>(source.data());
-    if (colorizeMask) {
-        srcDevice = colorizeMask->coloringProjection();
-        putBehind = colorizeMask->compositeOpId() == COMPOSITE_BEHIND;
-        if (putBehind) {
-            newCompositeOp = COMPOSITE_OVER;
+        if (!hasSelectedParent && !result.contains(node)) {
+            result << node;
         }
     }
 
-    if (!srcDevice) return;
+    return result;
+}
 
-    KisPaintDeviceSP clone;
+}
 
-    if (*srcDevice->colorSpace() !=
-        *srcDevice->compositionSourceColorSpace()) {
+void KisLayerManager::convertNodeToPaintLayer(KisNodeSP source)
+{
+    convertNodesToPaintLayers(KisNodeList() << source);
+}
 
-        clone = new KisPaintDevice(srcDevice->compositionSourceColorSpace());
+void KisLayerManager::convertNodesToPaintLayers(KisNodeList sources)
+{
+    KisImageWSP image = m_view->image();
+    if (!image) return;
 
-        QRect rc(srcDevice->extent());
-        KisPainter::copyAreaOptimized(rc.topLeft(), srcDevice, clone, rc);
+    QVector<RasterizeNodeJob> jobs;
+    QList<KisLayerSP> layersToFlatten;
 
-    } else {
-        clone = new KisPaintDevice(*srcDevice);
-    }
+    Q_FOREACH (KisNodeSP source, filterTopmostNodes(sources)) {
+        KisLayerSP srcLayer = qobject_cast<KisLayer*>(source.data());
+        if (srcLayer && (srcLayer->inherits("KisGroupLayer") || srcLayer->layerStyle() || srcLayer->childCount() > 0)) {
+            layersToFlatten << srcLayer;
+            continue;
+        }
 
-    KisLayerSP layer = new KisPaintLayer(image,
-                                         source->name(),
-                                         source->opacity(),
-                                         clone);
-    layer->setCompositeOpId(newCompositeOp);
+        RasterizeNodeJob job;
+        job.source = source;
+        job.srcDevice = source->paintDevice() ? source->projection() : source->original();
+        job.compositeOp = source->compositeOpId();
+
+        KisColorizeMask *colorizeMask = dynamic_cast<KisColorizeMask*>(source.data());
+        if (colorizeMask) {
+            job.srcDevice = colorizeMask->coloringProjection();
+            job.putBehind = colorizeMask->compositeOpId() == COMPOSITE_BEHIND;
+            if (job.putBehind) {
+                job.compositeOp = COMPOSITE_OVER;
+            }
+        }
 
-    KisNodeSP parent = source->parent();
-    KisNodeSP above = source;
+        if (!job.srcDevice) continue;
 
-    while (parent && !parent->allowAsChild(layer)) {
-        above = above->parent();
-        parent = above ? above->parent() : 0;
+        job.dstColorSpace = job.srcDevice->compositionSourceColorSpace();
+        jobs << job;
     }
 
-    if (putBehind && above == source->parent()) {
-        above = above->prevSibling();
-    }
+    rasterizeNodesConcurrently(jobs);
 
-    m_commandsAdapter->beginMacro(kundo2_i18n("Convert to a Paint Layer"));
-    m_commandsAdapter->addNode(layer, parent, above);
-    m_commandsAdapter->removeNode(source);
-    m_commandsAdapter->endMacro();
+    if (!jobs.isEmpty()) {
+        m_commandsAdapter->beginMacro(kundo2_i18n("Convert to a Paint Layer"));
+
+        Q_FOREACH (const RasterizeNodeJob &job, jobs) {
+            KisNodeSP source = job.source;
+
+            KisLayerSP layer = new KisPaintLayer(image,
+                                                 source->name(),
+                                                 source->opacity(),
+                                                 job.result);
+            layer->setCompositeOpId(job.compositeOp);
+
+            KisNodeSP parent = source->parent();
+            KisNodeSP above = source;
+
+            while (parent && !parent->allowAsChild(layer)) {
+                above = above->parent();
+                parent = above ? above->parent() : 0;
+            }
+
+            if (job.putBehind && above == source->parent()) {
+                above = above->prevSibling();
+            }
+
+            m_commandsAdapter->addNode(layer, parent, above);
+            m_commandsAdapter->removeNode(source);
+        }
+
+        m_commandsAdapter->endMacro();
+    }
 
+    /**
+     * Flattening runs as a separate stroke of the image, so it cannot
+     * be a part of the macro above
+     */
+    Q_FOREACH (KisLayerSP layer, layersToFlatten) {
+        image->flattenLayer(layer);
+    }
 }
 
 void KisLayerManager::convertGroupToAnimated()
@@ -800,24 +878,45 @@ void KisLayerManager::rasterizeLayer()
     KisImageSP image = m_view->image();
     if (!image) return;
 
-    KisLayerSP layer = activeLayer();
-    if (!layer) return;
+    KisLayerSP activeLayer = this->activeLayer();
+    if (!activeLayer) return;
 
     if (!m_view->blockUntilOperationsFinished(image)) return;
 
-    KisPaintLayerSP paintLayer = new KisPaintLayer(image, layer->name(), layer->opacity());
-    KisPainter gc(paintLayer->paintDevice());
-    QRect rc = layer->projection()->exactBounds();
-    gc.bitBlt(rc.topLeft(), layer->projection(), rc);
+    KisNodeList nodes = m_view->nodeManager()->selectedNodes();
+    if (!nodes.contains(activeLayer)) {
+        nodes = KisNodeList() << activeLayer;
+    }
+
+    QVector<RasterizeNodeJob> jobs;
+    Q_FOREACH (KisNodeSP node, filterTopmostNodes(nodes)) {
+        KisLayerSP layer = qobject_cast<KisLayer*>(node.data());
+        if (!layer) continue;
+
+        RasterizeNodeJob job;
+        job.source = layer;
+        job.srcDevice = layer->projection();
+        job.dstColorSpace = image->colorSpace();
+        jobs << job;
+    }
+
+    rasterizeNodesConcurrently(jobs);
 
     m_commandsAdapter->beginMacro(kundo2_i18n("Rasterize Layer"));
-    m_commandsAdapter->addNode(paintLayer.data(), layer->parent().data(), layer.data());
 
-    int childCount = layer->childCount();
-    for (int i = 0; i < childCount; i++) {
-        m_commandsAdapter->moveNode(layer->firstChild(), paintLayer, paintLayer->lastChild());
+    Q_FOREACH (const RasterizeNodeJob &job, jobs) {
+        KisNodeSP layer = job.source;
+        KisPaintLayerSP paintLayer = new KisPaintLayer(image, layer->name(), layer->opacity(), job.result);
+
+        m_commandsAdapter->addNode(paintLayer.data(), layer->parent().data(), layer.data());
+
+        int childCount = layer->childCount();
+        for (int i = 0; i < childCount; i++) {
+            m_commandsAdapter->moveNode(layer->firstChild(), paintLayer, paintLayer->lastChild());
+        }
+        m_commandsAdapter->removeNode(layer);
     }
-    m_commandsAdapter->removeNode(layer);
+
     m_commandsAdapter->endMacro();
     updateGUI();
 }
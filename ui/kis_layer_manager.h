@@ -89,6 +89,15 @@ private Q_SLOTS:
     bool activeLayerHasSelection();
 
     void convertNodeToPaintLayer(KisNodeSP source);
+
+    /**
+     * Converts all \p sources into paint layers. The plain layers and
+     * masks are rasterized concurrently and replaced in a single undo
+     * command. Groups, layers with styles and layers with children are
+     * flattened by the image afterwards, each in its own undo step.
+     */
+    void convertNodesToPaintLayers(KisNodeList sources);
+
     void convertGroupToAnimated();
 
     void convertLayerToFileLayer(KisNodeSP source);
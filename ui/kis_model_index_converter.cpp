@@ -49,6 +49,25 @@ inline bool KisModelIndexConverter::checkDummyMetaObjectType(const QString &type
     return type != blacklistedType;
 }
 
+/**
+ * The root dummy keeps the index of its children that are not
+ * selection masks, so the rows of the root children are mapped in
+ * constant time, whether the global selection is shown or not.
+ */
+inline int KisModelIndexConverter::rootChildCount(KisNodeDummy *rootDummy)
+{
+    return m_showGlobalSelection ?
+        rootDummy->childCount() :
+        rootDummy->nonSelectionMaskChildCount();
+}
+
+inline int KisModelIndexConverter::rootChildrenBefore(KisNodeDummy *rootDummy, int index)
+{
+    return m_showGlobalSelection ?
+        index :
+        rootDummy->nonSelectionMaskChildrenBefore(index);
+}
+
 KisNodeDummy* KisModelIndexConverter::dummyFromRow(int row, QModelIndex parent)
 {
 
@@ -61,16 +80,13 @@ KisNodeDummy* KisModelIndexConverter::dummyFromRow(int row, QModelIndex parent)
 
     // a child of the root node
     if(!parentDummy->parent()) {
-        KisNodeDummy *currentDummy = parentDummy->lastChild();
-        while(currentDummy) {
-            if(checkDummyType(currentDummy)) {
-                if(!row) {
-                    resultDummy = currentDummy;
-                    break;
-                }
-                row--;
-            }
-            currentDummy = currentDummy->prevSibling();
+        int rowCount = rootChildCount(parentDummy);
+        int index = rowCount - row - 1;
+
+        if(index >= 0 && index < rowCount) {
+            resultDummy = m_showGlobalSelection ?
+                parentDummy->at(index) :
+                parentDummy->nonSelectionMaskChildAt(index);
         }
     }
     // a child of other layer
@@ -105,13 +121,9 @@ QModelIndex KisModelIndexConverter::indexFromDummy(KisNodeDummy *dummy)
     if(!parentDummy->parent()) {
         if(!checkDummyType(dummy)) return QModelIndex();
 
-        KisNodeDummy *currentDummy = parentDummy->lastChild();
-        while(currentDummy && currentDummy != dummy) {
-            if(checkDummyType(currentDummy)) {
-                row++;
-            }
-            currentDummy = currentDummy->prevSibling();
-        }
+        int rowCount = rootChildCount(parentDummy);
+        int index = rootChildrenBefore(parentDummy, parentDummy->indexOf(dummy));
+        row = rowCount - index - 1;
     }
     // a child of other layer
     else {
@@ -141,18 +153,9 @@ bool KisModelIndexConverter::indexFromAddedDummy(KisNodeDummy *parentDummy,
             return false;
         }
 
-        row = 0;
-
         parentIndex = QModelIndex();
-        KisNodeDummy *dummy = parentDummy->lastChild();
-        int toScan = parentDummy->childCount() - index;
-        while(dummy && toScan > 0) {
-            if(checkDummyType(dummy)) {
-                row++;
-            }
-            dummy = dummy->prevSibling();
-            toScan--;
-        }
+        int rowCount = rootChildCount(parentDummy);
+        row = rowCount - rootChildrenBefore(parentDummy, index);
     }
     // everything else
     else {
@@ -176,14 +179,7 @@ int KisModelIndexConverter::rowCount(QModelIndex parent)
 
     // children of the root node
     if(!dummy->parent()) {
-        KisNodeDummy *currentDummy = dummy->lastChild();
-        while(currentDummy) {
-            if(checkDummyType(currentDummy)) {
-                numChildren++;
-            }
-
-            currentDummy = currentDummy->prevSibling();
-        }
+        numChildren = rootChildCount(dummy);
     }
     // children of other nodes
     else {
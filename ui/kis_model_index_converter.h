@@ -51,6 +51,8 @@ public:
 private:
     inline bool checkDummyType(KisNodeDummy *dummy);
     inline bool checkDummyMetaObjectType(const QString &type);
+    inline int rootChildCount(KisNodeDummy *rootDummy);
+    inline int rootChildrenBefore(KisNodeDummy *rootDummy, int index);
 
 private:
     KisDummiesFacadeBase *m_dummiesFacade;
@@ -129,4 +129,79 @@ KisMultinodePropertyInterface::~KisMultinodePropertyInterface()
 {
 }
 
+/******************************************************************/
+/*               KisMultinodePropertyBatchCommand                 */
+/******************************************************************/
+
+KisMultinodePropertyBatchCommand::KisMultinodePropertyBatchCommand(KisNodeList nodes, KUndo2Command *parent)
+    : KUndo2Command(parent),
+      m_nodes(nodes)
+{
+}
+
+KisMultinodePropertyBatchCommand::~KisMultinodePropertyBatchCommand()
+{
+}
+
+void KisMultinodePropertyBatchCommand::addProperty(KisMultinodePropertyInterfaceSP prop)
+{
+    if (prop->isIgnored()) return;
+    m_commands.append(toQShared(prop->createPostExecutionUndoCommand()));
+}
+
+void KisMultinodePropertyBatchCommand::undo()
+{
+    for (auto it = m_commands.rbegin(); it != m_commands.rend(); ++it) {
+        (*it)->undo();
+    }
+    updateNodes(m_nodes);
+}
+
+void KisMultinodePropertyBatchCommand::redo()
+{
+    Q_FOREACH (KUndo2CommandSP command, m_commands) {
+        command->redo();
+    }
+    updateNodes(m_nodes);
+}
+
+void KisMultinodePropertyBatchCommand::updateNodes(KisNodeList nodes)
+{
+    /**
+     * The properties of a node (opacity, visibility, composite op,
+     * channel flags) affect only the way it is composed into its
+     * parent. We cannot just dirty the parent itself, because then the
+     * merge walker would reuse its original and would not compose the
+     * children again. Instead, we start a single walker per parent from
+     * its first changed child and pass it the united rect of all the
+     * changed siblings, so all of them are recomposed in one go.
+     */
+    QList<KisNodeSP> parents;
+    QHash<KisNode*, KisNodeSP> firstChangedChild;
+    QHash<KisNode*, QRect> dirtyRects;
+
+    Q_FOREACH (KisNodeSP node, nodes) {
+        KisNodeSP parent = node->parent();
+
+        if (!parent) {
+            node->setDirty();
+            continue;
+        }
+
+        if (!firstChangedChild.contains(parent.data())) {
+            parents.append(parent);
+            firstChangedChild.insert(parent.data(), node);
+        }
+
+        dirtyRects[parent.data()] |= node->extent();
+    }
+
+    Q_FOREACH (KisNodeSP parent, parents) {
+        const QRect rc = dirtyRects.value(parent.data());
+        if (!rc.isEmpty()) {
+            firstChangedChild.value(parent.data())->setDirty(rc);
+        }
+    }
+}
+
 #include "kis_multinode_property.moc"
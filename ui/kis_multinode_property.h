@@ -643,6 +643,43 @@ private:
     QScopedPointer<MultinodePropertyConnectorInterface> m_connector;
 };
 
+/******************************************************************/
+/*               KisMultinodePropertyBatchCommand                 */
+/******************************************************************/
+
+/**
+ * Applies the changes of several multinode properties as a single undo
+ * command. The nodes are not updated after every property change;
+ * instead, the dirty rects of all the nodes are merged per parent and
+ * the children of every parent are recomposed only once, when the
+ * whole batch has been undone or redone.
+ */
+class KRITAUI_EXPORT KisMultinodePropertyBatchCommand : public KUndo2Command
+{
+public:
+    KisMultinodePropertyBatchCommand(KisNodeList nodes, KUndo2Command *parent = 0);
+    ~KisMultinodePropertyBatchCommand() override;
+
+    /**
+     * Adds a post-execution undo command of \p prop to the batch. Ignored
+     * properties are skipped.
+     */
+    void addProperty(KisMultinodePropertyInterfaceSP prop);
+
+    void undo() override;
+    void redo() override;
+
+    /**
+     * Requests an update of \p nodes with a single walker per parent
+     * instead of a separate update for every node
+     */
+    static void updateNodes(KisNodeList nodes);
+
+private:
+    KisNodeList m_nodes;
+    QVector<KUndo2CommandSP> m_commands;
+};
+
 
 typedef KisMultinodeProperty<CompositeOpAdapter> KisMultinodeCompositeOpProperty;
 typedef KisMultinodeProperty<OpacityAdapter> KisMultinodeOpacityProperty;
@@ -21,6 +21,7 @@
 #include <QHash>
 #include <QSharedPointer>
 #include <QPointer>
+#include <QtConcurrent>
 
 #include "kis_global.h"
 #include "kis_image.h"
@@ -449,6 +450,85 @@ private:
     bool m_lower;
 };
 
+namespace {
+
+struct CloneNodeJob {
+    KisNodeSP source;
+    KisNodeSP clone;
+};
+
+void cloneNode(CloneNodeJob &job)
+{
+    job.clone = job.source->clone();
+    KisLayerUtils::addCopyOfNameTag(job.clone);
+}
+
+/**
+ * Only the nodes whose cloning cost is the cost of copying their
+ * paint devices are safe to be cloned concurrently. Other nodes (e.g.
+ * shape, file or colorize layers and transform masks) create QObjects,
+ * timers or shape trees that were never meant to be created in
+ * parallel.
+ */
+bool canBeClonedConcurrently(KisNodeSP node)
+{
+    if (!node->inherits("KisPaintLayer") &&
+        !node->inherits("KisGroupLayer") &&
+        !node->inherits("KisTransparencyMask")) {
+
+        return false;
+    }
+
+    KisNodeSP child = node->firstChild();
+    while (child) {
+        if (!canBeClonedConcurrently(child)) return false;
+        child = child->nextSibling();
+    }
+
+    return true;
+}
+
+/**
+ * Clones the nodes concurrently. The paint devices of the clones share
+ * the tile data with the originals (the tiles are copied only when
+ * either of the devices is written into), so most of the cloning time
+ * is spent on walking the tile tables and creating the nodes, which
+ * doesn't depend on the other nodes. The nodes that cannot be cloned
+ * concurrently are cloned one after another in the calling thread.
+ */
+KisNodeList cloneNodesConcurrently(const KisNodeList &nodes)
+{
+    QVector<CloneNodeJob> jobs(nodes.size());
+    QVector<CloneNodeJob*> concurrentJobs;
+
+    for (int i = 0; i < nodes.size(); i++) {
+        jobs[i].source = nodes[i];
+
+        if (canBeClonedConcurrently(nodes[i])) {
+            concurrentJobs << &jobs[i];
+        } else {
+            cloneNode(jobs[i]);
+        }
+    }
+
+    if (concurrentJobs.size() > 1) {
+        QtConcurrent::blockingMap(concurrentJobs, [] (CloneNodeJob *job) { cloneNode(*job); });
+    } else {
+        Q_FOREACH (CloneNodeJob *job, concurrentJobs) {
+            cloneNode(*job);
+        }
+    }
+
+    KisNodeList clones;
+    Q_FOREACH (const CloneNodeJob &job, jobs) {
+        clones << job.clone;
+    }
+
+    return clones;
+}
+
+}
+
 struct DuplicateLayers : public KisCommandUtils::AggregateCommand {
     enum Mode {
         MOVE,
@@ -502,19 +582,17 @@ struct DuplicateLayers : public KisCommandUtils::AggregateCommand {
                                                          false));
         }
 
+        const KisNodeList clonedNodes =
+            m_mode == COPY ? cloneNodesConcurrently(filteredNodes) : KisNodeList();
+
         KisNodeList newNodes;
         QList<KisSelectionMaskSP> newActiveMasks;
         KisNodeSP currentAbove = newAbove;
-        Q_FOREACH (KisNodeSP node, filteredNodes) {
-            if (m_mode == COPY || m_mode == ADD) {
-                KisNodeSP newNode;
+        for (int i = 0; i < filteredNodes.size(); i++) {
+            KisNodeSP node = filteredNodes[i];
 
-                if (m_mode == COPY) {
-                    newNode = node->clone();
-                    KisLayerUtils::addCopyOfNameTag(newNode);
-                } else {
-                    newNode = node;
-                }
+            if (m_mode == COPY || m_mode == ADD) {
+                KisNodeSP newNode = m_mode == COPY ? clonedNodes[i] : node;
 
                 newNodes << newNode;
                 if (haveActiveMasks && toActiveSelectionMask(node)) {
@@ -66,7 +66,7 @@
 #include "kis_action.h"
 #include "kis_action_manager.h"
 #include "kis_processing_applicator.h"
-#include "kis_sequential_iterator.h"
+#include "kis_iterator_ng.h"
 #include "kis_transaction.h"
 #include "kis_node_selection_adapter.h"
 #include "kis_node_insertion_adapter.h"
@@ -78,11 +78,22 @@
 #include "krita_utils.h"
 #include "kis_shape_layer.h"
 
-#include "processing/kis_mirror_processing_visitor.h"
+#include "processing/kis_striped_mirror_processing_visitor.h"
 #include "KisView.h"
 
 #include <kis_signals_blocker.h>
 
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QtConcurrent>
+
+#include <KoUpdater.h>
+
+#include "kis_processing_visitor.h"
+#include "kis_transparency_mask.h"
+#include "commands/kis_image_layer_add_command.h"
+#include "commands/kis_image_layer_remove_command.h"
+
 struct KisNodeManager::Private {
 
     Private(KisNodeManager *_q, KisViewManager *v)
@@ -576,7 +587,12 @@ void KisNodeManager::convertNode(const QString &nodeType)
     if (!activeNode) return;
 
     if (nodeType == "KisPaintLayer") {
-        m_d->layerManager.convertNodeToPaintLayer(activeNode);
+        KisNodeList nodes = selectedNodes();
+        if (!nodes.contains(activeNode)) {
+            nodes = KisNodeList() << activeNode;
+        }
+
+        m_d->layerManager.convertNodesToPaintLayers(nodes);
     } else if (nodeType == "KisSelectionMask" ||
                nodeType == "KisFilterMask" ||
                nodeType == "KisTransparencyMask") {
@@ -987,7 +1003,7 @@ void KisNodeManager::mirrorNode(KisNodeSP node, const KUndo2MagicString& actionN
                                        emitSignals, actionName);
 
     KisProcessingVisitorSP visitor =
-        new KisMirrorProcessingVisitor(m_d->view->image()->bounds(), orientation);
+        new KisStripedMirrorProcessingVisitor(m_d->view->image()->bounds(), orientation);
 
     applicator.applyVisitor(visitor, KisStrokeJobData::CONCURRENT);
     applicator.end();
@@ -1091,6 +1107,254 @@ void KisNodeManager::saveVectorLayerAsImage()
     }
 }
 
+namespace {
+
+/**
+ * Sets the alpha channel of \p numPixels pixels to the values from
+ * \p alpha. setOpacity() is a virtual call, so it is called once for
+ * every run of equal alpha values, which are very common in masks.
+ */
+void writeAlphaRuns(const KoColorSpace *cs, quint8 *pixels, const quint8 *alpha, int numPixels)
+{
+    const int pixelSize = cs->pixelSize();
+
+    int i = 0;
+    while (i < numPixels) {
+        const quint8 value = alpha[i];
+
+        int runLength = 1;
+        while (i + runLength < numPixels && alpha[i + runLength] == value) {
+            runLength++;
+        }
+
+        cs->setOpacity(pixels + i * pixelSize, value, runLength);
+        i += runLength;
+    }
+}
+
+/**
+ * Calls \p func for every run of consecutive pixels of \p device in
+ * \p rc. The second argument of \p func is the offset of the run in
+ * the rect in pixels.
+ */
+template <typename Func>
+void processRowRuns(KisPaintDeviceSP device, const QRect &rc, Func func)
+{
+    KisHLineIteratorSP it = device->createHLineIteratorNG(rc.x(), rc.y(), rc.width());
+
+    for (int y = 0; y < rc.height(); y++) {
+        int x = 0;
+
+        while (x < rc.width()) {
+            const int numPixels = qMin(it->nConseqPixels(), rc.width() - x);
+            func(it->rawData(), y * rc.width() + x, numPixels);
+
+            x += numPixels;
+            it->nextPixels(numPixels);
+        }
+
+        it->nextRow();
+    }
+}
+
+void writeAlphaPatch(KisPaintDeviceSP selectionDevice, KisPaintDeviceSP dstDevice, const QRect &rc)
+{
+    const KoColorSpace *dstCS = dstDevice->colorSpace();
+
+    QVector<quint8> alpha(rc.width() * rc.height());
+    selectionDevice->readBytes(alpha.data(), rc);
+
+    processRowRuns(dstDevice, rc,
+        [dstCS, &alpha] (quint8 *pixels, int offset, int numPixels) {
+            writeAlphaRuns(dstCS, pixels, alpha.constData() + offset, numPixels);
+        });
+}
+
+void splitAlphaPatch(KisPaintDeviceSP srcDevice, KisPaintDeviceSP selectionDevice, const QRect &rc)
+{
+    const KoColorSpace *srcCS = srcDevice->colorSpace();
+
+    QVector<quint8> alpha(rc.width() * rc.height());
+
+    processRowRuns(srcDevice, rc,
+        [srcCS, &alpha] (quint8 *pixels, int offset, int numPixels) {
+            srcCS->copyOpacityU8(pixels, alpha.data() + offset, numPixels);
+            srcCS->setOpacity(pixels, OPACITY_OPAQUE_U8, numPixels);
+        });
+
+    selectionDevice->writeBytes(alpha.constData(), rc);
+}
+
+/**
+ * The state shared by the commands of an alpha processing stroke.
+ * The whole device is changed under a single transaction: it is
+ * started by BeginAlphaProcessingCommand, the patches are processed
+ * by concurrent AlphaPatchCommand's and the transaction is finished
+ * by EndAlphaProcessingCommand.
+ */
+struct AlphaProcessingData
+{
+    AlphaProcessingData(KisNodeSP _node, KisPaintDeviceSP _device,
+                        const QRect &_processRect, int _numPatches)
+        : node(_node),
+          device(_device),
+          processRect(_processRect),
+          numPatches(_numPatches)
+    {
+    }
+
+    KisNodeSP node;
+    KisPaintDeviceSP device;
+    QRect processRect;
+    int numPatches;
+    QAtomicInt numProcessedPatches;
+
+    QScopedPointer<KisTransaction> transaction;
+    QScopedPointer<KUndo2Command> transactionCommand;
+    QScopedPointer<KisProcessingVisitor::ProgressHelper> progressHelper;
+    KoUpdater *progressUpdater = 0;
+};
+
+typedef QSharedPointer<AlphaProcessingData> AlphaProcessingDataSP;
+
+class BeginAlphaProcessingCommand : public KUndo2Command
+{
+public:
+    BeginAlphaProcessingCommand(AlphaProcessingDataSP data) : m_data(data) {}
+
+    void redo() override {
+        // redoing of the finished processing is done by EndAlphaProcessingCommand
+        if (m_data->transactionCommand) return;
+
+        m_data->transaction.reset(new KisTransaction(kundo2_noi18n("__alpha_processing__"), m_data->device));
+        m_data->progressHelper.reset(new KisProcessingVisitor::ProgressHelper(m_data->node));
+        m_data->progressUpdater = m_data->progressHelper->updater();
+    }
+
+    void undo() override {
+        // the stroke has been cancelled before the transaction was finished
+        if (m_data->transaction) {
+            m_data->transaction->revert();
+            m_data->transaction.reset();
+            m_data->progressUpdater = 0;
+            m_data->progressHelper.reset();
+        }
+    }
+
+private:
+    AlphaProcessingDataSP m_data;
+};
+
+class AlphaPatchCommand : public KUndo2Command
+{
+public:
+    AlphaPatchCommand(AlphaProcessingDataSP data, std::function<void ()> func)
+        : m_data(data), m_func(func) {}
+
+    void redo() override {
+        if (m_isProcessed) return;
+
+        m_func();
+        m_isProcessed = true;
+
+        if (m_data->progressUpdater) {
+            const int numProcessed = m_data->numProcessedPatches.fetchAndAddOrdered(1) + 1;
+            m_data->progressUpdater->setProgress(100 * numProcessed / m_data->numPatches);
+        }
+    }
+
+    void undo() override {
+        // the pixels are restored by the transaction
+    }
+
+private:
+    AlphaProcessingDataSP m_data;
+    std::function<void ()> m_func;
+    bool m_isProcessed = false;
+};
+
+class EndAlphaProcessingCommand : public KUndo2Command
+{
+public:
+    EndAlphaProcessingCommand(AlphaProcessingDataSP data) : m_data(data) {}
+
+    void redo() override {
+        if (m_data->transactionCommand) {
+            m_data->transactionCommand->redo();
+            return;
+        }
+
+        m_data->transactionCommand.reset(m_data->transaction->endAndTake());
+        m_data->transaction.reset();
+        m_data->progressUpdater = 0;
+        m_data->progressHelper.reset();
+
+        m_data->node->setDirty(m_data->processRect);
+    }
+
+    void undo() override {
+        m_data->transactionCommand->undo();
+    }
+
+private:
+    AlphaProcessingDataSP m_data;
+};
+
+/**
+ * Adds the jobs that call \p func for the patches of \p processRect
+ * concurrently to \p applicator. The changes of \p device are undone
+ * as a whole, and so are the changes done by the patches that have
+ * already been processed when the stroke is cancelled.
+ */
+void applyAlphaProcessing(KisProcessingApplicator &applicator,
+                          KisNodeSP node, KisPaintDeviceSP device,
+                          const QRect &processRect,
+                          std::function<void (const QRect &)> func)
+{
+    const QVector<QRect> patches =
+        KritaUtils::splitRectIntoPatches(processRect, KritaUtils::optimalPatchSize());
+
+    AlphaProcessingDataSP data(new AlphaProcessingData(node, device, processRect, patches.size()));
+
+    applicator.applyCommand(new BeginAlphaProcessingCommand(data), KisStrokeJobData::SEQUENTIAL);
+
+    Q_FOREACH (const QRect &patch, patches) {
+        applicator.applyCommand(new AlphaPatchCommand(data, std::bind(func, patch)),
+                                KisStrokeJobData::CONCURRENT);
+    }
+
+    applicator.applyCommand(new EndAlphaProcessingCommand(data), KisStrokeJobData::SEQUENTIAL);
+}
+
+/**
+ * Initializes the selection of the mask from a device filled by
+ * the stroke. The mask is not in the graph yet, so no updates needed.
+ */
+class InitMaskSelectionCommand : public KUndo2Command
+{
+public:
+    InitMaskSelectionCommand(KisMaskSP mask, KisPaintDeviceSP device, KisLayerSP parentLayer)
+        : m_mask(mask), m_device(device), m_parentLayer(parentLayer) {}
+
+    void redo() override {
+        if (m_isInitialized) return;
+
+        m_mask->initSelection(m_device, m_parentLayer);
+        m_isInitialized = true;
+    }
+
+    void undo() override {
+    }
+
+private:
+    KisMaskSP m_mask;
+    KisPaintDeviceSP m_device;
+    KisLayerSP m_parentLayer;
+    bool m_isInitialized = false;
+};
+
+}
+
 void KisNodeManager::slotSplitAlphaIntoMask()
 {
     KisNodeSP node = activeNode();
@@ -1099,7 +1363,6 @@ void KisNodeManager::slotSplitAlphaIntoMask()
     KIS_ASSERT_RECOVER_RETURN(node->hasEditablePaintDevice());
 
     KisPaintDeviceSP srcDevice = node->paintDevice();
-    const KoColorSpace *srcCS = srcDevice->colorSpace();
     const QRect processRect =
         srcDevice->exactBounds() |
         srcDevice->defaultBounds()->bounds();
@@ -1107,24 +1370,39 @@ void KisNodeManager::slotSplitAlphaIntoMask()
     KisPaintDeviceSP selectionDevice =
         new KisPaintDevice(KoColorSpaceRegistry::instance()->alpha8());
 
-    m_d->commandsAdapter.beginMacro(kundo2_i18n("Split Alpha into a Mask"));
-    KisTransaction transaction(kundo2_noi18n("__split_alpha_channel__"), srcDevice);
+    KisMaskSP mask = new KisTransparencyMask();
 
-    KisSequentialIterator srcIt(srcDevice, processRect);
-    KisSequentialIterator dstIt(selectionDevice, processRect);
+    KisNodeSP parent;
+    KisNodeSP above;
+    m_d->maskManager.adjustMaskPosition(mask, node, false, parent, above);
 
-    while (srcIt.nextPixel() && dstIt.nextPixel()) {
-        quint8 *srcPtr = srcIt.rawData();
-        quint8 *alpha8Ptr = dstIt.rawData();
+    KisLayerSP parentLayer = qobject_cast<KisLayer*>(parent.data());
+    KIS_ASSERT_RECOVER_RETURN(parentLayer);
 
-        *alpha8Ptr = srcCS->opacityU8(srcPtr);
-        srcCS->setOpacity(srcPtr, OPACITY_OPAQUE_U8, 1);
-    }
+    const int maskNumber =
+        parentLayer->childNodes(QStringList("KisTransparencyMask"), KoProperties()).count() + 1;
+    mask->setName(i18n("Transparency Mask") + QString(" ") + QString::number(maskNumber));
 
-    m_d->commandsAdapter.addExtraCommand(transaction.endAndTake());
+    /**
+     * The patches are processed in a stroke, so the user can see the
+     * progress of the operation and cancel it. A cancelled stroke
+     * leaves no traces in the image and in the undo history.
+     */
+    KisImageSignalVector emitSignals;
+    emitSignals << ModifiedSignal;
 
-    createNode("KisTransparencyMask", false, selectionDevice);
-    m_d->commandsAdapter.endMacro();
+    KisImageSP image = m_d->view->image();
+    KisProcessingApplicator applicator(image, 0, KisProcessingApplicator::NONE,
+                                       emitSignals, kundo2_i18n("Split Alpha into a Mask"));
+
+    applyAlphaProcessing(applicator, node, srcDevice, processRect,
+                         std::bind(splitAlphaPatch, srcDevice, selectionDevice, std::placeholders::_1));
+
+    applicator.applyCommand(new InitMaskSelectionCommand(mask, selectionDevice, parentLayer),
+                            KisStrokeJobData::SEQUENTIAL);
+    applicator.applyCommand(new KisImageLayerAddCommand(image, mask, parentLayer, above),
+                            KisStrokeJobData::SEQUENTIAL, KisStrokeJobData::EXCLUSIVE);
+    applicator.end();
 }
 
 void KisNodeManager::Private::mergeTransparencyMaskAsAlpha(bool writeToLayers)
@@ -1156,8 +1434,6 @@ void KisNodeManager::Private::mergeTransparencyMaskAsAlpha(bool writeToLayers)
         dstDevice = new KisPaintDevice(*copyDevice);
     }
 
-    const KoColorSpace *dstCS = dstDevice->colorSpace();
-
     KisPaintDeviceSP selectionDevice = node->paintDevice();
     KIS_ASSERT_RECOVER_RETURN(selectionDevice->colorSpace()->pixelSize() == 1);
 
@@ -1166,28 +1442,35 @@ void KisNodeManager::Private::mergeTransparencyMaskAsAlpha(bool writeToLayers)
         dstDevice->exactBounds() |
         selectionDevice->defaultBounds()->bounds();
 
-    QScopedPointer<KisTransaction> transaction;
-
     if (writeToLayers) {
-        commandsAdapter.beginMacro(kundo2_i18n("Write Alpha into a Layer"));
-        transaction.reset(new KisTransaction(kundo2_noi18n("__write_alpha_channel__"), dstDevice));
-    }
-
-    KisSequentialIterator srcIt(selectionDevice, processRect);
-    KisSequentialIterator dstIt(dstDevice, processRect);
+        /**
+         * The patches are processed in a stroke, so the user can see
+         * the progress of the operation and cancel it
+         */
+        KisImageSignalVector emitSignals;
+        emitSignals << ModifiedSignal;
+
+        KisImageSP image = view->image();
+        KisProcessingApplicator applicator(image, 0, KisProcessingApplicator::NONE,
+                                           emitSignals, kundo2_i18n("Write Alpha into a Layer"));
+
+        applyAlphaProcessing(applicator, parentNode, dstDevice, processRect,
+                             std::bind(writeAlphaPatch, selectionDevice, dstDevice, std::placeholders::_1));
+
+        applicator.applyCommand(new KisImageLayerRemoveCommand(image, node),
+                                KisStrokeJobData::SEQUENTIAL, KisStrokeJobData::EXCLUSIVE);
+        applicator.end();
+    } else {
+        /**
+         * The copy of the device is not a part of the image, so it is
+         * processed right away. Exporting it takes much longer anyway.
+         */
+        QVector<QRect> patches =
+            KritaUtils::splitRectIntoPatches(processRect, KritaUtils::optimalPatchSize());
 
-    while (srcIt.nextPixel() && dstIt.nextPixel()) {
-        quint8 *alpha8Ptr = srcIt.rawData();
-        quint8 *dstPtr = dstIt.rawData();
+        QtConcurrent::blockingMap(patches,
+            std::bind(writeAlphaPatch, selectionDevice, dstDevice, std::placeholders::_1));
 
-        dstCS->setOpacity(dstPtr, *alpha8Ptr, 1);
-    }
-
-    if (writeToLayers) {
-        commandsAdapter.addExtraCommand(transaction->endAndTake());
-        commandsAdapter.removeNode(node);
-        commandsAdapter.endMacro();
-    } else {
         KisImageWSP image = view->image();
         QRect saveRect = image->bounds();
 
@@ -19,6 +19,7 @@
 #include "kis_node_model.h"
 
 #include <iostream>
+#include <algorithm>
 
 #include <QMimeData>
 #include <QBuffer>
@@ -60,7 +61,7 @@ struct KisNodeModel::Private
     KisShapeController *shapeController = 0;
     KisNodeSelectionAdapter *nodeSelectionAdapter = 0;
     KisNodeInsertionAdapter *nodeInsertionAdapter = 0;
-    QList<KisNodeDummy*> updateQueue;
+    QSet<KisNodeDummy*> updateQueue;
     QTimer updateTimer;
 
     KisModelIndexConverterBase *indexConverter = 0;
@@ -74,6 +75,17 @@ struct KisNodeModel::Private
     QPointer<KisNodeDummy> parentOfRemovedNode = 0;
 
     QSet<quintptr> dropEnabled;
+
+    /**
+     * The roles of an item that depend on the state of its parents,
+     * e.g. the item is grayed out when its parent is hidden
+     */
+    static QVector<int> parentDependentRoles() {
+        return QVector<int>() << KisNodeModel::ShouldGrayOutRole
+                              << KisNodeModel::PropertiesRole
+                              << Qt::TextColorRole
+                              << Qt::FontRole;
+    }
 };
 
 KisNodeModel::KisNodeModel(QObject * parent)
@@ -156,18 +168,74 @@ KisModelIndexConverterBase *KisNodeModel::createIndexConverter()
     }
 }
 
-void KisNodeModel::regenerateItems(KisNodeDummy *dummy)
+void addDescendantDummies(KisNodeDummy *dummy, QSet<KisNodeDummy*> *dummies)
 {
-    const QModelIndex &index = m_d->indexConverter->indexFromDummy(dummy);
-    emit dataChanged(index, index);
-
     dummy = dummy->firstChild();
     while (dummy) {
-        regenerateItems(dummy);
+        dummies->insert(dummy);
+        addDescendantDummies(dummy, dummies);
         dummy = dummy->nextSibling();
     }
 }
 
+void KisNodeModel::emitDataChanged(const QSet<KisNodeDummy*> &dummies, const QVector<int> &roles)
+{
+    QHash<QModelIndex, QVector<int>> rowsByParent;
+
+    Q_FOREACH (KisNodeDummy *dummy, dummies) {
+        const QModelIndex index = m_d->indexConverter->indexFromDummy(dummy);
+        if (!index.isValid()) continue;
+
+        rowsByParent[index.parent()].append(index.row());
+    }
+
+    for (auto it = rowsByParent.begin(); it != rowsByParent.end(); ++it) {
+        const QModelIndex &parent = it.key();
+        QVector<int> &rows = it.value();
+        std::sort(rows.begin(), rows.end());
+
+        int firstRow = rows.first();
+
+        for (int i = 1; i <= rows.size(); i++) {
+            if (i < rows.size() && rows[i] == rows[i - 1] + 1) continue;
+
+            emit dataChanged(index(firstRow, 0, parent), index(rows[i - 1], 0, parent), roles);
+
+            if (i < rows.size()) {
+                firstRow = rows[i];
+            }
+        }
+    }
+}
+
+void KisNodeModel::emitDataChangedRecursive(const QSet<KisNodeDummy*> &dummies)
+{
+    QSet<KisNodeDummy*> changedDummies;
+    QSet<KisNodeDummy*> descendantDummies;
+
+    Q_FOREACH (KisNodeDummy *dummy, dummies) {
+        // the children of an invisible item (e.g. the hidden root) are not updated
+        if (!m_d->indexConverter->indexFromDummy(dummy).isValid()) continue;
+
+        changedDummies.insert(dummy);
+        addDescendantDummies(dummy, &descendantDummies);
+    }
+
+    descendantDummies.subtract(changedDummies);
+
+    emitDataChanged(changedDummies, QVector<int>());
+    emitDataChanged(descendantDummies, Private::parentDependentRoles());
+}
+
+void KisNodeModel::regenerateItems(KisNodeDummy *dummy)
+{
+    QSet<KisNodeDummy*> dummies;
+    dummies.insert(dummy);
+    addDescendantDummies(dummy, &dummies);
+
+    emitDataChanged(dummies, QVector<int>());
+}
+
 void KisNodeModel::slotIsolatedModeChanged()
 {
     regenerateItems(m_d->dummiesFacade->rootDummy());
@@ -360,39 +428,16 @@ void KisNodeModel::slotEndRemoveDummy()
 
 void KisNodeModel::slotDummyChanged(KisNodeDummy *dummy)
 {
-    if (!m_d->updateQueue.contains(dummy)) {
-        m_d->updateQueue.append(dummy);
-    }
+    m_d->updateQueue.insert(dummy);
     m_d->updateTimer.start(1000);
 }
 
-void addChangedIndex(const QModelIndex &idx, QSet<QModelIndex> *indexes)
-{
-    if (!idx.isValid() || indexes->contains(idx)) return;
-
-    indexes->insert(idx);
-
-    const int rowCount = idx.model()->rowCount(idx);
-    for (int i = 0; i < rowCount; i++) {
-        addChangedIndex(idx.model()->index(i, 0, idx), indexes);
-    }
-}
-
-
 void KisNodeModel::processUpdateQueue()
 {
-    QSet<QModelIndex> indexes;
-
-    Q_FOREACH (KisNodeDummy *dummy, m_d->updateQueue) {
-        QModelIndex index = m_d->indexConverter->indexFromDummy(dummy);
-        addChangedIndex(index, &indexes);
-    }
+    QSet<KisNodeDummy*> dummies;
+    dummies.swap(m_d->updateQueue);
 
-    Q_FOREACH (const QModelIndex &index, indexes) {
-        emit dataChanged(index, index);
-    }
-
-    m_d->updateQueue.clear();
+    emitDataChangedRecursive(dummies);
 }
 
 QModelIndex KisNodeModel::index(int row, int col, const QModelIndex &parent) const
@@ -581,11 +626,9 @@ bool KisNodeModel::setData(const QModelIndex &index, const QVariant &value, int
 
     if(result) {
         if (shouldUpdateRecursively) {
-            QSet<QModelIndex> indexes;
-            addChangedIndex(index, &indexes);
-            Q_FOREACH (const QModelIndex &index, indexes) {
-                emit dataChanged(index, index);
-            }
+            QSet<KisNodeDummy*> dummies;
+            dummies.insert(m_d->indexConverter->dummyFromIndex(index));
+            emitDataChangedRecursive(dummies);
         } else {
             emit dataChanged(index, index);
         }
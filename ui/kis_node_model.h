@@ -23,8 +23,10 @@
 #include <QAbstractItemModel>
 #include <QIcon>
 #include <QList>
+#include <QSet>
 #include <QString>
 #include <QVariant>
+#include <QVector>
 
 class KisDummiesFacadeBase;
 class KisNodeDummy;
@@ -162,6 +164,18 @@ private:
     void resetIndexConverter();
 
     void regenerateItems(KisNodeDummy *dummy);
+
+    /**
+     * Emits dataChanged() for \p dummies, merging the contiguous
+     * sibling rows into a single range
+     */
+    void emitDataChanged(const QSet<KisNodeDummy*> &dummies, const QVector<int> &roles);
+
+    /**
+     * Emits dataChanged() for \p dummies and, with the roles that depend
+     * on the parent only, for all their descendants
+     */
+    void emitDataChangedRecursive(const QSet<KisNodeDummy*> &dummies);
     bool belongsToIsolatedGroup(KisNodeSP node) const;
 
 	void setDropEnabled(const QMimeData *data);
@@ -35,6 +35,8 @@
 #include <zlib.h>
 
 #include <QBuffer>
+#include <QElapsedTimer>
+#include <QtConcurrent>
 #include <QFile>
 #include <QApplication>
 
@@ -320,12 +322,148 @@ private:
     quint8* m_buf;
 };
 
+/**
+ * A range of rows of the device that should be converted into the
+ * PNG row format. The ranges are independent, so they are converted
+ * in parallel.
+ */
+struct KisPNGWriteRowsJob
+{
+    KisPaintDeviceSP device;
+    QRect rect;
+    png_byte **rowPointers;
+    int colorType;
+    int colorNbBits;
+    bool alpha;
+    png_colorp palette;
+    int numPalette;
+};
+
+void convertRowsForPNG(KisPNGWriteRowsJob &job)
+{
+    KisPaintDeviceSP device = job.device;
+    const QRect &rect = job.rect;
+    png_byte **row_pointers = job.rowPointers;
+    const int color_nb_bits = job.colorNbBits;
+
+    for (int y = rect.y(); y < rect.y() + rect.height(); y++, row_pointers++) {
+        KisHLineConstIteratorSP it = device->createHLineConstIteratorNG(rect.x(), y, rect.width());
+
+        *row_pointers = new png_byte[rect.width() * device->pixelSize()];
+
+        switch (job.colorType) {
+        case PNG_COLOR_TYPE_GRAY:
+        case PNG_COLOR_TYPE_GRAY_ALPHA:
+            if (color_nb_bits == 16) {
+                quint16 *dst = reinterpret_cast<quint16 *>(*row_pointers);
+                do {
+                    const quint16 *d = reinterpret_cast<const quint16 *>(it->oldRawData());
+                    *(dst++) = d[0];
+                    if (job.alpha) *(dst++) = d[1];
+                } while (it->nextPixel());
+            } else {
+                quint8 *dst = *row_pointers;
+                do {
+                    const quint8 *d = it->oldRawData();
+                    *(dst++) = d[0];
+                    if (job.alpha) *(dst++) = d[1];
+                } while (it->nextPixel());
+            }
+            break;
+        case PNG_COLOR_TYPE_RGB:
+        case PNG_COLOR_TYPE_RGB_ALPHA:
+            if (color_nb_bits == 16) {
+                quint16 *dst = reinterpret_cast<quint16 *>(*row_pointers);
+                do {
+                    const quint16 *d = reinterpret_cast<const quint16 *>(it->oldRawData());
+                    *(dst++) = d[2];
+                    *(dst++) = d[1];
+                    *(dst++) = d[0];
+                    if (job.alpha) *(dst++) = d[3];
+                } while (it->nextPixel());
+            } else {
+                quint8 *dst = *row_pointers;
+                do {
+                    const quint8 *d = it->oldRawData();
+                    *(dst++) = d[2];
+                    *(dst++) = d[1];
+                    *(dst++) = d[0];
+                    if (job.alpha) *(dst++) = d[3];
+                } while (it->nextPixel());
+            }
+            break;
+        case PNG_COLOR_TYPE_PALETTE: {
+            quint8 *dst = *row_pointers;
+            KisPNGWriteStream writestream(dst, color_nb_bits);
+            do {
+                const quint8 *d = it->oldRawData();
+                int i;
+                for (i = 0; i < job.numPalette; i++) {
+                    if (job.palette[i].red == d[2] &&
+                            job.palette[i].green == d[1] &&
+                            job.palette[i].blue == d[0]) {
+                        break;
+                    }
+                }
+                writestream.setNextValue(i);
+            } while (it->nextPixel());
+        }
+            break;
+        }
+    }
+}
+
+/**
+ * libpng reports the errors by longjmp'ing into the handler set with
+ * setjmp(). Jumping over C++ frames skips the destructors, so every
+ * call into libpng that can fail after the image data has started to
+ * be read is made from one of these helpers. They have no C++ objects
+ * in their frames and have their own handlers, so they just return
+ * false on failure.
+ *
+ * NOTE: the helpers overwrite the handler set in buildImage(), so
+ *       after the first call to them libpng may be called only via
+ *       the helpers.
+ */
+static bool readPNGRows(png_structp png_ptr, png_bytep dst, int rowBytes, int numRows)
+{
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        return false;
+    }
+
+    for (int row = 0; row < numRows; row++) {
+        png_read_row(png_ptr, dst + row * rowBytes, 0);
+    }
+
+    return true;
+}
+
+static bool readPNGImage(png_structp png_ptr, png_bytepp rowPointers)
+{
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        return false;
+    }
+
+    png_read_image(png_ptr, rowPointers);
+    return true;
+}
+
+static bool readPNGEnd(png_structp png_ptr, png_infop end_info)
+{
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        return false;
+    }
+
+    png_read_end(png_ptr, end_info);
+    return true;
+}
+
 class KisPNGReaderAbstract
 {
 public:
     KisPNGReaderAbstract(png_structp _png_ptr, int _width, int _height) : png_ptr(_png_ptr), width(_width), height(_height) {}
     virtual ~KisPNGReaderAbstract() {}
-    virtual png_bytep readLine() = 0;
+    virtual bool readLines(png_bytep dst, int rowBytes, int numRows) = 0;
 protected:
     png_structp png_ptr;
     int width, height;
@@ -334,31 +472,22 @@ protected:
 class KisPNGReaderLineByLine : public KisPNGReaderAbstract
 {
 public:
-    KisPNGReaderLineByLine(png_structp _png_ptr, png_infop info_ptr, int _width, int _height) : KisPNGReaderAbstract(_png_ptr, _width, _height) {
-        png_uint_32 rowbytes = png_get_rowbytes(png_ptr, info_ptr);
-        row_pointer = new png_byte[rowbytes];
-    }
-    ~KisPNGReaderLineByLine() override {
-        delete[] row_pointer;
+    KisPNGReaderLineByLine(png_structp _png_ptr, int _width, int _height) : KisPNGReaderAbstract(_png_ptr, _width, _height) {
     }
-    png_bytep readLine() override {
-        png_read_row(png_ptr, row_pointer, 0);
-        return row_pointer;
+    bool readLines(png_bytep dst, int rowBytes, int numRows) override {
+        return readPNGRows(png_ptr, dst, rowBytes, numRows);
     }
-private:
-    png_bytep row_pointer;
 };
 
 class KisPNGReaderFullImage : public KisPNGReaderAbstract
 {
 public:
-    KisPNGReaderFullImage(png_structp _png_ptr, png_infop info_ptr, int _width, int _height) : KisPNGReaderAbstract(_png_ptr, _width, _height), y(0) {
+    KisPNGReaderFullImage(png_structp _png_ptr, png_infop info_ptr, int _width, int _height) : KisPNGReaderAbstract(_png_ptr, _width, _height), y(0), isRead(false) {
         row_pointers = new png_bytep[height];
         png_uint_32 rowbytes = png_get_rowbytes(png_ptr, info_ptr);
         for (int i = 0; i < height; i++) {
             row_pointers[i] = new png_byte[rowbytes];
         }
-        png_read_image(png_ptr, row_pointers);
     }
     ~KisPNGReaderFullImage() override {
         for (int i = 0; i < height; i++) {
@@ -366,14 +495,142 @@ public:
         }
         delete[] row_pointers;
     }
-    png_bytep readLine() override {
-        return row_pointers[y++];
+    bool readLines(png_bytep dst, int rowBytes, int numRows) override {
+        // the interlaced image can be decoded only as a whole
+        if (!isRead) {
+            if (!readPNGImage(png_ptr, row_pointers)) return false;
+            isRead = true;
+        }
+
+        for (int row = 0; row < numRows; row++) {
+            memcpy(dst + row * rowBytes, row_pointers[y++], rowBytes);
+        }
+        return true;
     }
 private:
     png_bytepp row_pointers;
     int y;
+    bool isRead;
+};
+
+/**
+ * A stripe of rows decoded by libpng that should be converted into
+ * the pixel format of the paint device. The stripes are converted in
+ * a worker thread while the next stripe is being decoded.
+ */
+struct KisPNGReadStripeJob
+{
+    KisPaintDeviceSP device;
+    QVector<png_byte> rawRows;
+    int rowBytes;
+    int y;
+    int width;
+    int numRows;
+
+    int colorType;
+    int colorNbBits;
+    bool hasAlpha;
+    double coeff;
+    png_colorp palette;
+    const quint8 *paletteAlpha;
+    KoColorTransformation *transform;
 };
 
+void convertPNGStripe(const KisPNGReadStripeJob &job)
+{
+    const int pixelSize = job.device->pixelSize();
+    QVector<quint8> pixels(job.width * job.numRows * pixelSize);
+
+    const int color_nb_bits = job.colorNbBits;
+    const bool hasalpha = job.hasAlpha;
+    const double coeff = job.coeff;
+
+    for (int row = 0; row < job.numRows; row++) {
+        // the raw data is only read, the non-const pointer is just for the casts below
+        png_bytep row_pointer = const_cast<png_bytep>(job.rawRows.constData()) + row * job.rowBytes;
+        quint8 *dstRow = pixels.data() + row * job.width * pixelSize;
+
+        switch (job.colorType) {
+        case PNG_COLOR_TYPE_GRAY:
+        case PNG_COLOR_TYPE_GRAY_ALPHA:
+            if (color_nb_bits == 16) {
+                quint16 *src = reinterpret_cast<quint16 *>(row_pointer);
+                quint16 *d = reinterpret_cast<quint16 *>(dstRow);
+                for (int x = 0; x < job.width; x++, d += 2) {
+                    d[0] = *(src++);
+                    if (hasalpha) {
+                        d[1] = *(src++);
+                    } else {
+                        d[1] = quint16_MAX;
+                    }
+                }
+            } else  {
+                KisPNGReadStream stream(row_pointer, color_nb_bits);
+                quint8 *d = dstRow;
+                for (int x = 0; x < job.width; x++, d += 2) {
+                    d[0] = (quint8)(stream.nextValue() * coeff);
+                    if (hasalpha) {
+                        d[1] = (quint8)(stream.nextValue() * coeff);
+                    } else {
+                        d[1] = UCHAR_MAX;
+                    }
+                }
+            }
+            // FIXME:should be able to read 1 and 4 bits depth and scale them to 8 bits"
+            break;
+        case PNG_COLOR_TYPE_RGB:
+        case PNG_COLOR_TYPE_RGB_ALPHA:
+            if (color_nb_bits == 16) {
+                quint16 *src = reinterpret_cast<quint16 *>(row_pointer);
+                quint16 *d = reinterpret_cast<quint16 *>(dstRow);
+                for (int x = 0; x < job.width; x++, d += 4) {
+                    d[2] = *(src++);
+                    d[1] = *(src++);
+                    d[0] = *(src++);
+                    if (hasalpha) d[3] = *(src++);
+                    else d[3] = quint16_MAX;
+                }
+            } else {
+                KisPNGReadStream stream(row_pointer, color_nb_bits);
+                quint8 *d = dstRow;
+                for (int x = 0; x < job.width; x++, d += 4) {
+                    d[2] = (quint8)(stream.nextValue() * coeff);
+                    d[1] = (quint8)(stream.nextValue() * coeff);
+                    d[0] = (quint8)(stream.nextValue() * coeff);
+                    if (hasalpha) d[3] = (quint8)(stream.nextValue() * coeff);
+                    else d[3] = UCHAR_MAX;
+                }
+            }
+            break;
+        case PNG_COLOR_TYPE_PALETTE: {
+            KisPNGReadStream stream(row_pointer, color_nb_bits);
+            quint8 *d = dstRow;
+            for (int x = 0; x < job.width; x++, d += 4) {
+                quint8 index = stream.nextValue();
+                quint8 alpha = job.paletteAlpha[ index ];
+                if (alpha == 0) {
+                    memset(d, 0, 4);
+                } else {
+                    png_color c = job.palette[ index ];
+                    d[2] = c.red;
+                    d[1] = c.green;
+                    d[0] = c.blue;
+                    d[3] = alpha;
+                }
+            }
+        }
+            break;
+        }
+    }
+
+    // the transformation is applied to the whole stripe at once, it is much faster than per-pixel calls
+    if (job.transform) {
+        job.transform->transform(pixels.constData(), pixels.data(), job.width * job.numRows);
+    }
+
+    job.device->writeBytes(pixels.constData(), 0, job.y, job.width, job.numRows);
+}
+
 
 static
 void _read_fn(png_structp png_ptr, png_bytep data, png_size_t length)
@@ -413,6 +670,9 @@ KisImageBuilder_Result KisPNGConverter::buildImage(QIODevice* iod)
 {
     dbgFile << "Start decoding PNG File";
 
+    QElapsedTimer decodingTimer;
+    decodingTimer.start();
+
     png_byte signature[8];
     iod->peek((char*)signature, 8);
 
@@ -445,7 +705,8 @@ KisImageBuilder_Result KisPNGConverter::buildImage(QIODevice* iod)
         return (KisImageBuilder_RESULT_FAILURE);
     }
 
-    // Catch errors
+    // Catch errors in the headers, the errors in the image data
+    // are handled by readPNGRows() and friends
     if (setjmp(png_jmpbuf(png_ptr))) {
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
         iod->close();
@@ -614,9 +875,9 @@ KisImageBuilder_Result KisPNGConverter::buildImage(QIODevice* iod)
     }
     //TODO: two fixes : one tell the user about the problem and ask for a solution, and two once the kocolorspace include KoColorTransformation, use that instead of hacking a lcms transformation
     // Create the cmsTransform if needed
-    KoColorTransformation* transform = 0;
+    QScopedPointer<KoColorTransformation> transform;
     if (profile && !profile->isSuitableForOutput()) {
-        transform = KoColorSpaceRegistry::instance()->colorSpace(csName.first, csName.second, profile)->createColorConverter(cs, KoColorConversionTransformation::internalRenderingIntent(), KoColorConversionTransformation::internalConversionFlags());
+        transform.reset(KoColorSpaceRegistry::instance()->colorSpace(csName.first, csName.second, profile)->createColorConverter(cs, KoColorConversionTransformation::internalRenderingIntent(), KoColorConversionTransformation::internalConversionFlags()));
     }
 
     // Creating the KisImageSP
@@ -666,12 +927,12 @@ KisImageBuilder_Result KisPNGConverter::buildImage(QIODevice* iod)
     }
 
     // Read image data
-    KisPNGReaderAbstract* reader = 0;
+    QScopedPointer<KisPNGReaderAbstract> reader;
     try {
         if (interlace_type == PNG_INTERLACE_ADAM7) {
-            reader = new KisPNGReaderFullImage(png_ptr, info_ptr, width, height);
+            reader.reset(new KisPNGReaderFullImage(png_ptr, info_ptr, width, height));
         } else {
-            reader = new KisPNGReaderLineByLine(png_ptr, info_ptr, width, height);
+            reader.reset(new KisPNGReaderLineByLine(png_ptr, width, height));
         }
     } catch (std::bad_alloc& e) {
         // new png_byte[] may raise such an exception if the image
@@ -683,7 +944,7 @@ KisImageBuilder_Result KisPNGConverter::buildImage(QIODevice* iod)
     }
 
     // Read the palette if the file is indexed
-    png_colorp palette ;
+    png_colorp palette = 0;
     int num_palette;
     if (color_type == PNG_COLOR_TYPE_PALETTE) {
         png_get_PLTE(png_ptr, info_ptr, &palette, &num_palette);
@@ -703,98 +964,74 @@ KisImageBuilder_Result KisPNGConverter::buildImage(QIODevice* iod)
         }
     }
 
-    for (png_uint_32 y = 0; y < height; y++) {
-        KisHLineIteratorSP it = layer -> paintDevice() -> createHLineIteratorNG(0, y, width);
+    if (color_type != PNG_COLOR_TYPE_GRAY &&
+        color_type != PNG_COLOR_TYPE_GRAY_ALPHA &&
+        color_type != PNG_COLOR_TYPE_RGB &&
+        color_type != PNG_COLOR_TYPE_RGB_ALPHA &&
+        color_type != PNG_COLOR_TYPE_PALETTE) {
 
-        png_bytep row_pointer = reader->readLine();
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        return KisImageBuilder_RESULT_UNSUPPORTED;
+    }
 
-        switch (color_type) {
-        case PNG_COLOR_TYPE_GRAY:
-        case PNG_COLOR_TYPE_GRAY_ALPHA:
-            if (color_nb_bits == 16) {
-                quint16 *src = reinterpret_cast<quint16 *>(row_pointer);
-                do {
-                    quint16 *d = reinterpret_cast<quint16 *>(it->rawData());
-                    d[0] = *(src++);
-                    if (transform) transform->transform(reinterpret_cast<quint8*>(d), reinterpret_cast<quint8*>(d), 1);
-                    if (hasalpha) {
-                        d[1] = *(src++);
-                    } else {
-                        d[1] = quint16_MAX;
-                    }
-                } while (it->nextPixel());
-            } else  {
-                KisPNGReadStream stream(row_pointer, color_nb_bits);
-                do {
-                    quint8 *d = it->rawData();
-                    d[0] = (quint8)(stream.nextValue() * coeff);
-                    if (transform) transform->transform(d, d, 1);
-                    if (hasalpha) {
-                        d[1] = (quint8)(stream.nextValue() * coeff);
-                    } else {
-                        d[1] = UCHAR_MAX;
-                    }
-                } while (it->nextPixel());
-            }
-            // FIXME:should be able to read 1 and 4 bits depth and scale them to 8 bits"
-            break;
-        case PNG_COLOR_TYPE_RGB:
-        case PNG_COLOR_TYPE_RGB_ALPHA:
-            if (color_nb_bits == 16) {
-                quint16 *src = reinterpret_cast<quint16 *>(row_pointer);
-                do {
-                    quint16 *d = reinterpret_cast<quint16 *>(it->rawData());
-                    d[2] = *(src++);
-                    d[1] = *(src++);
-                    d[0] = *(src++);
-                    if (transform) transform->transform(reinterpret_cast<quint8 *>(d), reinterpret_cast<quint8*>(d), 1);
-                    if (hasalpha) d[3] = *(src++);
-                    else d[3] = quint16_MAX;
-                } while (it->nextPixel());
-            } else {
-                KisPNGReadStream stream(row_pointer, color_nb_bits);
-                do {
-                    quint8 *d = it->rawData();
-                    d[2] = (quint8)(stream.nextValue() * coeff);
-                    d[1] = (quint8)(stream.nextValue() * coeff);
-                    d[0] = (quint8)(stream.nextValue() * coeff);
-                    if (transform) transform->transform(d, d, 1);
-                    if (hasalpha) d[3] = (quint8)(stream.nextValue() * coeff);
-                    else d[3] = UCHAR_MAX;
-                } while (it->nextPixel());
-            }
-            break;
-        case PNG_COLOR_TYPE_PALETTE: {
-            KisPNGReadStream stream(row_pointer, color_nb_bits);
-            do {
-                quint8 *d = it->rawData();
-                quint8 index = stream.nextValue();
-                quint8 alpha = palette_alpha[ index ];
-                if (alpha == 0) {
-                    memset(d, 0, 4);
-                } else {
-                    png_color c = palette[ index ];
-                    d[2] = c.red;
-                    d[1] = c.green;
-                    d[0] = c.blue;
-                    d[3] = alpha;
-                }
-            } while (it->nextPixel());
-        }
-            break;
-        default:
-            return KisImageBuilder_RESULT_UNSUPPORTED;
-        }
+    /**
+     * The rows are decoded in stripes of the height of a tile. While
+     * libpng decodes the next stripe, the previous one is converted
+     * and written into the paint device in a worker thread. Every
+     * job owns its stripe of raw data.
+     *
+     * libpng may fail in the middle of the image (e.g. if the file
+     * is truncated), so the worker is always waited for before
+     * the data it uses is released.
+     */
+    const int stripeHeight = 64;
+    const int rowBytes = png_get_rowbytes(png_ptr, info_ptr);
+    QFuture<void> pendingStripe;
+    bool readSucceeded = true;
+
+    for (png_uint_32 y = 0; y < height; y += stripeHeight) {
+        KisPNGReadStripeJob job;
+        job.device = layer->paintDevice();
+        job.rowBytes = rowBytes;
+        job.y = y;
+        job.width = width;
+        job.numRows = qMin(png_uint_32(stripeHeight), height - y);
+        job.colorType = color_type;
+        job.colorNbBits = color_nb_bits;
+        job.hasAlpha = hasalpha;
+        job.coeff = coeff;
+        job.palette = palette;
+        job.paletteAlpha = palette_alpha;
+        job.transform = transform.data();
+
+        job.rawRows.resize(rowBytes * job.numRows);
+        readSucceeded = reader->readLines(job.rawRows.data(), rowBytes, job.numRows);
+        if (!readSucceeded) break;
+
+        pendingStripe.waitForFinished();
+        pendingStripe = QtConcurrent::run(convertPNGStripe, job);
+    }
+    pendingStripe.waitForFinished();
+
+    if (!readSucceeded || !readPNGEnd(png_ptr, end_info)) {
+        dbgFile << "Failed to decode the PNG image data";
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        iod->close();
+        return KisImageBuilder_RESULT_FAILURE;
     }
+
     m_image->addNode(layer.data(), m_image->rootLayer().data());
 
-    png_read_end(png_ptr, end_info);
+    const qint64 elapsed = qMax(qint64(1), decodingTimer.elapsed());
+    dbgFile << "Decoded" << width << "x" << height << "PNG in" << elapsed << "ms:"
+            << qreal(width) * height / 1000.0 / elapsed << "MPix/s,"
+            << qreal(iod->pos()) / 1000.0 / elapsed << "MB/s";
+
     iod->close();
 
     // Freeing memory
     png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
 
-    delete reader;
     return KisImageBuilder_RESULT_OK;
 
 }
@@ -822,7 +1059,32 @@ KisImageSP KisPNGConverter::image()
     return m_image;
 }
 
-bool KisPNGConverter::saveDeviceToStore(const QString &filename, const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, KoStore *store, KisMetaData::Store* metaData)
+KisImageBuilder_Result KisPNGConverter::encodeDevice(QIODevice *io, const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, KisMetaData::Store *metaData, bool fastCompression)
+{
+    KisPNGConverter pngconv(0);
+    vKisAnnotationSP_it annotIt = 0;
+    QScopedPointer<KisMetaData::Store> metaDataStore;
+    if (metaData) {
+        metaDataStore.reset(new KisMetaData::Store(*metaData));
+    }
+    KisPNGOptions options;
+    options.compression = 0;
+    options.fastCompression = fastCompression;
+    options.interlace = false;
+    options.tryToSaveAsIndexed = false;
+    options.alpha = true;
+    options.saveSRGBProfile = false;
+
+    if (dev->colorSpace()->id() != "RGBA") {
+        dev = new KisPaintDevice(*dev.data());
+        KUndo2Command *cmd = dev->convertTo(KoColorSpaceRegistry::instance()->rgb8());
+        delete cmd;
+    }
+
+    return pngconv.buildFile(io, imageRect, xRes, yRes, dev, annotIt, annotIt, options, metaDataStore.data());
+}
+
+bool KisPNGConverter::saveDeviceToStore(const QString &filename, const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, KoStore *store, KisMetaData::Store* metaData, bool fastCompression)
 {
     if (store->open(filename)) {
         KoStoreDevice io(store);
@@ -830,32 +1092,12 @@ bool KisPNGConverter::saveDeviceToStore(const QString &filename, const QRect &im
             dbgFile << "Could not open for writing:" << filename;
             return false;
         }
-        KisPNGConverter pngconv(0);
-        vKisAnnotationSP_it annotIt = 0;
-        KisMetaData::Store* metaDataStore = 0;
-        if (metaData) {
-            metaDataStore = new KisMetaData::Store(*metaData);
-        }
-        KisPNGOptions options;
-        options.compression = 0;
-        options.interlace = false;
-        options.tryToSaveAsIndexed = false;
-        options.alpha = true;
-        options.saveSRGBProfile = false;
-
-        if (dev->colorSpace()->id() != "RGBA") {
-            dev = new KisPaintDevice(*dev.data());
-            KUndo2Command *cmd = dev->convertTo(KoColorSpaceRegistry::instance()->rgb8());
-            delete cmd;
-        }
 
-        bool success = pngconv.buildFile(&io, imageRect, xRes, yRes, dev, annotIt, annotIt, options, metaDataStore);
-        if (success != KisImageBuilder_RESULT_OK) {
+        KisImageBuilder_Result result = encodeDevice(&io, imageRect, xRes, yRes, dev, metaData, fastCompression);
+        if (result != KisImageBuilder_RESULT_OK) {
             dbgFile << "Saving PNG failed:" << filename;
-            delete metaDataStore;
             return false;
         }
-        delete metaDataStore;
         io.close();
         if (!store->close()) {
             return false;
@@ -868,6 +1110,35 @@ bool KisPNGConverter::saveDeviceToStore(const QString &filename, const QRect &im
 
 }
 
+QFuture<QByteArray> KisPNGConverter::encodeDeviceInBackground(const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, bool fastCompression)
+{
+    return QtConcurrent::run([imageRect, xRes, yRes, dev, fastCompression] () {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+
+        if (encodeDevice(&buffer, imageRect, xRes, yRes, dev, 0, fastCompression) != KisImageBuilder_RESULT_OK) {
+            dbgFile << "Encoding PNG in background failed";
+            data.clear();
+        }
+
+        return data;
+    });
+}
+
+bool KisPNGConverter::saveEncodedDataToStore(const QString &filename, const QByteArray &data, KoStore *store)
+{
+    if (data.isEmpty()) return false;
+
+    if (!store->open(filename)) {
+        dbgFile << "Opening of data file failed :" << filename;
+        return false;
+    }
+
+    const bool success = store->write(data) == data.size();
+    return store->close() && success;
+}
+
 
 KisImageBuilder_Result KisPNGConverter::buildFile(const QString &filename, const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP device, vKisAnnotationSP_it annotationsStart, vKisAnnotationSP_it annotationsEnd, KisPNGOptions options, KisMetaData::Store* metaData)
 {
@@ -950,7 +1221,7 @@ KisImageBuilder_Result KisPNGConverter::buildFile(QIODevice* iodevice, const QRe
     //     setProgressTotalSteps(100/*height*/);
 
     /* set the zlib compression level */
-    png_set_compression_level(png_ptr, options.compression);
+    png_set_compression_level(png_ptr, options.fastCompression ? 0 : options.compression);
 
     png_set_write_fn(png_ptr, (void*)iodevice, _write_fn, _flush_fn);
 
@@ -959,7 +1230,17 @@ KisImageBuilder_Result KisPNGConverter::buildFile(QIODevice* iodevice, const QRe
     png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
     png_set_compression_window_bits(png_ptr, 15);
     png_set_compression_method(png_ptr, 8);
-    png_set_compression_buffer_size(png_ptr, 8192);
+    png_set_compression_buffer_size(png_ptr, options.fastCompression ? 65536 : 8192);
+
+    /**
+     * The adaptive filter selection tries all five filters on every
+     * row, even when the data is stored uncompressed for the zip store
+     * to compress it. The SUB filter alone keeps the rows almost as
+     * compressible for the store for a fraction of time.
+     */
+    if (options.fastCompression) {
+        png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+    }
 
     int color_nb_bits = 8 * device->pixelSize() / device->channelCount();
     int color_type = getColorTypeforColorSpace(device->colorSpace(), options.alpha);
@@ -1185,78 +1466,42 @@ KisImageBuilder_Result KisPNGConverter::buildFile(QIODevice* iodevice, const QRe
     // Write the PNG
     //     png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, 0);
 
-    // Fill the data structure
-    png_byte** row_pointers = new png_byte*[imageRect.height()];
-    int row = 0;
-    for (int y = imageRect.y(); y < imageRect.y() + imageRect.height(); y++, row++) {
-        KisHLineConstIteratorSP it = device->createHLineConstIteratorNG(imageRect.x(), y, imageRect.width());
-
-        row_pointers[row] = new png_byte[imageRect.width() * device->pixelSize()];
+    if (color_type != PNG_COLOR_TYPE_GRAY &&
+        color_type != PNG_COLOR_TYPE_GRAY_ALPHA &&
+        color_type != PNG_COLOR_TYPE_RGB &&
+        color_type != PNG_COLOR_TYPE_RGB_ALPHA &&
+        color_type != PNG_COLOR_TYPE_PALETTE) {
 
-        switch (color_type) {
-        case PNG_COLOR_TYPE_GRAY:
-        case PNG_COLOR_TYPE_GRAY_ALPHA:
-            if (color_nb_bits == 16) {
-                quint16 *dst = reinterpret_cast<quint16 *>(row_pointers[row]);
-                do {
-                    const quint16 *d = reinterpret_cast<const quint16 *>(it->oldRawData());
-                    *(dst++) = d[0];
-                    if (options.alpha) *(dst++) = d[1];
-                } while (it->nextPixel());
-            } else {
-                quint8 *dst = row_pointers[row];
-                do {
-                    const quint8 *d = it->oldRawData();
-                    *(dst++) = d[0];
-                    if (options.alpha) *(dst++) = d[1];
-                } while (it->nextPixel());
-            }
-            break;
-        case PNG_COLOR_TYPE_RGB:
-        case PNG_COLOR_TYPE_RGB_ALPHA:
-            if (color_nb_bits == 16) {
-                quint16 *dst = reinterpret_cast<quint16 *>(row_pointers[row]);
-                do {
-                    const quint16 *d = reinterpret_cast<const quint16 *>(it->oldRawData());
-                    *(dst++) = d[2];
-                    *(dst++) = d[1];
-                    *(dst++) = d[0];
-                    if (options.alpha) *(dst++) = d[3];
-                } while (it->nextPixel());
-            } else {
-                quint8 *dst = row_pointers[row];
-                do {
-                    const quint8 *d = it->oldRawData();
-                    *(dst++) = d[2];
-                    *(dst++) = d[1];
-                    *(dst++) = d[0];
-                    if (options.alpha) *(dst++) = d[3];
-                } while (it->nextPixel());
-            }
-            break;
-        case PNG_COLOR_TYPE_PALETTE: {
-            quint8 *dst = row_pointers[row];
-            KisPNGWriteStream writestream(dst, color_nb_bits);
-            do {
-                const quint8 *d = it->oldRawData();
-                int i;
-                for (i = 0; i < num_palette; i++) {
-                    if (palette[i].red == d[2] &&
-                            palette[i].green == d[1] &&
-                            palette[i].blue == d[0]) {
-                        break;
-                    }
-                }
-                writestream.setNextValue(i);
-            } while (it->nextPixel());
-        }
-            break;
-        default:
-            delete[] row_pointers;
-            return KisImageBuilder_RESULT_UNSUPPORTED;
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        if (color_type == PNG_COLOR_TYPE_PALETTE) {
+            delete [] palette;
         }
+        return KisImageBuilder_RESULT_UNSUPPORTED;
     }
 
+    // Fill the data structure. The rows are prepared in parallel, in
+    // stripes of 64 rows, which is the height of a tile
+    png_byte** row_pointers = new png_byte*[imageRect.height()];
+
+    const int stripeHeight = 64;
+    QVector<KisPNGWriteRowsJob> jobs;
+
+    for (int row = 0; row < imageRect.height(); row += stripeHeight) {
+        KisPNGWriteRowsJob job;
+        job.device = device;
+        job.rect = QRect(imageRect.x(), imageRect.y() + row,
+                         imageRect.width(), qMin(stripeHeight, imageRect.height() - row));
+        job.rowPointers = row_pointers + row;
+        job.colorType = color_type;
+        job.colorNbBits = color_nb_bits;
+        job.alpha = options.alpha;
+        job.palette = palette;
+        job.numPalette = num_palette;
+        jobs.append(job);
+    }
+
+    QtConcurrent::blockingMap(jobs, convertRowsForPNG);
+
     png_write_image(png_ptr, row_pointers);
 
     // Writing is over
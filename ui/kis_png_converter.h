@@ -24,6 +24,7 @@
 
 #include <QColor>
 #include <QVector>
+#include <QFuture>
 
 #include "kis_types.h"
 #include "kis_global.h"
@@ -45,6 +46,7 @@ class Store;
 struct KisPNGOptions {
     KisPNGOptions()
         : compression(0)
+        , fastCompression(false)
         , interlace(false)
         , alpha(true)
         , exif(true)
@@ -59,6 +61,8 @@ struct KisPNGOptions {
     {}
 
     int compression;
+    /// store the rows uncompressed with the SUB filter only, ignoring \p compression
+    bool fastCompression;
     bool interlace;
     bool alpha;
     bool exif;
@@ -122,7 +126,22 @@ public:
      * @brief saveDeviceToStore saves the given paint device to the KoStore. If the device is not 8 bits sRGB, it will be converted to 8 bits sRGB.
      * @return true if the saving succeeds
      */
-    static bool saveDeviceToStore(const QString &filename, const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, KoStore *store, KisMetaData::Store* metaData = 0);
+    static bool saveDeviceToStore(const QString &filename, const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, KoStore *store, KisMetaData::Store* metaData = 0, bool fastCompression = false);
+
+    /**
+     * @brief encodeDeviceInBackground encodes the given paint device into PNG data in a
+     * separate thread, so the merged image of a document can be compressed while the
+     * layers are being written. Write the result with saveEncodedDataToStore().
+     * @return the future of the PNG data, which is empty if the encoding fails
+     */
+    static QFuture<QByteArray> encodeDeviceInBackground(const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, bool fastCompression);
+
+    /**
+     * @brief saveEncodedDataToStore writes the data produced by encodeDeviceInBackground()
+     * into the KoStore
+     * @return true if the saving succeeds
+     */
+    static bool saveEncodedDataToStore(const QString &filename, const QByteArray &data, KoStore *store);
 
     static bool isColorSpaceSupported(const KoColorSpace *cs);
 
@@ -130,6 +149,8 @@ public Q_SLOTS:
     virtual void cancel();
 private:
     void progress(png_structp png_ptr, png_uint_32 row_number, int pass);
+
+    static KisImageBuilder_Result encodeDevice(QIODevice *io, const QRect &imageRect, const qreal xRes, const qreal yRes, KisPaintDeviceSP dev, KisMetaData::Store *metaData, bool fastCompression);
 private:
     png_uint_32 m_max_row;
     KisImageSP m_image;
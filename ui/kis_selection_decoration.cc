@@ -20,7 +20,10 @@
 #include <QPainter>
 #include <QVarLengthArray>
 
+#include <cmath>
+
 #include <kis_debug.h>
+#include <kis_global.h>
 #include <klocalizedstring.h>
 
 #include "kis_types.h"
@@ -43,9 +46,23 @@ static const unsigned int ANT_LENGTH = 4;
 static const unsigned int ANT_SPACE = 4;
 static const unsigned int ANT_ADVANCE_WIDTH = ANT_LENGTH + ANT_SPACE;
 
+/**
+ * Points of the outline closer than this distance (in widget pixels)
+ * are merged together. When the image is zoomed out, the outline of
+ * a complex selection contains a lot of points that fall into the
+ * same screen pixel.
+ */
+static const qreal OUTLINE_DECIMATION_DISTANCE = 0.7;
+
+/**
+ * Max number of points in a single cached outline segment
+ */
+static const int OUTLINE_SEGMENT_SIZE = 256;
+
 KisSelectionDecoration::KisSelectionDecoration(QPointer<KisView>view)
     : KisCanvasDecoration("selection", view),
       m_signalCompressor(500 /*ms*/, KisSignalCompressor::FIRST_INACTIVE),
+      m_outlineSegmentsValid(false),
       m_offset(0),
       m_mode(Ants)
 {
@@ -101,6 +118,7 @@ void KisSelectionDecoration::selectionChanged()
 
             if (m_mode == Ants) {
                 m_outlinePath = selection->outlineCache();
+                resetOutlineCache();
                 m_antsTimer->start();
             } else {
                 m_thumbnailImage = selection->thumbnailImage();
@@ -116,6 +134,7 @@ void KisSelectionDecoration::selectionChanged()
     } else {
         m_signalCompressor.stop();
         m_outlinePath = QPainterPath();
+        resetOutlineCache();
         m_thumbnailImage = QImage();
         m_thumbnailImageTransform = QTransform();
         view()->canvasBase()->updateCanvas();
@@ -147,13 +166,86 @@ void KisSelectionDecoration::antsAttackEvent()
     if (selectionIsActive()) {
         m_offset = (m_offset + 1) % ANT_ADVANCE_WIDTH;
         m_antsPen.setDashOffset(m_offset);
-        view()->canvasBase()->updateCanvas();
+
+        /**
+         * Only the area covered by the outline needs to be repainted.
+         * KisCanvas2 will crop the rect to the visible area itself.
+         */
+        const QRectF updateRect = outlineBoundsInDocument();
+        if (!updateRect.isEmpty()) {
+            view()->canvasBase()->updateCanvas(updateRect);
+        }
     }
 }
 
+QRectF KisSelectionDecoration::outlineBoundsInDocument() const
+{
+    if (m_mode != Ants || m_outlinePath.isEmpty()) return QRectF();
+
+    const KisCoordinatesConverter *converter = view()->canvasBase()->coordinatesConverter();
+    return converter->imageToDocument(m_outlinePath.boundingRect());
+}
+
+void KisSelectionDecoration::resetOutlineCache()
+{
+    m_outlineSegments.clear();
+    m_outlineSegmentsTransform = QTransform();
+    m_outlineSegmentsValid = false;
+}
+
+void KisSelectionDecoration::updateOutlineSegments(const QTransform &imageToWidget)
+{
+    m_outlineSegments.clear();
+
+    const qreal minDistanceSq = pow2(OUTLINE_DECIMATION_DISTANCE);
+    const QList<QPolygonF> subpaths = m_outlinePath.toSubpathPolygons(imageToWidget);
+
+    Q_FOREACH (const QPolygonF &subpath, subpaths) {
+        if (subpath.size() < 2) continue;
+
+        QPolygonF decimated;
+        decimated.reserve(subpath.size());
+        decimated << subpath.first();
+
+        for (int i = 1; i < subpath.size() - 1; i++) {
+            if (kisSquareDistance(subpath[i], decimated.last()) >= minDistanceSq) {
+                decimated << subpath[i];
+            }
+        }
+        decimated << subpath.last();
+
+        /**
+         * QPainter restarts the dash pattern on every subpath, so the
+         * length is accumulated per-subpath as well
+         */
+        qreal length = 0.0;
+        int start = 0;
+
+        while (start < decimated.size() - 1) {
+            const int end = qMin(start + OUTLINE_SEGMENT_SIZE, decimated.size() - 1);
+
+            OutlineSegment segment;
+            segment.polygon = decimated.mid(start, end - start + 1);
+            // the outline may be perfectly horizontal or vertical,
+            // so grow the bounds to make sure they are not null
+            segment.bounds = segment.polygon.boundingRect().adjusted(-1, -1, 1, 1);
+            segment.startLength = length;
+            m_outlineSegments.append(segment);
+
+            for (int i = start; i < end; i++) {
+                length += kisDistance(decimated[i], decimated[i + 1]);
+            }
+
+            start = end;
+        }
+    }
+
+    m_outlineSegmentsTransform = imageToWidget;
+    m_outlineSegmentsValid = true;
+}
+
 void KisSelectionDecoration::drawDecoration(QPainter& gc, const QRectF& updateRect, const KisCoordinatesConverter *converter, KisCanvas2 *canvas)
 {
-    Q_UNUSED(updateRect);
     Q_UNUSED(canvas);
 
     if (!selectionIsActive()) return;
@@ -163,9 +255,9 @@ void KisSelectionDecoration::drawDecoration(QPainter& gc, const QRectF& updateRe
     QTransform transform = converter->imageToWidgetTransform();
 
     gc.save();
-    gc.setTransform(transform, false);
 
     if (m_mode == Mask) {
+        gc.setTransform(transform, false);
         gc.setRenderHints(QPainter::SmoothPixmapTransform |
                           QPainter::HighQualityAntialiasing, false);
 
@@ -186,15 +278,32 @@ void KisSelectionDecoration::drawDecoration(QPainter& gc, const QRectF& updateRe
         gc.drawPath(p1 - p2);
 
     } else /* if (m_mode == Ants) */ {
+        if (!m_outlineSegmentsValid || m_outlineSegmentsTransform != transform) {
+            updateOutlineSegments(transform);
+        }
+
+        // the segments are already in widget coordinates
+        gc.setTransform(QTransform(), false);
         gc.setRenderHints(QPainter::Antialiasing | QPainter::HighQualityAntialiasing, m_antialiasSelectionOutline);
 
+        const QRectF widgetUpdateRect = converter->documentToWidget(updateRect);
+
         // render selection outline in white
         gc.setPen(m_outlinePen);
-        gc.drawPath(m_outlinePath);
+        Q_FOREACH (const OutlineSegment &segment, m_outlineSegments) {
+            if (!segment.bounds.intersects(widgetUpdateRect)) continue;
+            gc.drawPolyline(segment.polygon);
+        }
 
         // render marching ants in black (above the white outline)
-        gc.setPen(m_antsPen);
-        gc.drawPath(m_outlinePath);
+        QPen antsPen = m_antsPen;
+        Q_FOREACH (const OutlineSegment &segment, m_outlineSegments) {
+            if (!segment.bounds.intersects(widgetUpdateRect)) continue;
+
+            antsPen.setDashOffset(std::fmod(m_offset + segment.startLength, qreal(ANT_ADVANCE_WIDTH)));
+            gc.setPen(antsPen);
+            gc.drawPolyline(segment.polygon);
+        }
     }
     gc.restore();
 }
@@ -21,6 +21,7 @@
 #include <QTimer>
 #include <QPolygon>
 #include <QPen>
+#include <QVector>
 
 #include <kis_signal_compressor.h>
 #include "canvas/kis_canvas_decoration.h"
@@ -56,9 +57,30 @@ public Q_SLOTS:
 private:
     bool selectionIsActive();
 
+    /**
+     * A piece of the selection outline already mapped into widget
+     * coordinates. \p startLength is the length of the outline before
+     * the beginning of the segment, it is used for keeping the ants
+     * pattern continuous across the segments.
+     */
+    struct OutlineSegment {
+        QPolygonF polygon;
+        QRectF bounds;
+        qreal startLength;
+    };
+
+    void updateOutlineSegments(const QTransform &imageToWidget);
+    void resetOutlineCache();
+    QRectF outlineBoundsInDocument() const;
+
 private:
     KisSignalCompressor m_signalCompressor;
     QPainterPath m_outlinePath;
+
+    QVector<OutlineSegment> m_outlineSegments;
+    QTransform m_outlineSegmentsTransform;
+    bool m_outlineSegmentsValid;
+
     QImage m_thumbnailImage;
     QTransform m_thumbnailImageTransform;
     QTimer* m_antsTimer;
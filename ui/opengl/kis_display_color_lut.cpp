@@ -0,0 +1,435 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "kis_display_color_lut.h"
+
+#include <random>
+
+#include <QVector>
+
+#include <KoColorSpace.h>
+#include <KoChannelInfo.h>
+#include <KoColorModelStandardIds.h>
+#include <KoColorConversionTransformation.h>
+
+#include "kis_debug.h"
+#include "kis_assert.h"
+
+namespace {
+
+/**
+ * 65 nodes per axis is enough for the display transformations of the
+ * usual gamma-encoded RGB profiles. The table takes 3.3 MiB.
+ */
+const int lutSize = 65;
+
+/**
+ * The table is used only if it is at least as precise as a half of
+ * the 8-bit quantization step
+ */
+const qreal maxAllowedError = 0.5 / 255.0;
+
+const int numRandomTestPixels = 4096;
+const int numDarkTestPixels = 256;
+
+struct PixelLayout
+{
+    int colorOffsets[3]; // red, green, blue
+    int alphaOffset;
+    int pixelSize;
+    KoChannelInfo::enumChannelValueType valueType;
+};
+
+bool fetchPixelLayout(const KoColorSpace *cs, PixelLayout *layout)
+{
+    if (cs->colorModelId() != RGBAColorModelID) return false;
+
+    const QList<KoChannelInfo*> channels = cs->channels();
+    if (channels.size() != 4) return false;
+
+    layout->valueType = channels.first()->channelValueType();
+    layout->pixelSize = cs->pixelSize();
+    layout->alphaOffset = -1;
+    std::fill(layout->colorOffsets, layout->colorOffsets + 3, -1);
+
+    Q_FOREACH (const KoChannelInfo *channel, channels) {
+        if (channel->channelValueType() != layout->valueType) return false;
+
+        if (channel->channelType() == KoChannelInfo::ALPHA) {
+            layout->alphaOffset = channel->pos();
+        } else if (channel->channelType() == KoChannelInfo::COLOR &&
+                   channel->displayPosition() >= 0 &&
+                   channel->displayPosition() < 3) {
+
+            layout->colorOffsets[channel->displayPosition()] = channel->pos();
+        }
+    }
+
+    return layout->alphaOffset >= 0 &&
+        layout->colorOffsets[0] >= 0 &&
+        layout->colorOffsets[1] >= 0 &&
+        layout->colorOffsets[2] >= 0;
+}
+
+template <typename T>
+inline float readNormalized(const quint8 *ptr);
+
+template <>
+inline float readNormalized<quint8>(const quint8 *ptr) {
+    return *ptr * (1.0f / 255.0f);
+}
+
+template <>
+inline float readNormalized<quint16>(const quint8 *ptr) {
+    return *reinterpret_cast<const quint16*>(ptr) * (1.0f / 65535.0f);
+}
+
+template <>
+inline float readNormalized<float>(const quint8 *ptr) {
+    return *reinterpret_cast<const float*>(ptr);
+}
+
+template <typename T>
+inline void writeNormalized(quint8 *ptr, float value);
+
+template <>
+inline void writeNormalized<quint8>(quint8 *ptr, float value) {
+    *ptr = quint8(qBound(0.0f, value, 1.0f) * 255.0f + 0.5f);
+}
+
+template <>
+inline void writeNormalized<quint16>(quint8 *ptr, float value) {
+    *reinterpret_cast<quint16*>(ptr) = quint16(qBound(0.0f, value, 1.0f) * 65535.0f + 0.5f);
+}
+
+template <>
+inline void writeNormalized<float>(quint8 *ptr, float value) {
+    *reinterpret_cast<float*>(ptr) = value;
+}
+
+inline float readNormalized(const quint8 *ptr, KoChannelInfo::enumChannelValueType type) {
+    return type == KoChannelInfo::UINT8 ? readNormalized<quint8>(ptr) :
+           type == KoChannelInfo::UINT16 ? readNormalized<quint16>(ptr) :
+           readNormalized<float>(ptr);
+}
+
+inline void writeNormalized(quint8 *ptr, float value, KoChannelInfo::enumChannelValueType type) {
+    if (type == KoChannelInfo::UINT8) {
+        writeNormalized<quint8>(ptr, value);
+    } else if (type == KoChannelInfo::UINT16) {
+        writeNormalized<quint16>(ptr, value);
+    } else {
+        writeNormalized<float>(ptr, value);
+    }
+}
+
+}
+
+struct KisDisplayColorLut::Private
+{
+    const KoColorSpace *srcColorSpace = 0;
+    const KoColorSpace *dstColorSpace = 0;
+
+    PixelLayout srcLayout;
+    PixelLayout dstLayout;
+
+    /**
+     * Stores normalized RGB triplets of the destination color space,
+     * the blue index changes the fastest
+     */
+    QVector<float> table;
+
+    qreal maxError = 0.0;
+
+    template <typename SrcType, typename DstType>
+    void transformImpl(const quint8 *src, quint8 *dst, int numPixels) const;
+
+    void writeTestPixel(quint8 *dst, float r, float g, float b) const {
+        writeNormalized(dst + srcLayout.colorOffsets[0], r, srcLayout.valueType);
+        writeNormalized(dst + srcLayout.colorOffsets[1], g, srcLayout.valueType);
+        writeNormalized(dst + srcLayout.colorOffsets[2], b, srcLayout.valueType);
+        writeNormalized(dst + srcLayout.alphaOffset, 1.0f, srcLayout.valueType);
+    }
+};
+
+template <typename SrcType, typename DstType>
+void KisDisplayColorLut::Private::transformImpl(const quint8 *src, quint8 *dst, int numPixels) const
+{
+    const int srcRedOffset = srcLayout.colorOffsets[0];
+    const int srcGreenOffset = srcLayout.colorOffsets[1];
+    const int srcBlueOffset = srcLayout.colorOffsets[2];
+    const int srcAlphaOffset = srcLayout.alphaOffset;
+    const int srcPixelSize = srcLayout.pixelSize;
+
+    const int dstRedOffset = dstLayout.colorOffsets[0];
+    const int dstGreenOffset = dstLayout.colorOffsets[1];
+    const int dstBlueOffset = dstLayout.colorOffsets[2];
+    const int dstAlphaOffset = dstLayout.alphaOffset;
+    const int dstPixelSize = dstLayout.pixelSize;
+
+    const float *lut = table.constData();
+    const float scale = lutSize - 1;
+
+    // offsets of the neighbouring nodes in the table
+    const int dr = 3 * lutSize * lutSize;
+    const int dg = 3 * lutSize;
+    const int db = 3;
+
+    for (int i = 0; i < numPixels; i++) {
+        const float r = readNormalized<SrcType>(src + srcRedOffset) * scale;
+        const float g = readNormalized<SrcType>(src + srcGreenOffset) * scale;
+        const float b = readNormalized<SrcType>(src + srcBlueOffset) * scale;
+
+        const int ri = qMin(int(r), lutSize - 2);
+        const int gi = qMin(int(g), lutSize - 2);
+        const int bi = qMin(int(b), lutSize - 2);
+
+        const float fr = r - ri;
+        const float fg = g - gi;
+        const float fb = b - bi;
+
+        const float *c000 = lut + ri * dr + gi * dg + bi * db;
+        const float *c111 = c000 + dr + dg + db;
+
+        /**
+         * Tetrahedral interpolation: the unit cube is split into six
+         * tetrahedra sharing the main diagonal, the one containing the
+         * point is selected by the order of the fractional parts.
+         */
+        const float *c1;
+        const float *c2;
+        float w0, w1, w2, w3;
+
+        if (fr >= fg) {
+            if (fg >= fb) {
+                c1 = c000 + dr; c2 = c000 + dr + dg;
+                w0 = 1.0f - fr; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+            } else if (fr >= fb) {
+                c1 = c000 + dr; c2 = c000 + dr + db;
+                w0 = 1.0f - fr; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+            } else {
+                c1 = c000 + db; c2 = c000 + dr + db;
+                w0 = 1.0f - fb; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+            }
+        } else {
+            if (fb >= fg) {
+                c1 = c000 + db; c2 = c000 + dg + db;
+                w0 = 1.0f - fb; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+            } else if (fb >= fr) {
+                c1 = c000 + dg; c2 = c000 + dg + db;
+                w0 = 1.0f - fg; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+            } else {
+                c1 = c000 + dg; c2 = c000 + dr + dg;
+                w0 = 1.0f - fg; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+            }
+        }
+
+        writeNormalized<DstType>(dst + dstRedOffset,
+                                 w0 * c000[0] + w1 * c1[0] + w2 * c2[0] + w3 * c111[0]);
+        writeNormalized<DstType>(dst + dstGreenOffset,
+                                 w0 * c000[1] + w1 * c1[1] + w2 * c2[1] + w3 * c111[1]);
+        writeNormalized<DstType>(dst + dstBlueOffset,
+                                 w0 * c000[2] + w1 * c1[2] + w2 * c2[2] + w3 * c111[2]);
+        writeNormalized<DstType>(dst + dstAlphaOffset,
+                                 readNormalized<SrcType>(src + srcAlphaOffset));
+
+        src += srcPixelSize;
+        dst += dstPixelSize;
+    }
+}
+
+KisDisplayColorLut::KisDisplayColorLut(const KoColorSpace *srcColorSpace,
+                                       const KoColorSpace *dstColorSpace)
+    : m_d(new Private)
+{
+    m_d->srcColorSpace = srcColorSpace;
+    m_d->dstColorSpace = dstColorSpace;
+
+    fetchPixelLayout(srcColorSpace, &m_d->srcLayout);
+    fetchPixelLayout(dstColorSpace, &m_d->dstLayout);
+}
+
+KisDisplayColorLut::~KisDisplayColorLut()
+{
+}
+
+bool KisDisplayColorLut::isSupported(const KoColorSpace *srcColorSpace,
+                                     const KoColorSpace *dstColorSpace)
+{
+    PixelLayout srcLayout;
+    PixelLayout dstLayout;
+
+    /**
+     * Floating point sources are not supported: their values are not
+     * limited to [0, 1] range. 8-bit sources are not worth it, since
+     * LCMS already uses precalculated tables for them.
+     */
+
+    return fetchPixelLayout(srcColorSpace, &srcLayout) &&
+        fetchPixelLayout(dstColorSpace, &dstLayout) &&
+        srcLayout.valueType == KoChannelInfo::UINT16 &&
+        (dstLayout.valueType == KoChannelInfo::UINT8 ||
+         dstLayout.valueType == KoChannelInfo::UINT16 ||
+         dstLayout.valueType == KoChannelInfo::FLOAT32);
+}
+
+KisDisplayColorLutSP KisDisplayColorLut::create(const KoColorSpace *srcColorSpace,
+                                                const KoColorSpace *dstColorSpace,
+                                                const KoColorConversionTransformation *transform)
+{
+    if (!transform || !isSupported(srcColorSpace, dstColorSpace)) {
+        return KisDisplayColorLutSP();
+    }
+
+    KisDisplayColorLutSP lut(new KisDisplayColorLut(srcColorSpace, dstColorSpace));
+    lut->fillTable(transform);
+    lut->m_d->maxError = lut->measureError(transform);
+
+    if (lut->m_d->maxError > maxAllowedError) {
+        dbgUI << "Display color LUT is not precise enough, falling back to the exact transform"
+              << ppVar(lut->m_d->maxError);
+        return KisDisplayColorLutSP();
+    }
+
+    return lut;
+}
+
+const KoColorSpace* KisDisplayColorLut::srcColorSpace() const
+{
+    return m_d->srcColorSpace;
+}
+
+const KoColorSpace* KisDisplayColorLut::dstColorSpace() const
+{
+    return m_d->dstColorSpace;
+}
+
+qreal KisDisplayColorLut::maxError() const
+{
+    return m_d->maxError;
+}
+
+void KisDisplayColorLut::transform(const quint8 *src, quint8 *dst, int numPixels) const
+{
+    switch (m_d->dstLayout.valueType) {
+    case KoChannelInfo::UINT8:
+        m_d->transformImpl<quint16, quint8>(src, dst, numPixels);
+        break;
+    case KoChannelInfo::UINT16:
+        m_d->transformImpl<quint16, quint16>(src, dst, numPixels);
+        break;
+    case KoChannelInfo::FLOAT32:
+        m_d->transformImpl<quint16, float>(src, dst, numPixels);
+        break;
+    default:
+        KIS_SAFE_ASSERT_RECOVER_NOOP(0 && "unsupported destination channel type");
+    }
+}
+
+void KisDisplayColorLut::fillTable(const KoColorConversionTransformation *transform)
+{
+    const int numNodes = lutSize * lutSize * lutSize;
+    const float step = 1.0f / (lutSize - 1);
+
+    QVector<quint8> srcPixels(numNodes * m_d->srcLayout.pixelSize);
+    QVector<quint8> dstPixels(numNodes * m_d->dstLayout.pixelSize);
+
+    quint8 *srcPtr = srcPixels.data();
+    for (int r = 0; r < lutSize; r++) {
+        for (int g = 0; g < lutSize; g++) {
+            for (int b = 0; b < lutSize; b++) {
+                m_d->writeTestPixel(srcPtr, r * step, g * step, b * step);
+                srcPtr += m_d->srcLayout.pixelSize;
+            }
+        }
+    }
+
+    transform->transform(srcPixels.constData(), dstPixels.data(), numNodes);
+
+    m_d->table.resize(3 * numNodes);
+
+    const quint8 *dstPtr = dstPixels.constData();
+    float *tablePtr = m_d->table.data();
+
+    for (int i = 0; i < numNodes; i++) {
+        for (int ch = 0; ch < 3; ch++) {
+            *tablePtr++ = readNormalized(dstPtr + m_d->dstLayout.colorOffsets[ch],
+                                         m_d->dstLayout.valueType);
+        }
+        dstPtr += m_d->dstLayout.pixelSize;
+    }
+}
+
+qreal KisDisplayColorLut::measureError(const KoColorConversionTransformation *transform) const
+{
+    /**
+     * The test set consists of random colors (with a fixed seed, so the
+     * result is reproducible) and dark grays, where the tone curves are
+     * the steepest and the interpolation error is the biggest.
+     */
+
+    const int numPixels = numRandomTestPixels + numDarkTestPixels;
+    const int srcPixelSize = m_d->srcLayout.pixelSize;
+    const int dstPixelSize = m_d->dstLayout.pixelSize;
+
+    QVector<quint8> srcPixels(numPixels * srcPixelSize);
+    QVector<quint8> exactPixels(numPixels * dstPixelSize);
+    QVector<quint8> lutPixels(numPixels * dstPixelSize);
+
+    std::mt19937 generator(0x4b524954);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+    quint8 *srcPtr = srcPixels.data();
+    for (int i = 0; i < numRandomTestPixels; i++) {
+        m_d->writeTestPixel(srcPtr,
+                            distribution(generator),
+                            distribution(generator),
+                            distribution(generator));
+        srcPtr += srcPixelSize;
+    }
+
+    for (int i = 0; i < numDarkTestPixels; i++) {
+        const float value = 0.05f * i / numDarkTestPixels;
+        m_d->writeTestPixel(srcPtr, value, value, value);
+        srcPtr += srcPixelSize;
+    }
+
+    transform->transform(srcPixels.constData(), exactPixels.data(), numPixels);
+    this->transform(srcPixels.constData(), lutPixels.data(), numPixels);
+
+    qreal maxError = 0.0;
+
+    const quint8 *exactPtr = exactPixels.constData();
+    const quint8 *lutPtr = lutPixels.constData();
+
+    for (int i = 0; i < numPixels; i++) {
+        for (int ch = 0; ch < 3; ch++) {
+            const int offset = m_d->dstLayout.colorOffsets[ch];
+            const qreal error =
+                qAbs(readNormalized(exactPtr + offset, m_d->dstLayout.valueType) -
+                     readNormalized(lutPtr + offset, m_d->dstLayout.valueType));
+
+            maxError = qMax(maxError, error);
+        }
+
+        exactPtr += dstPixelSize;
+        lutPtr += dstPixelSize;
+    }
+
+    return maxError;
+}
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __KIS_DISPLAY_COLOR_LUT_H
+#define __KIS_DISPLAY_COLOR_LUT_H
+
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include "kritaui_export.h"
+
+class KoColorSpace;
+class KoColorConversionTransformation;
+
+class KisDisplayColorLut;
+typedef QSharedPointer<KisDisplayColorLut> KisDisplayColorLutSP;
+
+/**
+ * A 3D lookup table that approximates a display (or proofing) color
+ * conversion transformation of integer RGBA pixels. The table samples
+ * the transformation in a regular grid of nodes and the colors in
+ * between are calculated with tetrahedral interpolation. The alpha
+ * channel is passed through.
+ *
+ * The table is created with create(), which also checks its accuracy
+ * against the exact transformation. If the error is too big (e.g. the
+ * transformation has a steep tone curve near black), no table is
+ * created and the caller should use the exact transformation.
+ *
+ * The object is immutable after creation, so it can be used from
+ * several threads at the same time.
+ */
+class KRITAUI_EXPORT KisDisplayColorLut
+{
+public:
+    ~KisDisplayColorLut();
+
+    /**
+     * Samples \p transform, which converts \p srcColorSpace into \p
+     * dstColorSpace, into a lookup table.
+     *
+     * \return the table or null if the color spaces are not supported
+     *         or the table is not accurate enough
+     */
+    static KisDisplayColorLutSP create(const KoColorSpace *srcColorSpace,
+                                       const KoColorSpace *dstColorSpace,
+                                       const KoColorConversionTransformation *transform);
+
+    /**
+     * \return true if the pair of color spaces can be handled by the
+     *         lookup table at all
+     */
+    static bool isSupported(const KoColorSpace *srcColorSpace,
+                            const KoColorSpace *dstColorSpace);
+
+    const KoColorSpace* srcColorSpace() const;
+    const KoColorSpace* dstColorSpace() const;
+
+    /**
+     * The maximum error of the table measured by create() in
+     * normalized [0, 1] units
+     */
+    qreal maxError() const;
+
+    void transform(const quint8 *src, quint8 *dst, int numPixels) const;
+
+private:
+    KisDisplayColorLut(const KoColorSpace *srcColorSpace,
+                       const KoColorSpace *dstColorSpace);
+
+    void fillTable(const KoColorConversionTransformation *transform);
+    qreal measureError(const KoColorConversionTransformation *transform) const;
+
+private:
+    struct Private;
+    const QScopedPointer<Private> m_d;
+};
+
+#endif /* __KIS_DISPLAY_COLOR_LUT_H */
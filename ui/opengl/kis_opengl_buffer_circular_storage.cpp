@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "kis_opengl_buffer_circular_storage.h"
+
+#include <vector>
+#include <QOpenGLBuffer>
+
+#include "kis_assert.h"
+
+
+struct KisOpenGLBufferCircularStorage::Private
+{
+    std::vector<QOpenGLBuffer> buffers;
+    std::vector<int> allocatedSizes;
+    size_t nextBuffer = 0;
+};
+
+
+KisOpenGLBufferCircularStorage::KisOpenGLBufferCircularStorage()
+    : m_d(new Private)
+{
+}
+
+KisOpenGLBufferCircularStorage::~KisOpenGLBufferCircularStorage()
+{
+}
+
+void KisOpenGLBufferCircularStorage::allocate(int numBuffers)
+{
+    reset();
+    KIS_SAFE_ASSERT_RECOVER_RETURN(numBuffers > 0);
+
+    m_d->buffers.reserve(numBuffers);
+    m_d->allocatedSizes.resize(numBuffers, 0);
+
+    for (int i = 0; i < numBuffers; i++) {
+        m_d->buffers.emplace_back(QOpenGLBuffer::PixelUnpackBuffer);
+
+        QOpenGLBuffer &buf = m_d->buffers.back();
+        buf.setUsagePattern(QOpenGLBuffer::StreamDraw);
+
+        if (!buf.create()) {
+            reset();
+            return;
+        }
+    }
+}
+
+void KisOpenGLBufferCircularStorage::reset()
+{
+    for (auto it = m_d->buffers.begin(); it != m_d->buffers.end(); ++it) {
+        it->destroy();
+    }
+
+    m_d->buffers.clear();
+    m_d->allocatedSizes.clear();
+    m_d->nextBuffer = 0;
+}
+
+bool KisOpenGLBufferCircularStorage::isValid() const
+{
+    return !m_d->buffers.empty();
+}
+
+QOpenGLBuffer *KisOpenGLBufferCircularStorage::getNextBuffer(int size)
+{
+    KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(isValid(), 0);
+
+    const size_t index = m_d->nextBuffer;
+    m_d->nextBuffer = (m_d->nextBuffer + 1) % m_d->buffers.size();
+
+    QOpenGLBuffer *buf = &m_d->buffers[index];
+    buf->bind();
+
+    /**
+     * Calling glBufferData() with a null pointer orphans the previous
+     * storage of the buffer, so the driver can hand us a new chunk
+     * of memory without waiting for the pending uploads to complete.
+     * The storage never shrinks to avoid reallocations on every batch.
+     */
+    const int allocatedSize = qMax(size, m_d->allocatedSizes[index]);
+    buf->allocate(allocatedSize);
+    m_d->allocatedSizes[index] = allocatedSize;
+
+    return buf;
+}
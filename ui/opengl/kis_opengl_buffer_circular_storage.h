@@ -0,0 +1,66 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __KIS_OPENGL_BUFFER_CIRCULAR_STORAGE_H
+#define __KIS_OPENGL_BUFFER_CIRCULAR_STORAGE_H
+
+#include <QScopedPointer>
+#include "kritaui_export.h"
+
+class QOpenGLBuffer;
+
+/**
+ * A ring of pixel unpack buffers shared by all the texture tiles of
+ * an image. Every upload batch takes the next buffer in the ring, so
+ * the driver may still be reading from the previous ones while we
+ * are filling the new one. The buffer's storage is orphaned on every
+ * allocation, therefore the driver never has to stall on the mapping.
+ *
+ * All the methods should be called with the OpenGL context current.
+ */
+class KRITAUI_EXPORT KisOpenGLBufferCircularStorage
+{
+public:
+    KisOpenGLBufferCircularStorage();
+    ~KisOpenGLBufferCircularStorage();
+
+    /**
+     * Creates \p numBuffers buffer objects. The storage of the
+     * buffers is allocated lazily in getNextBuffer()
+     */
+    void allocate(int numBuffers);
+
+    /**
+     * Destroys all the buffers
+     */
+    void reset();
+
+    bool isValid() const;
+
+    /**
+     * Returns the next buffer of the ring bound to the current context
+     * and having (orphaned) storage of at least \p size bytes.
+     */
+    QOpenGLBuffer* getNextBuffer(int size);
+
+private:
+    struct Private;
+    const QScopedPointer<Private> m_d;
+};
+
+#endif /* __KIS_OPENGL_BUFFER_CIRCULAR_STORAGE_H */
@@ -31,9 +31,11 @@
 #include "kis_config.h"
 #include "kis_config_notifier.h"
 #include "kis_debug.h"
+#include <kis_lod_transform.h>
 
 #include <QPainter>
 #include <QPainterPath>
+#include <QPaintEvent>
 #include <QPointF>
 #include <QMatrix>
 #include <QTransform>
@@ -43,6 +45,7 @@
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLBuffer>
 #include <QMessageBox>
+#include <QtMath>
 
 #ifndef Q_OS_OSX
 #include <QOpenGLFunctions_2_1>
@@ -91,6 +94,15 @@ public:
 
     bool wrapAroundMode{false};
 
+    /**
+     * The widget rect requested by the current paint event. When it
+     * covers only a part of the widget, the rest of the frame is kept
+     * from the previous paint (the widget uses QOpenGLWidget::PartialUpdate
+     * behavior) and rendering is restricted with a scissor box.
+     */
+    QRect pendingUpdateRect;
+    QRect partialUpdateRect;
+
     // Stores a quad for drawing the canvas
     QOpenGLVertexArrayObject quadVAO;
     QOpenGLBuffer quadBuffers[2];
@@ -166,6 +178,10 @@ KisOpenGLCanvas2::KisOpenGLCanvas2(KisCanvas2 *canvas,
     setAttribute(Qt::WA_InputMethodEnabled, false);
     setAttribute(Qt::WA_DontCreateNativeAncestors, true);
 
+    // keep the previous frame in the framebuffer, so that we could
+    // redraw only the dirty part of the canvas
+    setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+
     setDisplayFilterImpl(colorConverter->displayFilter(), true);
 
     connect(KisConfigNotifier::instance(), SIGNAL(configChanged()), SLOT(slotConfigChanged()));
@@ -350,9 +366,19 @@ void KisOpenGLCanvas2::reportFailedShaderCompilation(const QString &context)
 void KisOpenGLCanvas2::resizeGL(int width, int height)
 {
     coordinatesConverter()->setCanvasWidgetSize(QSize(width, height));
+    canvas()->notifyCanvasWidgetResized();
+
+    // the framebuffer has just been recreated, so nothing can be reused
+    d->pendingUpdateRect = QRect();
     paintGL();
 }
 
+void KisOpenGLCanvas2::paintEvent(QPaintEvent *e)
+{
+    d->pendingUpdateRect = e->rect();
+    QOpenGLWidget::paintEvent(e);
+}
+
 void KisOpenGLCanvas2::paintGL()
 {
     if (!OPENGL_SUCCESS) {
@@ -362,6 +388,13 @@ void KisOpenGLCanvas2::paintGL()
 
     KisOpenglCanvasDebugger::instance()->nofityPaintRequested();
 
+    d->partialUpdateRect = d->pendingUpdateRect & rect();
+    d->pendingUpdateRect = QRect();
+
+    if (d->partialUpdateRect == rect() || !d->canvasInitialized) {
+        d->partialUpdateRect = QRect();
+    }
+
     renderCanvasGL();
 
     if (d->glSyncObject) {
@@ -370,9 +403,14 @@ void KisOpenGLCanvas2::paintGL()
     d->glSyncObject = Sync::getSync();
 
     QPainter gc(this);
+    if (!d->partialUpdateRect.isEmpty()) {
+        gc.setClipRect(d->partialUpdateRect);
+    }
     renderDecorations(&gc);
     gc.end();
 
+    d->partialUpdateRect = QRect();
+
     if (!OPENGL_SUCCESS) {
         KisConfig cfg;
         cfg.writeEntry("canvasState", "OPENGL_SUCCESS");
@@ -380,6 +418,21 @@ void KisOpenGLCanvas2::paintGL()
     }
 }
 
+void KisOpenGLCanvas2::enablePartialUpdateScissor()
+{
+    const qreal ratio = devicePixelRatioF();
+    const QRect &rc = d->partialUpdateRect;
+
+    // OpenGL window coordinates have Y axis pointing upwards
+    const QRect scissorRect(QPoint(qFloor(rc.x() * ratio),
+                                   qFloor((height() - rc.y() - rc.height()) * ratio)),
+                            QPoint(qCeil((rc.x() + rc.width()) * ratio) - 1,
+                                   qCeil((height() - rc.y()) * ratio) - 1));
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(scissorRect.x(), scissorRect.y(), scissorRect.width(), scissorRect.height());
+}
+
 void KisOpenGLCanvas2::paintToolOutline(const QPainterPath &path)
 {
     if (!d->solidColorShader->bind()) {
@@ -397,6 +450,16 @@ void KisOpenGLCanvas2::paintToolOutline(const QPainterPath &path)
     modelMatrix = projectionMatrix * modelMatrix;
     d->solidColorShader->setUniformValue(d->solidColorShader->location(Uniform::ModelViewProjection), modelMatrix);
 
+    /**
+     * The outline is XOR'ed with the framebuffer, so during a partial
+     * update it must not touch the pixels preserved from the previous
+     * frame, otherwise the old outline would be "erased" there.
+     */
+    const bool usePartialUpdate = !d->partialUpdateRect.isEmpty();
+    if (usePartialUpdate) {
+        enablePartialUpdateScissor();
+    }
+
     if (!KisOpenGL::hasOpenGLES()) {
         glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
@@ -458,6 +521,10 @@ void KisOpenGLCanvas2::paintToolOutline(const QPainterPath &path)
         glDisable(GL_BLEND);
     }
 
+    if (usePartialUpdate) {
+        glDisable(GL_SCISSOR_TEST);
+    }
+
     d->solidColorShader->release();
 }
 
@@ -635,7 +702,9 @@ void KisOpenGLCanvas2::drawImage()
     textureMatrix.setToIdentity();
     d->displayShader->setUniformValue(d->displayShader->location(Uniform::TextureMatrix), textureMatrix);
 
-    QRectF widgetRect(0,0, width(), height());
+    // during a partial update only the tiles under the scissor box are drawn
+    QRectF widgetRect = !d->partialUpdateRect.isEmpty() ?
+        QRectF(d->partialUpdateRect) : QRectF(0,0, width(), height());
     QRectF widgetRectInImagePixels = converter->documentToImage(converter->widgetToDocument(widgetRect));
 
     qreal scaleX, scaleY;
@@ -689,10 +758,12 @@ void KisOpenGLCanvas2::drawImage()
             KisTextureTile *tile =
                     d->openGLImageTextures->getTextureTileCR(effectiveCol, effectiveRow);
 
-            if (!tile) {
-                warnUI << "OpenGL: Trying to paint texture tile but it has not been created yet.";
-                continue;
-            }
+            /**
+             * The tiles are allocated lazily, so the absent tile
+             * just means a fully transparent area of the image.
+             * The checkers have already been painted underneath.
+             */
+            if (!tile) continue;
 
             /*
              * We create a float rect here to workaround Qt's
@@ -814,6 +885,12 @@ void KisOpenGLCanvas2::inputMethodEvent(QInputMethodEvent *event)
 
 void KisOpenGLCanvas2::renderCanvasGL()
 {
+    const bool usePartialUpdate = !d->partialUpdateRect.isEmpty();
+
+    if (usePartialUpdate) {
+        enablePartialUpdateScissor();
+    }
+
     // Draw the border (that is, clear the whole widget to the border color)
     QColor widgetBackgroundColor = borderColor();
     glClearColor(widgetBackgroundColor.redF(), widgetBackgroundColor.greenF(), widgetBackgroundColor.blueF(), 1.0);
@@ -841,11 +918,20 @@ void KisOpenGLCanvas2::renderCanvasGL()
     if (KisOpenGL::hasOpenGL3()) {
         d->quadVAO.release();
     }
+
+    if (usePartialUpdate) {
+        glDisable(GL_SCISSOR_TEST);
+    }
 }
 
 void KisOpenGLCanvas2::renderDecorations(QPainter *painter)
 {
     QRect boundingRect = coordinatesConverter()->imageRectInWidgetPixels().toAlignedRect();
+
+    if (!d->partialUpdateRect.isEmpty()) {
+        boundingRect &= d->partialUpdateRect;
+    }
+
     drawDecorations(*painter, boundingRect);
 }
 
@@ -900,7 +986,40 @@ QRect KisOpenGLCanvas2::updateCanvasProjection(KisUpdateInfoSP info)
     glFinish();
 #endif
 
-    return QRect(); // FIXME: Implement dirty rect for OpenGL
+    if (!isOpenGLUpdateInfo) {
+        return QRect();
+    }
+
+    KisCoordinatesConverter *converter = coordinatesConverter();
+    const QRect viewportRect = converter->widgetToViewport(QRectF(rect())).toAlignedRect();
+
+    if (d->wrapAroundMode) {
+        // the dirty area may be repeated anywhere on the canvas
+        return viewportRect;
+    }
+
+    /**
+     * Bilinear and high quality filtering sample the neighbouring texels,
+     * so when zooming in, the change leaks into the neighbouring image
+     * pixels, that is, by 'zoom' viewport pixels. Hence the rect is grown
+     * in image pixels before mapping it into the viewport.
+     */
+    QRect dirtyImageRect = info->dirtyImageRect().adjusted(-2, -2, 2, 2);
+
+    // the info may have been produced before the level of detail of the image changed
+    const int levelOfDetail = info->levelOfDetail();
+    if (levelOfDetail) {
+        dirtyImageRect = KisLodTransform::alignedRect(dirtyImageRect, levelOfDetail);
+    }
+
+    /**
+     * When zooming out, mipmaps spread the change by about a viewport
+     * pixel more, and the antialiased tile edges need a margin as well.
+     */
+    const QRect dirtyViewportRect =
+        converter->imageToViewport(QRectF(dirtyImageRect)).toAlignedRect().adjusted(-2, -2, 2, 2);
+
+    return dirtyViewportRect & viewportRect;
 }
 
 bool KisOpenGLCanvas2::callFocusNextPrevChild(bool next)
@@ -107,6 +107,9 @@ public Q_SLOTS:
 protected: // KisCanvasWidgetBase
     bool callFocusNextPrevChild(bool next) override;
 
+protected: // QWidget
+    void paintEvent(QPaintEvent *e) override;
+
 private:
     void initializeShaders();
     void initializeDisplayShader();
@@ -115,6 +118,7 @@ private:
     void drawImage();
     void drawCheckers();
     void drawGrid();
+    void enablePartialUpdateScissor();
 
 private:
 
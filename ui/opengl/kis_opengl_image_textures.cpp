@@ -20,6 +20,7 @@
 
 #include <QOpenGLFunctions>
 #include <QOpenGLContext>
+#include <QOpenGLBuffer>
 
 #include <QMessageBox>
 #include <QApplication>
@@ -54,6 +55,20 @@
 #endif
 
 
+/**
+ * The number of pixel unpack buffers in the ring. The buffers are
+ * orphaned on every upload, so the driver can still be reading the
+ * previous batches while the next one is being filled.
+ */
+static const int NUM_PIXEL_BUFFERS = 4;
+
+/**
+ * Limits for the adaptive size of the texture tiles. See
+ * KisOpenGLImageTextures::getTextureSize()
+ */
+static const int MIN_ADAPTIVE_TEXTURE_SIZE = 64;
+static const qint64 MAX_ADAPTIVE_TEXTURE_TILES = 4096;
+
 KisOpenGLImageTextures::ImageTexturesMap KisOpenGLImageTextures::imageTexturesMap;
 
 KisOpenGLImageTextures::KisOpenGLImageTextures()
@@ -64,10 +79,13 @@ KisOpenGLImageTextures::KisOpenGLImageTextures()
     , m_tilesDestinationColorSpace(0)
     , m_internalColorManagementActive(true)
     , m_checkerTexture(0)
+    , m_filterMode(KisOpenGL::BilinearFilterMode)
+    , m_numMipmapLevels(0)
     , m_glFuncs(0)
     , m_allChannelsSelected(true)
     , m_useOcio(false)
     , m_initialized(false)
+    , m_useBuffer(false)
 {
     KisConfig cfg;
     m_renderingIntent = (KoColorConversionTransformation::Intent)cfg.monitorRenderIntent();
@@ -76,6 +94,7 @@ KisOpenGLImageTextures::KisOpenGLImageTextures()
     if (cfg.useBlackPointCompensation()) m_conversionFlags |= KoColorConversionTransformation::BlackpointCompensation;
     if (!cfg.allowLCMSOptimization()) m_conversionFlags |= KoColorConversionTransformation::NoOptimization;
     m_useOcio = cfg.useOcio();
+    m_useBuffer = cfg.useOpenGLTextureBuffer();
 }
 
 KisOpenGLImageTextures::KisOpenGLImageTextures(KisImageWSP image,
@@ -90,12 +109,18 @@ KisOpenGLImageTextures::KisOpenGLImageTextures(KisImageWSP image,
     , m_tilesDestinationColorSpace(0)
     , m_internalColorManagementActive(true)
     , m_checkerTexture(0)
+    , m_filterMode(KisOpenGL::BilinearFilterMode)
+    , m_numMipmapLevels(0)
     , m_glFuncs(0)
     , m_allChannelsSelected(true)
     , m_useOcio(false)
     , m_initialized(false)
+    , m_useBuffer(false)
 {
     Q_ASSERT(renderingIntent < 4);
+
+    KisConfig cfg;
+    m_useBuffer = cfg.useOpenGLTextureBuffer();
 }
 
 void KisOpenGLImageTextures::initGL(QOpenGLFunctions *f)
@@ -209,47 +234,56 @@ void KisOpenGLImageTextures::createImageTextureTiles()
 
     // Default color is transparent black
     const int pixelSize = m_tilesDestinationColorSpace->pixelSize();
-    QByteArray emptyTileData((m_texturesInfo.width) * (m_texturesInfo.height) * pixelSize, 0);
+    m_emptyTileData = QByteArray((m_texturesInfo.width) * (m_texturesInfo.height) * pixelSize, 0);
 
     KisConfig config;
-    KisOpenGL::FilterMode mode = (KisOpenGL::FilterMode)config.openGLFilteringMode();
+    m_filterMode = (KisOpenGL::FilterMode)config.openGLFilteringMode();
+    m_numMipmapLevels = config.numMipmapLevels();
 
     QOpenGLContext *ctx = QOpenGLContext::currentContext();
     if (ctx) {
-        QOpenGLFunctions *f = ctx->functions();
-
         m_initialized = true;
-        dbgUI  << "OpenGL: creating texture tiles of size" << m_texturesInfo.height << "x" << m_texturesInfo.width;
-
-        m_textureTiles.reserve((lastRow+1)*m_numCols);
-        for (int row = 0; row <= lastRow; row++) {
-            for (int col = 0; col <= lastCol; col++) {
-                QRect tileRect = calculateTileRect(col, row);
-
-                KisTextureTile *tile = new KisTextureTile(tileRect,
-                                                          &m_texturesInfo,
-                                                          emptyTileData,
-                                                          mode,
-                                                          config.useOpenGLTextureBuffer(),
-                                                          config.numMipmapLevels(),
-                                                          f);
-                m_textureTiles.append(tile);
-            }
-        }
+        dbgUI  << "OpenGL: creating texture tiles grid of size" << m_texturesInfo.height << "x" << m_texturesInfo.width;
+
+        /**
+         * The tiles themselves are created lazily in
+         * createTextureTileCR(), when some non-transparent data is
+         * uploaded into them for the first time.
+         */
+        m_textureTiles.fill(0, (lastRow + 1) * m_numCols);
     }
     else {
         dbgUI << "Tried to init texture tiles without a current OpenGL Context.";
     }
 }
 
+KisTextureTile* KisOpenGLImageTextures::createTextureTileCR(int col, int row)
+{
+    const int index = row * m_numCols + col;
+    KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(m_initialized && index < m_textureTiles.size(), 0);
+
+    if (!m_textureTiles[index]) {
+        QOpenGLContext *ctx = QOpenGLContext::currentContext();
+        KIS_SAFE_ASSERT_RECOVER_RETURN_VALUE(ctx, 0);
+
+        m_textureTiles[index] = new KisTextureTile(calculateTileRect(col, row),
+                                                   &m_texturesInfo,
+                                                   m_emptyTileData,
+                                                   m_filterMode,
+                                                   m_numMipmapLevels,
+                                                   ctx->functions());
+    }
+
+    return m_textureTiles[index];
+}
+
 void KisOpenGLImageTextures::destroyImageTextureTiles()
 {
     if (m_textureTiles.isEmpty()) return;
 
-    Q_FOREACH (KisTextureTile *tile, m_textureTiles) {
-        delete tile;
-    }
+    qDeleteAll(m_textureTiles);
     m_textureTiles.clear();
+    m_emptyTileData.clear();
     m_storedImageBounds = QRect();
 }
 
@@ -263,6 +297,47 @@ KisOpenGLUpdateInfoSP KisOpenGLImageTextures::updateCacheNoConversion(const QRec
     return updateCacheImpl(rect, m_image, false);
 }
 
+KisDisplayColorLutSP KisOpenGLImageTextures::fetchDisplayLut(const KoColorSpace *srcColorSpace, bool useProofing)
+{
+    const KoColorSpace *dstColorSpace = m_tilesDestinationColorSpace;
+
+    QMutexLocker l(&m_displayLutLock);
+
+    if (m_displayLutDirty ||
+        m_displayLutUsesProofing != useProofing ||
+        m_displayLutSrcColorSpace != srcColorSpace ||
+        m_displayLutDstColorSpace != dstColorSpace) {
+
+        m_displayLut.clear();
+
+        /**
+         * When no conversion is needed at all, convertTo() is a noop,
+         * so the table would only slow things down
+         */
+        const bool needsConversion =
+            useProofing ||
+            m_conversionFlags != KoColorConversionTransformation::Empty ||
+            !(*srcColorSpace == *dstColorSpace);
+
+        if (needsConversion && KisDisplayColorLut::isSupported(srcColorSpace, dstColorSpace)) {
+            if (useProofing) {
+                m_displayLut = KisDisplayColorLut::create(srcColorSpace, dstColorSpace, m_proofingTransform.data());
+            } else {
+                QScopedPointer<KoColorConversionTransformation> transform(
+                    srcColorSpace->createColorConverter(dstColorSpace, m_renderingIntent, m_conversionFlags));
+                m_displayLut = KisDisplayColorLut::create(srcColorSpace, dstColorSpace, transform.data());
+            }
+        }
+
+        m_displayLutDirty = false;
+        m_displayLutUsesProofing = useProofing;
+        m_displayLutSrcColorSpace = srcColorSpace;
+        m_displayLutDstColorSpace = dstColorSpace;
+    }
+
+    return m_displayLut;
+}
+
 // TODO: add sanity checks about the conformance of the passed srcImage!
 KisOpenGLUpdateInfoSP KisOpenGLImageTextures::updateCacheImpl(const QRect& rect, KisImageSP srcImage, bool convertColorSpace)
 {
@@ -347,10 +422,18 @@ KisOpenGLUpdateInfoSP KisOpenGLImageTextures::updateCacheImpl(const QRect& rect,
                     const KoColorSpace *proofingSpace = KoColorSpaceRegistry::instance()->colorSpace(m_proofingConfig->proofingModel,m_proofingConfig->proofingDepth,m_proofingConfig->proofingProfile);
                     m_proofingTransform.reset(tileInfo->generateProofingTransform(dstCS, proofingSpace, m_renderingIntent, m_proofingConfig->intent, m_proofingConfig->conversionFlags, m_proofingConfig->warningColor, m_proofingConfig->adaptationState));
                     m_createNewProofingTransform = false;
+
+                    QMutexLocker l(&m_displayLutLock);
+                    m_displayLutDirty = true;
                 }
 
                 if (convertColorSpace) {
-                    if (m_proofingConfig && m_proofingTransform && m_proofingConfig->conversionFlags.testFlag(KoColorConversionTransformation::SoftProofing)) {
+                    const bool useProofing = m_proofingConfig && m_proofingTransform && m_proofingConfig->conversionFlags.testFlag(KoColorConversionTransformation::SoftProofing);
+                    KisDisplayColorLutSP lut = fetchDisplayLut(tileInfo->patchColorSpace(), useProofing);
+
+                    if (lut) {
+                        tileInfo->convertWithLut(lut.data());
+                    } else if (useProofing) {
                         tileInfo->proofTo(dstCS, m_proofingConfig->conversionFlags, m_proofingTransform.data());
                     } else {
                         tileInfo->convertTo(dstCS, m_renderingIntent, m_conversionFlags);
@@ -380,8 +463,45 @@ void KisOpenGLImageTextures::recalculateCache(KisUpdateInfoSP info)
     KisOpenGLUpdateInfoSP glInfo = dynamic_cast<KisOpenGLUpdateInfo*>(info.data());
     if(!glInfo) return;
 
+    /**
+     * The tiles are created on the first upload of non-transparent
+     * data. Transparent patches for the tiles that don't exist yet
+     * are just skipped: an absent tile is painted as transparent.
+     */
+    KisTextureTileUpdateInfoSPList tileList;
+    tileList.reserve(glInfo->tileList.size());
+
+    Q_FOREACH (KisTextureTileUpdateInfoSP tileInfo, glInfo->tileList) {
+        const int col = tileInfo->tileCol();
+        const int row = tileInfo->tileRow();
+
+        if (!getTextureTileCR(col, row)) {
+            if (tileInfo->isFullyTransparent()) continue;
+
+            KisTextureTile *tile = createTextureTileCR(col, row);
+            KIS_SAFE_ASSERT_RECOVER(tile) { continue; }
+        }
+
+        tileList.append(tileInfo);
+    }
+
+    if (tileList.isEmpty()) return;
+
+#ifdef USE_PIXEL_BUFFERS
+    if (m_useBuffer) {
+        if (!m_bufferStorage.isValid()) {
+            m_bufferStorage.allocate(NUM_PIXEL_BUFFERS);
+        }
+
+        if (m_bufferStorage.isValid()) {
+            uploadTilesFromPixelBuffer(tileList);
+            return;
+        }
+    }
+#endif
+
     KisTextureTileUpdateInfoSP tileInfo;
-    Q_FOREACH (tileInfo, glInfo->tileList) {
+    Q_FOREACH (tileInfo, tileList) {
         KisTextureTile *tile = getTextureTileCR(tileInfo->tileCol(), tileInfo->tileRow());
         KIS_ASSERT_RECOVER_RETURN(tile);
 
@@ -389,6 +509,68 @@ void KisOpenGLImageTextures::recalculateCache(KisUpdateInfoSP info)
     }
 }
 
+void KisOpenGLImageTextures::uploadTilesFromPixelBuffer(const KisTextureTileUpdateInfoSPList &tileList)
+{
+#ifdef USE_PIXEL_BUFFERS
+    /**
+     * All the patches of the update are packed into a single buffer
+     * of the ring, which is mapped only once. Then all the
+     * glTexSubImage2D calls of the batch are issued in one go.
+     */
+    QVector<quintptr> offsets;
+    offsets.reserve(tileList.size());
+
+    quintptr totalSize = 0;
+    Q_FOREACH (KisTextureTileUpdateInfoSP tileInfo, tileList) {
+        const QSize patchSize = tileInfo->realPatchSize();
+
+        offsets.append(totalSize);
+        totalSize += patchSize.width() * patchSize.height() * tileInfo->pixelSize();
+    }
+
+    QOpenGLBuffer *buffer = m_bufferStorage.getNextBuffer(totalSize);
+    KIS_SAFE_ASSERT_RECOVER_RETURN(buffer);
+
+    quint8 *dstPtr = static_cast<quint8*>(buffer->map(QOpenGLBuffer::WriteOnly));
+
+    if (!dstPtr) {
+        warnUI << "OpenGL: failed to map the pixel unpack buffer, uploading tiles from client memory";
+        buffer->release();
+
+        Q_FOREACH (KisTextureTileUpdateInfoSP tileInfo, tileList) {
+            KisTextureTile *tile = getTextureTileCR(tileInfo->tileCol(), tileInfo->tileRow());
+            KIS_ASSERT_RECOVER_RETURN(tile);
+
+            tile->update(*tileInfo);
+        }
+        return;
+    }
+
+    for (int i = 0; i < tileList.size(); i++) {
+        const KisTextureTileUpdateInfoSP &tileInfo = tileList[i];
+        const QSize patchSize = tileInfo->realPatchSize();
+
+        memcpy(dstPtr + offsets[i], tileInfo->data(),
+               patchSize.width() * patchSize.height() * tileInfo->pixelSize());
+    }
+
+    buffer->unmap();
+
+    for (int i = 0; i < tileList.size(); i++) {
+        const KisTextureTileUpdateInfoSP &tileInfo = tileList[i];
+
+        KisTextureTile *tile = getTextureTileCR(tileInfo->tileCol(), tileInfo->tileRow());
+        KIS_SAFE_ASSERT_RECOVER(tile) { continue; }
+
+        tile->updateFromPixelBuffer(*tileInfo, offsets[i]);
+    }
+
+    buffer->release();
+#else
+    Q_UNUSED(tileList);
+#endif
+}
+
 void KisOpenGLImageTextures::generateCheckerTexture(const QImage &checkImage)
 {
 
@@ -443,10 +625,17 @@ GLuint KisOpenGLImageTextures::checkerTexture()
 
 void KisOpenGLImageTextures::updateConfig(bool useBuffer, int NumMipmapLevels)
 {
+    m_useBuffer = useBuffer;
+    m_numMipmapLevels = NumMipmapLevels;
+
+    if (!m_useBuffer) {
+        m_bufferStorage.reset();
+    }
+
     if(m_textureTiles.isEmpty()) return;
 
     Q_FOREACH (KisTextureTile *tile, m_textureTiles) {
-        tile->setUseBuffer(useBuffer);
+        if (!tile) continue;
         tile->setNumMipmapLevels(NumMipmapLevels);
     }
 }
@@ -463,6 +652,11 @@ void KisOpenGLImageTextures::setMonitorProfile(const KoColorProfile *monitorProf
     m_renderingIntent = renderingIntent;
     m_conversionFlags = conversionFlags;
 
+    {
+        QMutexLocker l(&m_displayLutLock);
+        m_displayLutDirty = true;
+    }
+
     createImageTextureTiles();
 }
 
@@ -491,6 +685,9 @@ void KisOpenGLImageTextures::setProofingConfig(KisProofingConfigurationSP proofi
 {
     m_proofingConfig = proofingConfig;
     m_createNewProofingTransform = true;
+
+    QMutexLocker l(&m_displayLutLock);
+    m_displayLutDirty = true;
 }
 
 void KisOpenGLImageTextures::getTextureSize(KisGLTexturesInfo *texturesInfo)
@@ -508,11 +705,45 @@ void KisOpenGLImageTextures::getTextureSize(KisGLTexturesInfo *texturesInfo)
         maxTextureSize = GL_MAX_TEXTURE_SIZE;
     }
 
-    texturesInfo->width = qMin(preferredTextureSize, maxTextureSize);
-    texturesInfo->height = qMin(preferredTextureSize, maxTextureSize);
-
     texturesInfo->border = cfg.textureOverlapBorder();
 
+    int textureSize = qMin(preferredTextureSize, maxTextureSize);
+
+    if (m_image) {
+        const QSize imageSize = m_image->bounds().size();
+        const int border = texturesInfo->border;
+
+        /**
+         * Small images don't need big textures, all the extra space
+         * would be just wasted
+         */
+        while (textureSize / 2 >= MIN_ADAPTIVE_TEXTURE_SIZE &&
+               textureSize / 2 - 2 * border >= qMax(imageSize.width(), imageSize.height())) {
+
+            textureSize /= 2;
+        }
+
+        /**
+         * Huge images would have too many tiles, which costs us a lot
+         * on drawing and on creation of the grid. Enlarge the tiles
+         * as far as the GPU allows.
+         */
+        auto numTiles = [imageSize, border] (int size) {
+            const int effectiveSize = size - 2 * border;
+            return qint64(imageSize.width() / effectiveSize + 1) *
+                   qint64(imageSize.height() / effectiveSize + 1);
+        };
+
+        while (numTiles(textureSize) > MAX_ADAPTIVE_TEXTURE_TILES &&
+               textureSize * 2 <= maxTextureSize) {
+
+            textureSize *= 2;
+        }
+    }
+
+    texturesInfo->width = textureSize;
+    texturesInfo->height = textureSize;
+
     texturesInfo->effectiveWidth = texturesInfo->width - 2 * texturesInfo->border;
     texturesInfo->effectiveHeight = texturesInfo->height - 2 * texturesInfo->border;
 }
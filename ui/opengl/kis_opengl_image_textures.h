@@ -20,6 +20,7 @@
 
 #include <QVector>
 #include <QMap>
+#include <QMutex>
 #include <QOpenGLFunctions>
 
 #include "kritaui_export.h"
@@ -28,6 +29,8 @@
 
 #include "canvas/kis_update_info.h"
 #include "opengl/kis_texture_tile.h"
+#include "opengl/kis_opengl_buffer_circular_storage.h"
+#include "opengl/kis_display_color_lut.h"
 #include "KisProofingConfiguration.h"
 #include <KoColorProofingConversionTransformation.h>
 
@@ -117,6 +120,11 @@ public:
         return y / m_texturesInfo.effectiveHeight;
     }
 
+    /**
+     * \return the tile at (\p col, \p row) or null if the tile has
+     * not been created yet. The tiles are allocated lazily, so a null
+     * tile inside the image bounds means the area is fully transparent.
+     */
     inline KisTextureTile* getTextureTileCR(int col, int row) {
         if (m_initialized) {
             int tile = row * m_numCols + col;
@@ -153,11 +161,14 @@ protected:
 private:
 
     QRect calculateTileRect(int col, int row) const;
+    KisTextureTile* createTextureTileCR(int col, int row);
 
     void getTextureSize(KisGLTexturesInfo *texturesInfo);
 
     void updateTextureFormat();
+    void uploadTilesFromPixelBuffer(const KisTextureTileUpdateInfoSPList &tileList);
     KisOpenGLUpdateInfoSP updateCacheImpl(const QRect& rect, KisImageSP srcImage, bool convertColorSpace);
+    KisDisplayColorLutSP fetchDisplayLut(const KoColorSpace *srcColorSpace, bool useProofing);
 
 private:
     KisImageWSP m_image;
@@ -190,6 +201,9 @@ private:
     KisGLTexturesInfo m_texturesInfo;
     int m_numCols;
     QVector<KisTextureTile*> m_textureTiles;
+    QByteArray m_emptyTileData;
+    KisOpenGL::FilterMode m_filterMode;
+    int m_numMipmapLevels;
 
     QOpenGLFunctions *m_glFuncs;
     QBitArray m_channelFlags;
@@ -200,6 +214,21 @@ private:
     bool m_useOcio;
     bool m_initialized;
 
+    bool m_useBuffer;
+    KisOpenGLBufferCircularStorage m_bufferStorage;
+
+    /**
+     * The lookup table approximating the current display (or proofing)
+     * transformation. It is rebuilt lazily when the transformation
+     * changes and is null when the table cannot be used.
+     */
+    QMutex m_displayLutLock;
+    KisDisplayColorLutSP m_displayLut;
+    bool m_displayLutDirty = true;
+    bool m_displayLutUsesProofing = false;
+    const KoColorSpace *m_displayLutSrcColorSpace = 0;
+    const KoColorSpace *m_displayLutDstColorSpace = 0;
+
     KisTextureTileInfoPoolSP m_infoChunksPool;
 
 private:
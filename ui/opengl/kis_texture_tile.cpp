@@ -21,14 +21,15 @@
 #include "kis_texture_tile_update_info.h"
 
 #include <kis_debug.h>
-#if !defined(QT_OPENGL_ES)
-#include <QOpenGLBuffer>
-#endif
 
 #ifndef GL_BGRA
 #define GL_BGRA 0x814F
 #endif
 
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+
 void KisTextureTile::setTextureParameters()
 {
 
@@ -64,18 +65,14 @@ inline QRectF relativeRect(const QRect &br /* baseRect */,
 
 KisTextureTile::KisTextureTile(const QRect &imageRect, const KisGLTexturesInfo *texturesInfo,
                                const QByteArray &fillData, KisOpenGL::FilterMode filter,
-                               bool useBuffer, int numMipmapLevels, QOpenGLFunctions *fcn)
+                               int numMipmapLevels, QOpenGLFunctions *fcn)
 
     : m_textureId(0)
-#ifdef USE_PIXEL_BUFFERS
-    , m_glBuffer(0)
-#endif
     , m_tileRectInImagePixels(imageRect)
     , m_filter(filter)
     , m_texturesInfo(texturesInfo)
     , m_needsMipmapRegeneration(false)
     , m_currentLodPlane(0)
-    , m_useBuffer(useBuffer)
     , m_numMipmapLevels(numMipmapLevels)
     , f(fcn)
 {
@@ -93,12 +90,6 @@ KisTextureTile::KisTextureTile(const QRect &imageRect, const KisGLTexturesInfo *
 
     setTextureParameters();
 
-#ifdef USE_PIXEL_BUFFERS
-    createTextureBuffer(fillData.constData(), fillData.size());
-    // we set fill data to 0 so the next glTexImage2D call uses our buffer
-    fd = 0;
-#endif
-
     f->glTexImage2D(GL_TEXTURE_2D, 0,
                  m_texturesInfo->internalFormat,
                  m_texturesInfo->width,
@@ -106,20 +97,11 @@ KisTextureTile::KisTextureTile(const QRect &imageRect, const KisGLTexturesInfo *
                  m_texturesInfo->format,
                  m_texturesInfo->type, fd);
 
-#ifdef USE_PIXEL_BUFFERS
-    if (m_useBuffer) {
-        m_glBuffer->release();
-    }
-#endif
-
     setNeedsMipmapRegeneration();
 }
 
 KisTextureTile::~KisTextureTile()
 {
-#ifdef USE_PIXEL_BUFFERS
-    delete m_glBuffer;
-#endif
     f->glDeleteTextures(1, &m_textureId);
 }
 
@@ -156,6 +138,23 @@ void KisTextureTile::setCurrentLodPlane(int lod)
 }
 
 void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
+{
+    updateImpl(updateInfo, updateInfo.data(), false);
+}
+
+#ifdef USE_PIXEL_BUFFERS
+void KisTextureTile::updateFromPixelBuffer(const KisTextureTileUpdateInfo &updateInfo, quintptr bufferOffset)
+{
+    /**
+     * When a pixel unpack buffer is bound, the data pointers passed
+     * to glTexSubImage2D are interpreted as offsets in the buffer
+     */
+    updateImpl(updateInfo, reinterpret_cast<const quint8*>(bufferOffset), true);
+}
+#endif
+
+void KisTextureTile::updateImpl(const KisTextureTileUpdateInfo &updateInfo,
+                                const quint8 *data, bool fromPixelBuffer)
 {
     f->initializeOpenGLFunctions();
     f->glBindTexture(GL_TEXTURE_2D, m_textureId);
@@ -166,12 +165,7 @@ void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
     const QSize patchSize = updateInfo.realPatchSize();
     const QPoint patchOffset = updateInfo.realPatchOffset();
 
-    const GLvoid *fd = updateInfo.data();
-#ifdef USE_PIXEL_BUFFERS
-    if (!m_glBuffer) {
-        createTextureBuffer((const char*)updateInfo.data(), updateInfo.patchPixelsLength());
-    }
-#endif
+    const GLvoid *fd = data;
 
     /**
      * In some special case, when the Lod0 stroke is cancelled the
@@ -204,21 +198,6 @@ void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
 
     if (updateInfo.isEntireTileUpdated()) {
 
-#ifdef USE_PIXEL_BUFFERS
-        if (m_useBuffer) {
-
-            m_glBuffer->bind();
-            m_glBuffer->allocate(updateInfo.patchPixelsLength());
-
-            void *vid = m_glBuffer->map(QOpenGLBuffer::WriteOnly);
-            memcpy(vid, fd, updateInfo.patchPixelsLength());
-            m_glBuffer->unmap();
-
-            // we set fill data to 0 so the next glTexImage2D call uses our buffer
-            fd = 0;
-        }
-#endif
-
         f->glTexImage2D(GL_TEXTURE_2D, patchLevelOfDetail,
                      m_texturesInfo->internalFormat,
                      patchSize.width(),
@@ -227,42 +206,14 @@ void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
                      m_texturesInfo->type,
                      fd);
 
-#ifdef USE_PIXEL_BUFFERS
-        if (m_useBuffer) {
-            m_glBuffer->release();
-        }
-#endif
-
     }
     else {
-#ifdef USE_PIXEL_BUFFERS
-        if (m_useBuffer) {
-            m_glBuffer->bind();
-            quint32 size = patchSize.width() * patchSize.height() * updateInfo.pixelSize();
-            m_glBuffer->allocate(size);
-
-            void *vid = m_glBuffer->map(QOpenGLBuffer::WriteOnly);
-            memcpy(vid, fd, size);
-            m_glBuffer->unmap();
-
-            // we set fill data to 0 so the next glTexImage2D call uses our buffer
-            fd = 0;
-        }
-#endif
-
         f->glTexSubImage2D(GL_TEXTURE_2D, patchLevelOfDetail,
                         patchOffset.x(), patchOffset.y(),
                         patchSize.width(), patchSize.height(),
                         m_texturesInfo->format,
                         m_texturesInfo->type,
                         fd);
-
-#ifdef USE_PIXEL_BUFFERS
-        if (m_useBuffer) {
-            m_glBuffer->release();
-        }
-#endif
-
     }
 
     /**
@@ -288,7 +239,7 @@ void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
                             patchSize.width(), 1,
                             m_texturesInfo->format,
                             m_texturesInfo->type,
-                            updateInfo.data());
+                            data);
         }
     }
 
@@ -304,11 +255,51 @@ void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
                             patchSize.width(), 1,
                             m_texturesInfo->format,
                             m_texturesInfo->type,
-                            updateInfo.data() + shift);
+                            data + shift);
         }
     }
 
-    if (updateInfo.isLeftmost()) {
+    if (fromPixelBuffer &&
+        (updateInfo.isLeftmost() || updateInfo.isRightmost())) {
+
+        /**
+         * We cannot prepare the column in the client memory, because
+         * the data is already in the buffer. Instead, we upload the
+         * column right from the patch using the row length parameter.
+         */
+        f->glPixelStorei(GL_UNPACK_ROW_LENGTH, patchSize.width());
+
+        if (updateInfo.isLeftmost()) {
+            int start = 0;
+            int end = patchOffset.x() - 1;
+            for (int i = start; i <= end; i++) {
+                f->glTexSubImage2D(GL_TEXTURE_2D, patchLevelOfDetail,
+                                i, patchOffset.y(),
+                                1, patchSize.height(),
+                                m_texturesInfo->format,
+                                m_texturesInfo->type,
+                                data);
+            }
+        }
+
+        if (updateInfo.isRightmost()) {
+            const quint8 *columnData = data + (patchSize.width() - 1) * pixelSize;
+
+            int start = patchOffset.x() + patchSize.width();
+            int end = tileSize.width() - 1;
+            for (int i = start; i <= end; i++) {
+                f->glTexSubImage2D(GL_TEXTURE_2D, patchLevelOfDetail,
+                                i, patchOffset.y(),
+                                1, patchSize.height(),
+                                m_texturesInfo->format,
+                                m_texturesInfo->type,
+                                columnData);
+            }
+        }
+
+        f->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    } else if (updateInfo.isLeftmost()) {
 
         QByteArray columnBuffer(patchSize.height() * pixelSize, 0);
 
@@ -333,7 +324,7 @@ void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
         }
     }
 
-    if (updateInfo.isRightmost()) {
+    if (!fromPixelBuffer && updateInfo.isRightmost()) {
 
         QByteArray columnBuffer(patchSize.height() * pixelSize, 0);
 
@@ -374,25 +365,3 @@ void KisTextureTile::update(const KisTextureTileUpdateInfo &updateInfo)
     }
 }
 
-#ifdef USE_PIXEL_BUFFERS
-void KisTextureTile::createTextureBuffer(const char *data, int size)
-{
-    if (m_useBuffer) {
-        if (!m_glBuffer) {
-            m_glBuffer = new QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
-            m_glBuffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-            m_glBuffer->create();
-            m_glBuffer->bind();
-            m_glBuffer->allocate(size);
-        }
-        void *vid = m_glBuffer->map(QOpenGLBuffer::WriteOnly);
-        memcpy(vid, data, size);
-        m_glBuffer->unmap();
-
-    }
-    else {
-        delete m_glBuffer;
-        m_glBuffer = 0;
-    }
-}
-#endif
@@ -30,7 +30,6 @@
 #endif
 
 class KisTextureTileUpdateInfo;
-class QOpenGLBuffer;
 
 
 struct KisGLTexturesInfo {
@@ -69,19 +68,27 @@ class KisTextureTile
 public:
     KisTextureTile(const QRect &imageRect, const KisGLTexturesInfo *texturesInfo,
                    const QByteArray &fillData, KisOpenGL::FilterMode mode,
-                   bool useBuffer, int numMipmapLevels, QOpenGLFunctions *f);
+                   int numMipmapLevels, QOpenGLFunctions *f);
     ~KisTextureTile();
 
-    void setUseBuffer(bool useBuffer) {
-        m_useBuffer = useBuffer;
-    }
-
     void setNumMipmapLevels(int num) {
         m_numMipmapLevels = num;
     }
 
+    /**
+     * Uploads the patch from the client memory of \p updateInfo
+     */
     void update(const KisTextureTileUpdateInfo &updateInfo);
 
+#ifdef USE_PIXEL_BUFFERS
+    /**
+     * Uploads the patch from the pixel unpack buffer currently bound
+     * to the context. The pixels of the patch should be stored in the
+     * buffer starting at \p bufferOffset.
+     */
+    void updateFromPixelBuffer(const KisTextureTileUpdateInfo &updateInfo, quintptr bufferOffset);
+#endif
+
     inline QRect tileRectInImagePixels() {
         return m_tileRectInImagePixels;
     }
@@ -100,16 +107,14 @@ public:
 private:
     inline void setTextureParameters();
 
+    void updateImpl(const KisTextureTileUpdateInfo &updateInfo,
+                    const quint8 *data, bool fromPixelBuffer);
+
     void setNeedsMipmapRegeneration();
     void setCurrentLodPlane(int lod);
 
     GLuint m_textureId;
 
-#ifdef USE_PIXEL_BUFFERS
-    void createTextureBuffer(const char*data, int size);
-    QOpenGLBuffer *m_glBuffer;
-#endif
-
     QRect m_tileRectInImagePixels;
     QRectF m_tileRectInTexturePixels;
     QRect m_textureRectInImagePixels;
@@ -117,7 +122,6 @@ private:
     const KisGLTexturesInfo *m_texturesInfo;
     bool m_needsMipmapRegeneration;
     int m_currentLodPlane;
-    bool m_useBuffer;
     int m_numMipmapLevels;
     QOpenGLFunctions *f;
     Q_DISABLE_COPY(KisTextureTile)
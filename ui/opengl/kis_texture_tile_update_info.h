@@ -21,6 +21,7 @@
 #include <QMessageBox>
 #include <QThreadStorage>
 #include <QScopedArrayPointer>
+#include <QVarLengthArray>
 
 #include <KoColorSpace.h>
 #include "kis_image.h"
@@ -30,6 +31,8 @@
 #include <KoChannelInfo.h>
 #include <kis_lod_transform.h>
 #include "kis_texture_tile_info_pool.h"
+#include "kis_display_color_lut.h"
+#include "kis_assert.h"
 
 
 class KisTextureTileUpdateInfo;
@@ -144,50 +147,20 @@ public:
         // XXX: if the paint colorspace is rgb, we should do the channel swizzling in
         //      the display shader
         if (!channelFlags.isEmpty()) {
-            DataBuffer conversionCache(m_patchColorSpace->pixelSize(), m_pool);
-
-            QList<KoChannelInfo*> channelInfo = m_patchColorSpace->channels();
-            int channelSize = channelInfo[selectedChannelIndex]->size();
-            int pixelSize = m_patchColorSpace->pixelSize();
-            quint32 numPixels = m_patchRect.width() * m_patchRect.height();
+            const QList<KoChannelInfo*> channelInfo = m_patchColorSpace->channels();
+            const int numPixels = m_patchRect.width() * m_patchRect.height();
 
             KisConfig cfg;
 
+            /**
+             * Both the operations are done in-place, so we don't need
+             * to allocate any conversion buffer here
+             */
             if (onlyOneChannelSelected && !cfg.showSingleChannelAsColor()) {
-                int selectedChannelPos = channelInfo[selectedChannelIndex]->pos();
-                for (uint pixelIndex = 0; pixelIndex < numPixels; ++pixelIndex) {
-                    for (uint channelIndex = 0; channelIndex < m_patchColorSpace->channelCount(); ++channelIndex) {
-
-                        if (channelInfo[channelIndex]->channelType() == KoChannelInfo::COLOR) {
-                            memcpy(conversionCache.data() + (pixelIndex * pixelSize) + (channelIndex * channelSize),
-                                   m_patchPixels.data() + (pixelIndex * pixelSize) + selectedChannelPos,
-                                   channelSize);
-                        }
-                        else if (channelInfo[channelIndex]->channelType() == KoChannelInfo::ALPHA) {
-                            memcpy(conversionCache.data() + (pixelIndex * pixelSize) + (channelIndex * channelSize),
-                                   m_patchPixels.data() + (pixelIndex * pixelSize) + (channelIndex * channelSize),
-                                   channelSize);
-                        }
-                    }
-                }
-            }
-            else {
-                for (uint pixelIndex = 0; pixelIndex < numPixels; ++pixelIndex) {
-                    for (uint channelIndex = 0; channelIndex < m_patchColorSpace->channelCount(); ++channelIndex) {
-                        if (channelFlags.testBit(channelIndex)) {
-                            memcpy(conversionCache.data() + (pixelIndex * pixelSize) + (channelIndex * channelSize),
-                                   m_patchPixels.data() + (pixelIndex * pixelSize) + (channelIndex * channelSize),
-                                   channelSize);
-                        }
-                        else {
-                            memset(conversionCache.data() + (pixelIndex * pixelSize) + (channelIndex * channelSize), 0, channelSize);
-                        }
-                    }
-                }
-
+                isolateChannel(m_patchPixels.data(), numPixels, m_patchColorSpace->pixelSize(), channelInfo, selectedChannelIndex);
+            } else {
+                maskChannels(m_patchPixels.data(), numPixels, m_patchColorSpace->pixelSize(), channelInfo, channelFlags);
             }
-
-            conversionCache.swap(m_patchPixels);
         }
 
     }
@@ -232,6 +205,25 @@ public:
         }
     }
 
+    /**
+     * Converts the patch with a precalculated lookup table instead of
+     * calling the color conversion transformation for every pixel
+     */
+    void convertWithLut(const KisDisplayColorLut *lut)
+    {
+        KIS_SAFE_ASSERT_RECOVER_RETURN(lut->srcColorSpace() == m_patchColorSpace);
+
+        if (m_patchRect.isValid()) {
+            const qint32 numPixels = m_patchRect.width() * m_patchRect.height();
+            DataBuffer conversionCache(lut->dstColorSpace()->pixelSize(), m_pool);
+
+            lut->transform(m_patchPixels.data(), conversionCache.data(), numPixels);
+
+            m_patchColorSpace = lut->dstColorSpace();
+            conversionCache.swap(m_patchPixels);
+        }
+    }
+
     KoColorConversionTransformation *generateProofingTransform(const KoColorSpace* dstCS, const KoColorSpace* proofingSpace,
                                                        KoColorConversionTransformation::Intent renderingIntent,
                                                        KoColorConversionTransformation::Intent proofingIntent,
@@ -246,6 +238,10 @@ public:
         return m_patchPixels.data();
     }
 
+    inline const KoColorSpace* patchColorSpace() const {
+        return m_patchColorSpace;
+    }
+
     inline int patchLevelOfDetail() const {
         return m_patchLevelOfDetail;
     }
@@ -303,9 +299,158 @@ public:
         return m_patchRect.isValid();
     }
 
+    /**
+     * \return true if all the bytes of the patch are zero, that is
+     * the patch has the same content as a freshly created texture tile
+     */
+    inline bool isFullyTransparent() const {
+        if (!m_patchPixels.data()) return true;
+
+        const int numBytes = m_patchRect.width() * m_patchRect.height() * pixelSize();
+        const quint8 *ptr = m_patchPixels.data();
+
+        for (int i = 0; i < numBytes; i++) {
+            if (ptr[i]) return false;
+        }
+
+        return true;
+    }
+
 private:
     Q_DISABLE_COPY(KisTextureTileUpdateInfo)
 
+    /**
+     * Zeroes all the channels that are not set in \p channelFlags.
+     *
+     * The mask is prepared for a row of MASK_ROW_PIXELS pixels, so the
+     * inner loop works over a plain contiguous byte array, which lets
+     * the compiler vectorize it for any pixel layout.
+     */
+    static void maskChannels(quint8 *pixels, int numPixels, int pixelSize,
+                             const QList<KoChannelInfo*> &channelInfo,
+                             const QBitArray &channelFlags)
+    {
+        const int MASK_ROW_PIXELS = 64;
+        const int maskRowSize = MASK_ROW_PIXELS * pixelSize;
+
+        QVarLengthArray<quint8, MASK_ROW_PIXELS * 20> maskRow(maskRowSize);
+        memset(maskRow.data(), 0, maskRowSize);
+
+        for (int i = 0; i < channelInfo.size(); i++) {
+            if (!channelFlags.testBit(i)) continue;
+
+            const int pos = channelInfo[i]->pos();
+            const int size = channelInfo[i]->size();
+
+            for (int j = 0; j < MASK_ROW_PIXELS; j++) {
+                memset(maskRow.data() + j * pixelSize + pos, 0xFF, size);
+            }
+        }
+
+        const quint8 *mask = maskRow.constData();
+        const int totalSize = numPixels * pixelSize;
+        int offset = 0;
+
+        for (; offset + maskRowSize <= totalSize; offset += maskRowSize) {
+            quint8 *dst = pixels + offset;
+            for (int i = 0; i < maskRowSize; i++) {
+                dst[i] &= mask[i];
+            }
+        }
+
+        quint8 *dst = pixels + offset;
+        for (int i = 0; i < totalSize - offset; i++) {
+            dst[i] &= mask[i];
+        }
+    }
+
+    /**
+     * Copies the value of the selected channel into all the color
+     * channels of the pixel. Alpha channel is kept untouched.
+     */
+    template <typename channel_type, int channels_nb>
+    static void isolateChannelImpl(quint8 *pixels, int numPixels,
+                                   int selectedOffset,
+                                   const int *colorOffsets, int numColorChannels)
+    {
+        channel_type *ptr = reinterpret_cast<channel_type*>(pixels);
+
+        for (int i = 0; i < numPixels; i++) {
+            const channel_type value = ptr[selectedOffset];
+
+            for (int j = 0; j < numColorChannels; j++) {
+                ptr[colorOffsets[j]] = value;
+            }
+
+            ptr += channels_nb;
+        }
+    }
+
+    static void isolateChannel(quint8 *pixels, int numPixels, int pixelSize,
+                               const QList<KoChannelInfo*> &channelInfo,
+                               int selectedChannelIndex)
+    {
+        const int channelSize = channelInfo[selectedChannelIndex]->size();
+        const int channelsCount = channelInfo.size();
+
+        bool uniformChannels = true;
+        QVarLengthArray<int, 8> colorOffsets;
+
+        Q_FOREACH (KoChannelInfo *info, channelInfo) {
+            uniformChannels &= info->size() == channelSize;
+
+            if (info->channelType() == KoChannelInfo::COLOR) {
+                colorOffsets.append(info->pos() / channelSize);
+            }
+        }
+
+        const int selectedOffset = channelInfo[selectedChannelIndex]->pos() / channelSize;
+
+        /**
+         * Fast path for the most common layouts: 8-, 16- and 32-bit
+         * RGBA and CMYKA
+         */
+        if (uniformChannels && (channelsCount == 4 || channelsCount == 5)) {
+            const int *offsets = colorOffsets.constData();
+            const int numColorChannels = colorOffsets.size();
+
+            if (channelSize == 1 && channelsCount == 4) {
+                isolateChannelImpl<quint8, 4>(pixels, numPixels, selectedOffset, offsets, numColorChannels);
+                return;
+            } else if (channelSize == 1 && channelsCount == 5) {
+                isolateChannelImpl<quint8, 5>(pixels, numPixels, selectedOffset, offsets, numColorChannels);
+                return;
+            } else if (channelSize == 2 && channelsCount == 4) {
+                isolateChannelImpl<quint16, 4>(pixels, numPixels, selectedOffset, offsets, numColorChannels);
+                return;
+            } else if (channelSize == 2 && channelsCount == 5) {
+                isolateChannelImpl<quint16, 5>(pixels, numPixels, selectedOffset, offsets, numColorChannels);
+                return;
+            } else if (channelSize == 4 && channelsCount == 4) {
+                isolateChannelImpl<quint32, 4>(pixels, numPixels, selectedOffset, offsets, numColorChannels);
+                return;
+            } else if (channelSize == 4 && channelsCount == 5) {
+                isolateChannelImpl<quint32, 5>(pixels, numPixels, selectedOffset, offsets, numColorChannels);
+                return;
+            }
+        }
+
+        // generic (slow) version
+        const int selectedChannelPos = channelInfo[selectedChannelIndex]->pos();
+
+        for (int pixelIndex = 0; pixelIndex < numPixels; ++pixelIndex) {
+            quint8 *pixel = pixels + pixelIndex * pixelSize;
+
+            Q_FOREACH (KoChannelInfo *info, channelInfo) {
+                if (info->channelType() == KoChannelInfo::COLOR &&
+                    info->pos() != selectedChannelPos) {
+
+                    memcpy(pixel + info->pos(), pixel + selectedChannelPos, channelSize);
+                }
+            }
+        }
+    }
+
 private:
     qint32 m_tileCol;
     qint32 m_tileRow;
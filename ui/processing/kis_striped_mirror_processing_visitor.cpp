@@ -0,0 +1,253 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "kis_striped_mirror_processing_visitor.h"
+
+#include <QtConcurrent>
+#include <QAtomicInt>
+#include <QtMath>
+
+#include <KoUpdater.h>
+
+#include <kis_paint_device.h>
+#include <kis_paint_layer.h>
+#include <kis_transaction.h>
+#include <processing/kis_mirror_processing_visitor.h>
+
+
+namespace {
+
+struct MirrorStripeJob {
+    QRect rect;
+};
+
+/**
+ * Returns the position of \p rc after mirroring, \p mirrorSum is the sum
+ * of the coordinates of a pixel and its mirrored position
+ */
+QRect mirroredRect(const QRect &rc, Qt::Orientation orientation, int mirrorSum)
+{
+    return orientation == Qt::Horizontal ?
+        QRect(mirrorSum - rc.right(), rc.y(), rc.width(), rc.height()) :
+        QRect(rc.x(), mirrorSum - rc.bottom(), rc.width(), rc.height());
+}
+
+/**
+ * Reads \p rc from \p device and returns its pixels in the mirrored order
+ */
+QVector<quint8> readMirrored(KisPaintDeviceSP device, Qt::Orientation orientation, const QRect &rc)
+{
+    const int pixelSize = device->pixelSize();
+    const int rowSize = rc.width() * pixelSize;
+
+    QVector<quint8> srcData(rowSize * rc.height());
+    QVector<quint8> dstData(srcData.size());
+
+    device->readBytes(srcData.data(), rc);
+
+    const quint8 *src = srcData.constData();
+    quint8 *dst = dstData.data();
+
+    if (orientation == Qt::Horizontal) {
+        for (int y = 0; y < rc.height(); y++) {
+            const quint8 *srcPtr = src + y * rowSize;
+            quint8 *dstPtr = dst + y * rowSize + rowSize - pixelSize;
+
+            for (int x = 0; x < rc.width(); x++) {
+                memcpy(dstPtr, srcPtr, pixelSize);
+                srcPtr += pixelSize;
+                dstPtr -= pixelSize;
+            }
+        }
+    } else {
+        for (int y = 0; y < rc.height(); y++) {
+            memcpy(dst + (rc.height() - 1 - y) * rowSize, src + y * rowSize, rowSize);
+        }
+    }
+
+    return dstData;
+}
+
+/**
+ * Swaps the content of \p rc and its mirrored position. Both the rects
+ * are read before anything is written, so they may overlap. The pixels
+ * between them (if any) are not touched, so no tiles are allocated there.
+ */
+void mirrorStripe(KisPaintDeviceSP device, Qt::Orientation orientation, int mirrorSum, const QRect &rc)
+{
+    const QRect mirrored = mirroredRect(rc, orientation, mirrorSum);
+
+    const QVector<quint8> srcData = readMirrored(device, orientation, rc);
+    const QVector<quint8> dstData = readMirrored(device, orientation, mirrored);
+
+    device->writeBytes(dstData.constData(), rc);
+    device->writeBytes(srcData.constData(), mirrored);
+}
+
+/**
+ * Splits \p rc into stripes across \p orientation aligned to the
+ * multiples of \p stripeSize counted from \p origin
+ */
+QVector<MirrorStripeJob> splitIntoStripes(const QRect &rc, Qt::Orientation orientation,
+                                          const QPoint &origin, int stripeSize)
+{
+    QVector<MirrorStripeJob> jobs;
+
+    const bool rows = orientation == Qt::Horizontal;
+    const int start = rows ? rc.top() : rc.left();
+    const int end = rows ? rc.bottom() : rc.right();
+    const int originCoord = rows ? origin.y() : origin.x();
+
+    int stripeStart =
+        originCoord + qFloor(qreal(start - originCoord) / stripeSize) * stripeSize;
+
+    for (; stripeStart <= end; stripeStart += stripeSize) {
+        const int from = qMax(start, stripeStart);
+        const int to = qMin(end, stripeStart + stripeSize - 1);
+
+        MirrorStripeJob job;
+        job.rect = rows ?
+            QRect(rc.left(), from, rc.width(), to - from + 1) :
+            QRect(from, rc.top(), to - from + 1, rc.height());
+
+        jobs.append(job);
+    }
+
+    return jobs;
+}
+
+}
+
+KisStripedMirrorProcessingVisitor::KisStripedMirrorProcessingVisitor(const QRect &bounds, Qt::Orientation orientation)
+    : m_fallbackVisitor(new KisMirrorProcessingVisitor(bounds, orientation)),
+      m_orientation(orientation)
+{
+    m_axis = m_orientation == Qt::Horizontal ?
+        bounds.x() + 0.5 * bounds.width() :
+        bounds.y() + 0.5 * bounds.height();
+}
+
+KisStripedMirrorProcessingVisitor::~KisStripedMirrorProcessingVisitor()
+{
+}
+
+void KisStripedMirrorProcessingVisitor::mirrorDevice(KisPaintDeviceSP device, qreal axis,
+                                                     Qt::Orientation orientation,
+                                                     KoUpdater *progressUpdater,
+                                                     int stripeSize)
+{
+    KIS_SAFE_ASSERT_RECOVER_RETURN(qFloor(2 * axis) == 2 * axis);
+
+    /**
+     * The exact bounds are used (like in KisTransformWorker::mirror()),
+     * otherwise the empty parts of the extent would allocate new tiles
+     * around the mirrored content
+     */
+    const QRect contentRect = device->exactBounds();
+    if (contentRect.isEmpty()) return;
+
+    // the position of a pixel and its mirrored position sum up to this value
+    const int mirrorSum = int(2 * axis) - 1;
+
+    QVector<MirrorStripeJob> jobs =
+        splitIntoStripes(contentRect, orientation, QPoint(device->x(), device->y()), stripeSize);
+
+    QAtomicInt numProcessedJobs(0);
+    const int numJobs = jobs.size();
+
+    QtConcurrent::blockingMap(jobs,
+        [device, orientation, mirrorSum, progressUpdater, &numProcessedJobs, numJobs] (const MirrorStripeJob &job) {
+            mirrorStripe(device, orientation, mirrorSum, job.rect);
+
+            if (progressUpdater) {
+                const int numProcessed = numProcessedJobs.fetchAndAddOrdered(1) + 1;
+                progressUpdater->setProgress(100 * numProcessed / numJobs);
+            }
+        });
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisPaintLayer *layer, KisUndoAdapter *undoAdapter)
+{
+    // the frames of animated layers are handled by the generic visitor
+    if (layer->isAnimated()) {
+        m_fallbackVisitor->visit(layer, undoAdapter);
+        return;
+    }
+
+    KisPaintDeviceSP device = layer->paintDevice();
+    ProgressHelper helper(layer);
+
+    KisTransaction transaction(kundo2_i18n("Mirror"), device);
+    mirrorDevice(device, m_axis, m_orientation, helper.updater());
+    transaction.commit(undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisNode *node, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(node, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisGroupLayer *layer, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(layer, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisAdjustmentLayer *layer, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(layer, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisExternalLayer *layer, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(layer, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisGeneratorLayer *layer, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(layer, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisCloneLayer *layer, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(layer, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisFilterMask *mask, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(mask, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisTransformMask *mask, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(mask, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisTransparencyMask *mask, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(mask, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisSelectionMask *mask, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(mask, undoAdapter);
+}
+
+void KisStripedMirrorProcessingVisitor::visit(KisColorizeMask *mask, KisUndoAdapter *undoAdapter)
+{
+    m_fallbackVisitor->visit(mask, undoAdapter);
+}
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __KIS_STRIPED_MIRROR_PROCESSING_VISITOR_H
+#define __KIS_STRIPED_MIRROR_PROCESSING_VISITOR_H
+
+#include <QRect>
+#include <kis_processing_visitor.h>
+#include <kritaui_export.h>
+
+class KoUpdater;
+
+/**
+ * A mirror visitor that processes every paint layer in stripes: the
+ * device is split into tile-aligned horizontal (for mirroring along X)
+ * or vertical (for mirroring along Y) stripes that are mirrored
+ * concurrently, so a single huge layer loads all the cores. The stripes
+ * never touch the same tiles, because each of them contains both a
+ * pixel and its mirrored position. Only the content and its mirrored
+ * position are written, the gap between them is left untouched.
+ *
+ * All the other nodes (and animated paint layers) are passed to
+ * KisMirrorProcessingVisitor.
+ */
+class KRITAUI_EXPORT KisStripedMirrorProcessingVisitor : public KisProcessingVisitor
+{
+public:
+    KisStripedMirrorProcessingVisitor(const QRect &bounds, Qt::Orientation orientation);
+    ~KisStripedMirrorProcessingVisitor() override;
+
+    /**
+     * Mirrors \p device around \p axis in stripes of \p stripeSize
+     * pixels. The axis has the same meaning as in
+     * KisTransformWorker::mirror() and must be a multiple of 0.5.
+     */
+    static void mirrorDevice(KisPaintDeviceSP device, qreal axis,
+                             Qt::Orientation orientation,
+                             KoUpdater *progressUpdater = 0,
+                             int stripeSize = 64);
+
+    void visit(KisNode *node, KisUndoAdapter *undoAdapter) override;
+    void visit(KisPaintLayer *layer, KisUndoAdapter *undoAdapter) override;
+    void visit(KisGroupLayer *layer, KisUndoAdapter *undoAdapter) override;
+    void visit(KisAdjustmentLayer *layer, KisUndoAdapter *undoAdapter) override;
+    void visit(KisExternalLayer *layer, KisUndoAdapter *undoAdapter) override;
+    void visit(KisGeneratorLayer *layer, KisUndoAdapter *undoAdapter) override;
+    void visit(KisCloneLayer *layer, KisUndoAdapter *undoAdapter) override;
+    void visit(KisFilterMask *mask, KisUndoAdapter *undoAdapter) override;
+    void visit(KisTransformMask *mask, KisUndoAdapter *undoAdapter) override;
+    void visit(KisTransparencyMask *mask, KisUndoAdapter *undoAdapter) override;
+    void visit(KisSelectionMask *mask, KisUndoAdapter *undoAdapter) override;
+    void visit(KisColorizeMask *mask, KisUndoAdapter *undoAdapter) override;
+
+private:
+    KisProcessingVisitorSP m_fallbackVisitor;
+    Qt::Orientation m_orientation;
+    qreal m_axis;
+};
+
+#endif /* __KIS_STRIPED_MIRROR_PROCESSING_VISITOR_H */
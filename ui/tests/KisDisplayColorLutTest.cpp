@@ -0,0 +1,238 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisDisplayColorLutTest.h"
+
+#include <QTest>
+
+#include <random>
+
+#include <KoColorSpace.h>
+#include <KoColorSpaceRegistry.h>
+#include <KoColorModelStandardIds.h>
+#include <KoColorConversionTransformation.h>
+#include <KoChannelInfo.h>
+
+#include "kis_debug.h"
+
+#include "opengl/kis_display_color_lut.h"
+
+namespace {
+
+/**
+ * A transformation the lookup table cannot approximate: every color
+ * channel jumps from black to white in the middle of the range
+ */
+class ThresholdTransformation : public KoColorConversionTransformation
+{
+public:
+    ThresholdTransformation(const KoColorSpace *cs)
+        : KoColorConversionTransformation(cs, cs,
+                                          internalRenderingIntent(),
+                                          internalConversionFlags())
+    {
+    }
+
+    void transform(const quint8 *src, quint8 *dst, qint32 nPixels) const override {
+        const quint16 *srcPixel = reinterpret_cast<const quint16*>(src);
+        quint16 *dstPixel = reinterpret_cast<quint16*>(dst);
+
+        for (int i = 0; i < nPixels; i++) {
+            for (int ch = 0; ch < 3; ch++) {
+                dstPixel[ch] = srcPixel[ch] > 32767 ? 65535 : 0;
+            }
+            dstPixel[3] = srcPixel[3];
+
+            srcPixel += 4;
+            dstPixel += 4;
+        }
+    }
+};
+
+}
+
+
+void KisDisplayColorLutTest::testSupportedSpaces()
+{
+    const KoColorSpace *rgb8 = KoColorSpaceRegistry::instance()->rgb8();
+    const KoColorSpace *rgb16 = KoColorSpaceRegistry::instance()->rgb16();
+    const KoColorSpace *lab16 = KoColorSpaceRegistry::instance()->lab16();
+
+    QVERIFY(KisDisplayColorLut::isSupported(rgb16, rgb8));
+    QVERIFY(KisDisplayColorLut::isSupported(rgb16, rgb16));
+
+    QVERIFY(!KisDisplayColorLut::isSupported(rgb8, rgb8));
+    QVERIFY(!KisDisplayColorLut::isSupported(lab16, rgb8));
+    QVERIFY(!KisDisplayColorLut::isSupported(rgb16, lab16));
+}
+
+void KisDisplayColorLutTest::testAccuracy_data()
+{
+    QTest::addColumn<QString>("dstDepth");
+
+    QTest::newRow("u8") << Integer8BitsColorDepthID.id();
+    QTest::newRow("u16") << Integer16BitsColorDepthID.id();
+}
+
+void KisDisplayColorLutTest::testAccuracy()
+{
+    QFETCH(QString, dstDepth);
+
+    const KoColorSpace *srcCS = KoColorSpaceRegistry::instance()->rgb16();
+    const KoColorSpace *dstCS =
+        KoColorSpaceRegistry::instance()->colorSpace(RGBAColorModelID.id(), dstDepth, 0);
+
+    QScopedPointer<KoColorConversionTransformation> transform(
+        srcCS->createColorConverter(dstCS,
+                                    KoColorConversionTransformation::internalRenderingIntent(),
+                                    KoColorConversionTransformation::internalConversionFlags()));
+
+    KisDisplayColorLutSP lut = KisDisplayColorLut::create(srcCS, dstCS, transform.data());
+    QVERIFY(lut);
+    QVERIFY(lut->maxError() <= 0.5 / 255.0);
+    QCOMPARE(lut->srcColorSpace(), srcCS);
+    QCOMPARE(lut->dstColorSpace(), dstCS);
+
+    // a gradient with varying alpha
+
+    const int numPixels = 4096;
+
+    QVector<quint16> srcPixels(4 * numPixels);
+    for (int i = 0; i < numPixels; i++) {
+        srcPixels[4 * i + 0] = quint16(i * 16);
+        srcPixels[4 * i + 1] = quint16(65535 - i * 16);
+        srcPixels[4 * i + 2] = quint16((i * 997) % 65536);
+        srcPixels[4 * i + 3] = quint16(i * 16);
+    }
+
+    QVector<quint8> exactPixels(numPixels * dstCS->pixelSize());
+    QVector<quint8> lutPixels(numPixels * dstCS->pixelSize());
+
+    const quint8 *src = reinterpret_cast<const quint8*>(srcPixels.constData());
+    transform->transform(src, exactPixels.data(), numPixels);
+    lut->transform(src, lutPixels.data(), numPixels);
+
+    const QList<KoChannelInfo*> channels = dstCS->channels();
+
+    for (int i = 0; i < numPixels; i++) {
+        const quint8 *exactPixel = exactPixels.constData() + i * dstCS->pixelSize();
+        const quint8 *lutPixel = lutPixels.constData() + i * dstCS->pixelSize();
+
+        QVector<float> exactValues(channels.size());
+        QVector<float> lutValues(channels.size());
+
+        dstCS->normalisedChannelsValue(exactPixel, exactValues);
+        dstCS->normalisedChannelsValue(lutPixel, lutValues);
+
+        for (int ch = 0; ch < channels.size(); ch++) {
+            if (qAbs(exactValues[ch] - lutValues[ch]) > 1.0 / 255.0) {
+                qDebug() << ppVar(i) << ppVar(ch) << ppVar(exactValues[ch]) << ppVar(lutValues[ch]);
+                QFAIL("LUT transform differs from the exact one");
+            }
+        }
+    }
+}
+
+void KisDisplayColorLutTest::testImpreciseTransformIsRejected()
+{
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb16();
+    QVERIFY(KisDisplayColorLut::isSupported(cs, cs));
+
+    ThresholdTransformation transform(cs);
+
+    KisDisplayColorLutSP lut = KisDisplayColorLut::create(cs, cs, &transform);
+    QVERIFY(!lut);
+}
+
+void KisDisplayColorLutTest::testRealProfilePair()
+{
+    /**
+     * sRGB into a wider gamut with the same tone curve: the matrix part
+     * of the transformation is smooth everywhere, so the table must be
+     * used and stay within its error limit
+     */
+    const KoColorSpace *srcCS =
+        KoColorSpaceRegistry::instance()->colorSpace(RGBAColorModelID.id(),
+                                                     Integer16BitsColorDepthID.id(),
+                                                     "sRGB-elle-V2-srgbtrc.icc");
+    const KoColorSpace *dstCS =
+        KoColorSpaceRegistry::instance()->colorSpace(RGBAColorModelID.id(),
+                                                     Integer16BitsColorDepthID.id(),
+                                                     "ClayRGB-elle-V2-srgbtrc.icc");
+    if (!srcCS || !dstCS) {
+        QSKIP("sRGB-elle-V2-srgbtrc.icc or ClayRGB-elle-V2-srgbtrc.icc profile is not available");
+    }
+
+    QScopedPointer<KoColorConversionTransformation> transform(
+        srcCS->createColorConverter(dstCS,
+                                    KoColorConversionTransformation::internalRenderingIntent(),
+                                    KoColorConversionTransformation::internalConversionFlags()));
+
+    KisDisplayColorLutSP lut = KisDisplayColorLut::create(srcCS, dstCS, transform.data());
+    QVERIFY(lut);
+    QVERIFY(lut->maxError() <= 0.5 / 255.0);
+
+    /**
+     * Check the interpolation on other colors than create() has
+     * measured: random ones with a different seed and a fine gray ramp
+     * near black. The 16-bit destination lets us see the error itself,
+     * not its 8-bit rounding.
+     */
+    const int numRandomPixels = 65536;
+    const int numDarkPixels = 4096;
+    const int numPixels = numRandomPixels + numDarkPixels;
+
+    std::mt19937 generator(12345);
+    std::uniform_int_distribution<int> distribution(0, 65535);
+
+    QVector<quint16> srcPixels(4 * numPixels);
+    for (int i = 0; i < numPixels; i++) {
+        if (i < numRandomPixels) {
+            srcPixels[4 * i + 0] = quint16(distribution(generator));
+            srcPixels[4 * i + 1] = quint16(distribution(generator));
+            srcPixels[4 * i + 2] = quint16(distribution(generator));
+        } else {
+            const quint16 gray = quint16(i - numRandomPixels);
+            srcPixels[4 * i + 0] = gray;
+            srcPixels[4 * i + 1] = gray;
+            srcPixels[4 * i + 2] = gray;
+        }
+        srcPixels[4 * i + 3] = 65535;
+    }
+
+    QVector<quint16> exactPixels(4 * numPixels);
+    QVector<quint16> lutPixels(4 * numPixels);
+
+    const quint8 *src = reinterpret_cast<const quint8*>(srcPixels.constData());
+    transform->transform(src, reinterpret_cast<quint8*>(exactPixels.data()), numPixels);
+    lut->transform(src, reinterpret_cast<quint8*>(lutPixels.data()), numPixels);
+
+    // both results are rounded to 16 bits
+    const qreal maxAllowedError = 0.5 / 255.0 + 1.0 / 65535.0;
+
+    for (int i = 0; i < 4 * numPixels; i++) {
+        const qreal error = qAbs(exactPixels[i] - lutPixels[i]) / 65535.0;
+
+        if (error > maxAllowedError) {
+            qDebug() << ppVar(i / 4) << ppVar(i % 4) << ppVar(exactPixels[i]) << ppVar(lutPixels[i]);
+            QFAIL("LUT transform error is bigger than 0.5/255");
+        }
+    }
+}
+
+QTEST_MAIN(KisDisplayColorLutTest)
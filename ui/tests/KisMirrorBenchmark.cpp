@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisMirrorBenchmark.h"
+
+#include <QTest>
+#include <QThreadPool>
+
+#include <KoColor.h>
+#include <KoColorSpaceRegistry.h>
+
+#include "kis_paint_device.h"
+#include "kis_fill_painter.h"
+#include "kis_transform_worker.h"
+#include "processing/kis_striped_mirror_processing_visitor.h"
+
+
+namespace {
+
+KisPaintDeviceSP createDevice(const QRect &rc)
+{
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisPaintDeviceSP dev = new KisPaintDevice(cs);
+
+    // a few overlapping off-center blocks so that the extent is not
+    // symmetric around the mirroring axis
+    KisFillPainter gc(dev);
+    gc.fillRect(rc.adjusted(0, 0, -rc.width() / 3, -rc.height() / 4), KoColor(Qt::red, cs));
+    gc.fillRect(QRect(rc.topLeft() + QPoint(17, 33), rc.size() / 3), KoColor(Qt::green, cs));
+    gc.fillRect(QRect(rc.center(), rc.size() / 5), KoColor(Qt::blue, cs));
+    gc.end();
+
+    return dev;
+}
+
+}
+
+void KisMirrorBenchmark::testStripedMirrorMatchesWorker()
+{
+    const QRect imageRect(0, 0, 1000, 777);
+
+    for (int i = 0; i < 2; i++) {
+        const Qt::Orientation orientation = i ? Qt::Vertical : Qt::Horizontal;
+        const qreal axis = orientation == Qt::Horizontal ?
+            0.5 * imageRect.width() : 0.5 * imageRect.height();
+
+        KisPaintDeviceSP refDev = createDevice(imageRect);
+        KisTransformWorker::mirror(refDev, axis, orientation);
+
+        KisPaintDeviceSP dev = createDevice(imageRect);
+        KisStripedMirrorProcessingVisitor::mirrorDevice(dev, axis, orientation);
+
+        const QRect rc = refDev->exactBounds() | dev->exactBounds();
+        QCOMPARE(dev->exactBounds(), refDev->exactBounds());
+        QCOMPARE(dev->extent(), refDev->extent());
+        QCOMPARE(dev->convertToQImage(0, rc), refDev->convertToQImage(0, rc));
+    }
+}
+
+void KisMirrorBenchmark::testMirror_data()
+{
+    QTest::addColumn<bool>("striped");
+    QTest::addColumn<int>("numThreads");
+
+    const int idealThreadCount = QThread::idealThreadCount();
+
+    QTest::newRow("worker") << false << idealThreadCount;
+
+    for (int numThreads = 1; numThreads < idealThreadCount; numThreads *= 2) {
+        QTest::newRow(QString("striped-%1").arg(numThreads).toLatin1()) << true << numThreads;
+    }
+
+    QTest::newRow(QString("striped-%1").arg(idealThreadCount).toLatin1()) << true << idealThreadCount;
+}
+
+void KisMirrorBenchmark::testMirror()
+{
+    QFETCH(bool, striped);
+    QFETCH(int, numThreads);
+
+    const QRect imageRect(0, 0, 8192, 8192);
+    KisPaintDeviceSP dev = createDevice(imageRect);
+
+    const int oldMaxThreadCount = QThreadPool::globalInstance()->maxThreadCount();
+    QThreadPool::globalInstance()->setMaxThreadCount(numThreads);
+
+    QBENCHMARK {
+        if (striped) {
+            KisStripedMirrorProcessingVisitor::mirrorDevice(dev, 0.5 * imageRect.width(), Qt::Horizontal);
+        } else {
+            KisTransformWorker::mirror(dev, 0.5 * imageRect.width(), Qt::Horizontal);
+        }
+    }
+
+    QThreadPool::globalInstance()->setMaxThreadCount(oldMaxThreadCount);
+}
+
+QTEST_MAIN(KisMirrorBenchmark)
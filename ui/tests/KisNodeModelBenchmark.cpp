@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisNodeModelBenchmark.h"
+
+#include <QTest>
+
+#include <KoColorSpaceRegistry.h>
+
+#include "KisDocument.h"
+#include "KisPart.h"
+#include "kis_image.h"
+#include "kis_paint_layer.h"
+#include "kis_selection_mask.h"
+#include "kis_node_model.h"
+#include "kis_name_server.h"
+#include "flake/kis_shape_controller.h"
+
+static const int numLayers = 5000;
+
+
+void KisNodeModelBenchmark::init()
+{
+    m_doc = KisPart::instance()->createDocument();
+
+    m_nameServer = new KisNameServer();
+    m_shapeController = new KisShapeController(m_doc, m_nameServer);
+    m_nodeModel = new KisNodeModel(0);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    m_image = new KisImage(0, 64, 64, cs, "benchmark image");
+
+    for (int i = 0; i < numLayers; i++) {
+        KisNodeSP layer = new KisPaintLayer(m_image, QString("layer %1").arg(i), OPACITY_OPAQUE_U8);
+        m_image->addNode(layer, m_image->root(), m_image->root()->lastChild());
+        m_layers.append(layer);
+    }
+
+    m_image->addNode(new KisSelectionMask(m_image), m_image->root(), m_image->root()->lastChild());
+
+    m_shapeController->setImage(m_image);
+    m_nodeModel->setDummiesFacade(m_shapeController, m_image, 0, 0, 0);
+
+    QCOMPARE(m_nodeModel->rowCount(QModelIndex()), numLayers);
+}
+
+void KisNodeModelBenchmark::cleanup()
+{
+    m_layers.clear();
+
+    delete m_nodeModel;
+    delete m_shapeController;
+    delete m_nameServer;
+    delete m_doc;
+
+    m_image.clear();
+}
+
+void KisNodeModelBenchmark::benchmarkIndexEveryRow()
+{
+    QBENCHMARK {
+        const int rowCount = m_nodeModel->rowCount(QModelIndex());
+
+        for (int row = 0; row < rowCount; row++) {
+            QModelIndex index = m_nodeModel->index(row, 0, QModelIndex());
+            QCOMPARE(m_nodeModel->index(index.row(), 0, m_nodeModel->parent(index)), index);
+        }
+    }
+}
+
+void KisNodeModelBenchmark::benchmarkIndexFromNode()
+{
+    QBENCHMARK {
+        Q_FOREACH (KisNodeSP layer, m_layers) {
+            QVERIFY(m_nodeModel->indexFromNode(layer).isValid());
+        }
+    }
+}
+
+void KisNodeModelBenchmark::benchmarkAddRemoveTopLayer()
+{
+    QBENCHMARK {
+        for (int i = 0; i < 100; i++) {
+            KisNodeSP layer = new KisPaintLayer(m_image, "top layer", OPACITY_OPAQUE_U8);
+            m_image->addNode(layer, m_image->root(), m_image->root()->lastChild());
+            QCOMPARE(m_nodeModel->indexFromNode(layer).row(), 0);
+            m_image->removeNode(layer);
+        }
+    }
+}
+
+void KisNodeModelBenchmark::benchmarkMoveBottomLayer()
+{
+    KisNodeSP bottomLayer = m_layers.first();
+
+    QBENCHMARK {
+        for (int i = 0; i < 100; i++) {
+            m_image->moveNode(bottomLayer, m_image->root(), m_image->root()->lastChild());
+            QCOMPARE(m_nodeModel->indexFromNode(bottomLayer).row(), 0);
+            m_image->moveNode(bottomLayer, m_image->root(), KisNodeSP());
+            QCOMPARE(m_nodeModel->indexFromNode(bottomLayer).row(), numLayers - 1);
+        }
+    }
+}
+
+QTEST_MAIN(KisNodeModelBenchmark)
@@ -0,0 +1,56 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __KIS_NODE_MODEL_BENCHMARK_H
+#define __KIS_NODE_MODEL_BENCHMARK_H
+
+#include <QtTest>
+
+#include <kis_types.h>
+
+class KisDocument;
+class KisNameServer;
+class KisShapeController;
+class KisNodeModel;
+
+/**
+ * Measures the row/index mapping of KisNodeModel on a stack of 5000
+ * layers with a global selection mask, which is hidden from the model.
+ */
+class KisNodeModelBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void benchmarkIndexEveryRow();
+    void benchmarkIndexFromNode();
+    void benchmarkAddRemoveTopLayer();
+    void benchmarkMoveBottomLayer();
+
+private:
+    KisDocument *m_doc;
+    KisNameServer *m_nameServer;
+    KisShapeController *m_shapeController;
+    KisNodeModel *m_nodeModel;
+    KisImageSP m_image;
+    QList<KisNodeSP> m_layers;
+};
+
+#endif /* __KIS_NODE_MODEL_BENCHMARK_H */
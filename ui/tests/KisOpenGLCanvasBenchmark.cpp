@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisOpenGLCanvasBenchmark.h"
+
+#include <QTest>
+#include <QPointer>
+#include <QOpenGLWidget>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
+#include <KoColor.h>
+#include <KoColorSpaceRegistry.h>
+
+#include "kis_config.h"
+#include "KisMainWindow.h"
+#include "KisDocument.h"
+#include "KisPart.h"
+#include "KisView.h"
+#include "kis_canvas2.h"
+#include "kis_image.h"
+#include "kis_paint_layer.h"
+#include "kis_paint_device.h"
+
+
+void KisOpenGLCanvasBenchmark::testRepaint_data()
+{
+    QTest::addColumn<QSize>("viewportSize");
+    QTest::addColumn<bool>("partial");
+
+    QTest::newRow("hd-full") << QSize(1920, 1080) << false;
+    QTest::newRow("hd-dab") << QSize(1920, 1080) << true;
+    QTest::newRow("4k-full") << QSize(3840, 2160) << false;
+    QTest::newRow("4k-dab") << QSize(3840, 2160) << true;
+}
+
+void KisOpenGLCanvasBenchmark::testRepaint()
+{
+    QFETCH(QSize, viewportSize);
+    QFETCH(bool, partial);
+
+    KisConfig cfg;
+    const bool oldUseOpenGL = cfg.useOpenGL();
+    cfg.setUseOpenGL(true);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, 8192, 8192, cs, "canvas benchmark");
+
+    KisPaintLayerSP layer = new KisPaintLayer(image, "paint1", OPACITY_OPAQUE_U8);
+    layer->paintDevice()->fill(image->bounds(), KoColor(Qt::red, cs));
+    image->addNode(layer);
+    image->initialRefreshGraph();
+
+    KisDocument *doc = KisPart::instance()->createDocument();
+    doc->setCurrentImage(image);
+
+    KisMainWindow *mainWindow = KisPart::instance()->createMainWindow();
+    QPointer<KisView> view = new KisView(doc, mainWindow->resourceManager(), mainWindow->actionCollection(), mainWindow);
+    mainWindow->show();
+    QApplication::processEvents();
+
+    QOpenGLWidget *glWidget = dynamic_cast<QOpenGLWidget*>(view->canvasBase()->canvasWidget());
+
+    if (glWidget) {
+        glWidget->resize(viewportSize);
+
+        // the size of a typical dab of a brush
+        const QRect dabRect(QPoint(viewportSize.width() / 2, viewportSize.height() / 2), QSize(20, 20));
+
+        // the first frame initializes the textures
+        glWidget->repaint();
+
+        QBENCHMARK {
+            if (partial) {
+                glWidget->repaint(dabRect);
+            } else {
+                glWidget->repaint();
+            }
+
+            glWidget->makeCurrent();
+            glWidget->context()->functions()->glFinish();
+            glWidget->doneCurrent();
+        }
+    }
+
+    image->waitForDone();
+    QApplication::processEvents();
+
+    delete mainWindow;
+    delete doc;
+
+    cfg.setUseOpenGL(oldUseOpenGL);
+
+    if (!glWidget) {
+        QSKIP("Cannot create the openGL canvas");
+    }
+}
+
+QTEST_MAIN(KisOpenGLCanvasBenchmark)
@@ -0,0 +1,42 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KISOPENGLCANVASBENCHMARK_H
+#define KISOPENGLCANVASBENCHMARK_H
+
+#include <QtTest>
+
+/**
+ * Measures the frame time of the openGL canvas when the whole canvas
+ * is repainted and when only the area of a small dab is, at HD and 4K
+ * viewport sizes.
+ *
+ * The benchmark needs an openGL context, but can be run on a machine
+ * without GPU using Mesa's llvmpipe:
+ *
+ *     LIBGL_ALWAYS_SOFTWARE=1 ./KisOpenGLCanvasBenchmark
+ */
+class KisOpenGLCanvasBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testRepaint_data();
+    void testRepaint();
+};
+
+#endif // KISOPENGLCANVASBENCHMARK_H
@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisPngConverterTest.h"
+
+#include <QTest>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+
+#include "KisDocument.h"
+#include "KisPart.h"
+#include "kis_image.h"
+#include "kis_png_converter.h"
+
+
+namespace {
+
+QByteArray loadSampleData()
+{
+    QFile file(QString(FILES_DATA_DIR) + QDir::separator() + "hakonepa.png");
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+
+    return file.readAll();
+}
+
+}
+
+void KisPngConverterTest::testLoadImage()
+{
+    QByteArray data = loadSampleData();
+    QVERIFY(!data.isEmpty());
+
+    QScopedPointer<KisDocument> doc(KisPart::instance()->createDocument());
+    KisPNGConverter converter(doc.data(), true);
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    QCOMPARE(converter.buildImage(&buffer), KisImageBuilder_RESULT_OK);
+    QVERIFY(converter.image());
+    QCOMPARE(converter.image()->bounds(), QImage::fromData(data).rect());
+}
+
+void KisPngConverterTest::testLoadTruncatedImage_data()
+{
+    QTest::addColumn<qreal>("portion");
+
+    // the file is cut in the first stripe, in the middle and
+    // right before the end chunk
+    QTest::newRow("start") << 0.05;
+    QTest::newRow("middle") << 0.5;
+    QTest::newRow("end") << 0.99;
+}
+
+void KisPngConverterTest::testLoadTruncatedImage()
+{
+    QFETCH(qreal, portion);
+
+    QByteArray data = loadSampleData();
+    QVERIFY(!data.isEmpty());
+
+    data.truncate(qRound(data.size() * portion));
+
+    QScopedPointer<KisDocument> doc(KisPart::instance()->createDocument());
+    KisPNGConverter converter(doc.data(), true);
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    // libpng fails in the middle of the image data, the error
+    // should be reported without crashing in the stripe worker
+    QCOMPARE(converter.buildImage(&buffer), KisImageBuilder_RESULT_FAILURE);
+}
+
+QTEST_MAIN(KisPngConverterTest)
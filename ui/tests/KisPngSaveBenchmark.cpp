@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisPngSaveBenchmark.h"
+
+#include <QTest>
+#include <QBuffer>
+#include <QDir>
+
+#include <KoStore.h>
+#include <KoColorSpaceRegistry.h>
+
+#include "kis_paint_device.h"
+#include "kis_painter.h"
+#include "kis_png_converter.h"
+
+
+void KisPngSaveBenchmark::testSaveMergedImage_data()
+{
+    QTest::addColumn<bool>("fastCompression");
+    QTest::addColumn<bool>("inBackground");
+
+    QTest::newRow("default") << false << false;
+    QTest::newRow("fast") << true << false;
+    QTest::newRow("fast-background") << true << true;
+}
+
+void KisPngSaveBenchmark::testSaveMergedImage()
+{
+    QFETCH(bool, fastCompression);
+    QFETCH(bool, inBackground);
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+
+    QImage sample(QString(FILES_DATA_DIR) + QDir::separator() + "hakonepa.png");
+    QVERIFY(!sample.isNull());
+
+    KisPaintDeviceSP sampleDevice = new KisPaintDevice(cs);
+    sampleDevice->convertFromQImage(sample, 0);
+
+    // tile the sample photo to get a realistic 4k merged image
+    const QRect imageRect(0, 0, 4096, 4096);
+    KisPaintDeviceSP dev = new KisPaintDevice(cs);
+    KisPainter gc(dev);
+    for (int y = 0; y < imageRect.height(); y += sample.height()) {
+        for (int x = 0; x < imageRect.width(); x += sample.width()) {
+            gc.bitBlt(QPoint(x, y), sampleDevice, sample.rect());
+        }
+    }
+    gc.end();
+
+    qint64 storeSize = 0;
+
+    QBENCHMARK {
+        QByteArray data;
+        QBuffer buffer(&data);
+
+        QScopedPointer<KoStore> store(KoStore::createStore(&buffer, KoStore::Write, "application/x-krita", KoStore::Zip));
+
+        if (inBackground) {
+            QFuture<QByteArray> future =
+                KisPNGConverter::encodeDeviceInBackground(imageRect, 1.0, 1.0, dev, fastCompression);
+            QVERIFY(KisPNGConverter::saveEncodedDataToStore("mergedimage.png", future.result(), store.data()));
+        } else {
+            QVERIFY(KisPNGConverter::saveDeviceToStore("mergedimage.png", imageRect, 1.0, 1.0, dev, store.data(), 0, fastCompression));
+        }
+
+        QVERIFY(store->finalize());
+        storeSize = data.size();
+    }
+
+    qDebug() << "Store size:" << storeSize;
+}
+
+QTEST_MAIN(KisPngSaveBenchmark)
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "KisTextureUploadBenchmark.h"
+
+#include <QTest>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+
+#include <KoColor.h>
+#include <KoColorSpaceRegistry.h>
+
+#include "kis_image.h"
+#include "kis_paint_layer.h"
+#include "kis_paint_device.h"
+#include "kis_update_info.h"
+#include "opengl/kis_opengl_image_textures.h"
+
+
+void KisTextureUploadBenchmark::testUpload_data()
+{
+    QTest::addColumn<bool>("useBuffer");
+    QTest::addColumn<QRect>("updateRect");
+
+    QTest::newRow("client-dab") << false << QRect(1000, 1000, 20, 20);
+    QTest::newRow("pbo-dab") << true << QRect(1000, 1000, 20, 20);
+    QTest::newRow("client-stroke") << false << QRect(500, 500, 1500, 300);
+    QTest::newRow("pbo-stroke") << true << QRect(500, 500, 1500, 300);
+    QTest::newRow("client-full") << false << QRect(0, 0, 4096, 4096);
+    QTest::newRow("pbo-full") << true << QRect(0, 0, 4096, 4096);
+}
+
+void KisTextureUploadBenchmark::testUpload()
+{
+    QFETCH(bool, useBuffer);
+    QFETCH(QRect, updateRect);
+
+    QOffscreenSurface surface;
+    surface.create();
+
+    QOpenGLContext context;
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        QSKIP("Cannot create an openGL context");
+    }
+
+    const KoColorSpace *cs = KoColorSpaceRegistry::instance()->rgb8();
+    KisImageSP image = new KisImage(0, 4096, 4096, cs, "upload benchmark");
+
+    KisPaintLayerSP layer = new KisPaintLayer(image, "paint1", OPACITY_OPAQUE_U8);
+    layer->paintDevice()->fill(image->bounds(), KoColor(Qt::red, cs));
+    image->addNode(layer);
+    image->refreshGraphAsync();
+    image->waitForDone();
+
+    KisOpenGLImageTexturesSP textures =
+        KisOpenGLImageTextures::getImageTextures(image, 0,
+                                                 KoColorConversionTransformation::internalRenderingIntent(),
+                                                 KoColorConversionTransformation::internalConversionFlags());
+    textures->initGL(context.functions());
+    textures->updateConfig(useBuffer, 4);
+
+    // the color conversion happens in updateCache(), so it is done only
+    // once outside the measured loop to time the upload alone
+    KisOpenGLUpdateInfoSP info = textures->updateCache(updateRect, image);
+
+    // create the texture tiles before measuring
+    textures->recalculateCache(info);
+    context.functions()->glFinish();
+
+    QBENCHMARK {
+        textures->recalculateCache(info);
+        context.functions()->glFinish();
+    }
+
+    textures = 0;
+    context.doneCurrent();
+}
+
+QTEST_MAIN(KisTextureUploadBenchmark)
@@ -0,0 +1,43 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KISTEXTUREUPLOADBENCHMARK_H
+#define KISTEXTUREUPLOADBENCHMARK_H
+
+#include <QtTest>
+
+/**
+ * Measures the time of uploading the image projection into the openGL
+ * textures, either directly from the client memory or through the
+ * ring of pixel unpack buffers. The update info (and its color
+ * conversion) is prepared once, so only the upload itself is timed.
+ *
+ * The benchmark creates an offscreen context, so it can be run on a
+ * machine without GPU using Mesa's llvmpipe:
+ *
+ *     QT_QPA_PLATFORM=offscreen LIBGL_ALWAYS_SOFTWARE=1 ./KisTextureUploadBenchmark
+ */
+class KisTextureUploadBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testUpload_data();
+    void testUpload();
+};
+
+#endif // KISTEXTUREUPLOADBENCHMARK_H
@@ -77,4 +77,47 @@ void KisAnimationImporterTest::testImport()
     delete document;
 }
 
+void KisAnimationImporterTest::testImportDuplicatedFrames()
+{
+    KisDocument *document = KisPart::instance()->createDocument();
+    TestUtil::MaskParent mp(QRect(0,0,512,512));
+    document->setCurrentImage(mp.image);
+
+    KisAnimationImporter importer(document->image());
+
+    const QString carrotFile = QString(FILES_DATA_DIR) + QDir::separator() + "carrot.png";
+    const QString hakonepaFile = QString(FILES_DATA_DIR) + QDir::separator() + "hakonepa.png";
+
+    QStringList files;
+    files.append(carrotFile);
+    files.append(carrotFile);
+    files.append(hakonepaFile);
+    files.append(carrotFile);
+
+    importer.import(files, 1, 1);
+
+    KisNodeSP importedLayer = mp.image->rootLayer()->lastChild();
+    KisKeyframeChannel* contentChannel = importedLayer->getKeyframeChannel(KisKeyframeChannel::Content.id());
+
+    QVERIFY(contentChannel != 0);
+    QCOMPARE(contentChannel->keyframeCount(), 5); // Four imported ones + blank at time 0
+
+    QImage source1(carrotFile);
+    QImage source2(hakonepaFile);
+    QList<QImage> expected = QList<QImage>() << source1 << source1 << source2 << source1;
+
+    for (int i = 0; i < expected.size(); i++) {
+        QVERIFY(!contentChannel->keyframeAt(i + 1).isNull());
+
+        mp.image->animationInterface()->switchCurrentTimeAsync(i + 1);
+        mp.image->waitForDone();
+        QImage imported = importedLayer->projection()->convertToQImage(importedLayer->colorSpace()->profile());
+
+        QPoint pt;
+        QVERIFY(TestUtil::compareQImages(pt, expected[i], imported));
+    }
+
+    delete document;
+}
+
 QTEST_MAIN(KisAnimationImporterTest)
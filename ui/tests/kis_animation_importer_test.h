@@ -26,6 +26,7 @@ class KisAnimationImporterTest : public QObject {
 
 private Q_SLOTS:
     void testImport();
+    void testImportDuplicatedFrames();
 };
 
 #endif
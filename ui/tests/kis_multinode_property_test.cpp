@@ -22,8 +22,11 @@
 #include "testutil.h"
 
 #include <KoCompositeOpRegistry.h>
+#include <KoColor.h>
 
 #include "kis_multinode_property.h"
+#include "kis_group_layer.h"
+#include "kis_paint_device.h"
 
 
 void KisMultinodePropertyTest::test()
@@ -161,4 +164,102 @@ void KisMultinodePropertyTest::test()
     }
 }
 
+void KisMultinodePropertyTest::testBatchCommand()
+{
+    TestUtil::MaskParent p;
+
+    KisPaintLayerSP layer1 = p.layer;
+    KisPaintLayerSP layer2 = new KisPaintLayer(p.image, "paint2", OPACITY_OPAQUE_U8);
+    KisPaintLayerSP layer3 = new KisPaintLayer(p.image, "paint3", OPACITY_OPAQUE_U8);
+
+    KisNodeList nodes;
+    nodes << layer1;
+    nodes << layer2;
+    nodes << layer3;
+
+    QSharedPointer<KisMultinodeCompositeOpProperty> compositeOpProp(new KisMultinodeCompositeOpProperty(nodes));
+    QSharedPointer<KisMultinodeOpacityProperty> opacityProp(new KisMultinodeOpacityProperty(nodes));
+    QSharedPointer<KisMultinodeNameProperty> nameProp(new KisMultinodeNameProperty(nodes));
+
+    compositeOpProp->setValue(COMPOSITE_ALPHA_DARKEN);
+    opacityProp->setValue(50);
+
+    QCOMPARE(nameProp->isIgnored(), true);
+
+    QScopedPointer<KisMultinodePropertyBatchCommand> cmd(new KisMultinodePropertyBatchCommand(nodes));
+    cmd->addProperty(compositeOpProp);
+    cmd->addProperty(opacityProp);
+    cmd->addProperty(nameProp);
+
+    cmd->undo();
+
+    Q_FOREACH (KisNodeSP node, nodes) {
+        QCOMPARE(node->compositeOpId(), COMPOSITE_OVER);
+        QCOMPARE(node->opacity(), OPACITY_OPAQUE_U8);
+    }
+
+    QCOMPARE(layer2->name(), QString("paint2"));
+
+    cmd->redo();
+
+    Q_FOREACH (KisNodeSP node, nodes) {
+        QCOMPARE(node->compositeOpId(), COMPOSITE_ALPHA_DARKEN);
+        QCOMPARE(node->opacity(), quint8(qRound(50 * 255.0 / 100)));
+    }
+
+    QCOMPARE(layer2->name(), QString("paint2"));
+}
+
+void KisMultinodePropertyTest::testBatchCommandUpdatesGroup()
+{
+    QRect refRect(0,0,100,100);
+    TestUtil::MaskParent p(refRect);
+
+    KisGroupLayerSP group = new KisGroupLayer(p.image, "group", OPACITY_OPAQUE_U8);
+    KisPaintLayerSP layer2 = new KisPaintLayer(p.image, "paint2", OPACITY_OPAQUE_U8);
+    KisPaintLayerSP layer3 = new KisPaintLayer(p.image, "paint3", OPACITY_OPAQUE_U8);
+
+    const KoColorSpace *cs = layer2->paintDevice()->colorSpace();
+    layer2->paintDevice()->fill(QRect(10,10,50,50), KoColor(Qt::red, cs));
+    layer3->paintDevice()->fill(QRect(30,30,50,50), KoColor(Qt::blue, cs));
+
+    p.image->addNode(group, p.image->root());
+    p.image->addNode(layer2, group);
+    p.image->addNode(layer3, group);
+
+    p.image->initialRefreshGraph();
+
+    const QImage initial = p.image->projection()->convertToQImage(0, refRect);
+
+    KisNodeList nodes;
+    nodes << layer2;
+    nodes << layer3;
+
+    QSharedPointer<KisMultinodeOpacityProperty> opacityProp(new KisMultinodeOpacityProperty(nodes));
+    opacityProp->setValue(50);
+
+    QScopedPointer<KisMultinodePropertyBatchCommand> cmd(new KisMultinodePropertyBatchCommand(nodes));
+    cmd->addProperty(opacityProp);
+
+    cmd->redo();
+    p.image->waitForDone();
+
+    const QImage batched = p.image->projection()->convertToQImage(0, refRect);
+
+    p.image->refreshGraph();
+    p.image->waitForDone();
+
+    const QImage reference = p.image->projection()->convertToQImage(0, refRect);
+
+    QPoint pt;
+    QVERIFY(TestUtil::compareQImages(pt, reference, batched));
+    QVERIFY(!TestUtil::compareQImages(pt, initial, batched));
+
+    cmd->undo();
+    p.image->waitForDone();
+
+    const QImage undone = p.image->projection()->convertToQImage(0, refRect);
+    QVERIFY(TestUtil::compareQImages(pt, initial, undone));
+}
+
 QTEST_MAIN(KisMultinodePropertyTest)
@@ -26,6 +26,8 @@ class KisMultinodePropertyTest : public QObject
     Q_OBJECT
 private Q_SLOTS:
     void test();
+    void testBatchCommand();
+    void testBatchCommandUpdatesGroup();
 };
 
 #endif /* __KIS_MULTINODE_PROPERTY_TEST_H */
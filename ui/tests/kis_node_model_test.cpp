@@ -27,6 +27,8 @@
 #include "kis_node_model.h"
 #include "kis_name_server.h"
 #include "flake/kis_shape_controller.h"
+#include "kis_group_layer.h"
+#include "kis_paint_layer.h"
 
 
 #include "modeltest.h"
@@ -109,6 +111,43 @@ void KisNodeModelTest::testSubstituteRootNode()
     m_image->flatten();
 }
 
+void KisNodeModelTest::testCoalescedDataChanged()
+{
+    constructImage();
+    m_shapeController->setImage(m_image);
+    m_nodeModel->setDummiesFacade(m_shapeController, m_image, 0, 0, 0);
+
+    KisGroupLayerSP group = new KisGroupLayer(m_image, "group", OPACITY_OPAQUE_U8);
+    m_image->addNode(group);
+
+    const int numChildren = 10;
+    for (int i = 0; i < numChildren; i++) {
+        m_image->addNode(new KisPaintLayer(m_image, QString("child %1").arg(i), OPACITY_OPAQUE_U8), group);
+    }
+
+    const QModelIndex groupIndex = m_nodeModel->indexFromNode(group);
+    QVERIFY(groupIndex.isValid());
+    QCOMPARE(m_nodeModel->rowCount(groupIndex), numChildren);
+
+    QSignalSpy spy(m_nodeModel, SIGNAL(dataChanged(QModelIndex,QModelIndex,QVector<int>)));
+
+    KisBaseNode::PropertyList props = group->sectionModelProperties();
+    QVERIFY(m_nodeModel->setData(groupIndex, QVariant::fromValue(props), KisNodeModel::PropertiesRole));
+
+    // one signal for the group itself and one for the range of its children
+    QCOMPARE(spy.count(), 2);
+
+    QList<QVariant> groupSignal = spy.takeFirst();
+    QCOMPARE(groupSignal[0].toModelIndex(), groupIndex);
+    QCOMPARE(groupSignal[1].toModelIndex(), groupIndex);
+    QVERIFY(groupSignal[2].value<QVector<int>>().isEmpty());
+
+    QList<QVariant> childrenSignal = spy.takeFirst();
+    QCOMPARE(childrenSignal[0].toModelIndex(), m_nodeModel->index(0, 0, groupIndex));
+    QCOMPARE(childrenSignal[1].toModelIndex(), m_nodeModel->index(numChildren - 1, 0, groupIndex));
+    QVERIFY(childrenSignal[2].value<QVector<int>>().contains(KisNodeModel::ShouldGrayOutRole));
+}
+
 QTEST_MAIN(KisNodeModelTest)
 
 
@@ -42,6 +42,7 @@ private Q_SLOTS:
     void testRemoveAllNodes();
     void testRemoveIncludingRoot();
     void testSubstituteRootNode();
+    void testCoalescedDataChanged();
 
 private:
     KisDocument *m_doc;
@@ -28,6 +28,7 @@
 #include <QStyleOptionViewItem>
 #include <QSortFilterProxyModel>
 #include <QApplication>
+#include <QScrollBar>
 
 #include <kis_config.h>
 #include <klocalizedstring.h>
@@ -47,6 +48,7 @@
 #include "kis_slider_spin_box.h"
 #include "kis_config.h"
 #include "kis_config_notifier.h"
+#include "kis_preset_thumbnail_cache.h"
 #include <kis_icon.h>
 
 /// The resource item delegate for rendering the resource preview
@@ -70,11 +72,44 @@ public:
         m_useDirtyPresets = value;
     }
 
+    /// icons are loaded once, reset them when the theme might have changed
+    void resetIcons() {
+        m_dirtyPresetPixmap = QPixmap();
+        m_brokenPresetIcon = QIcon();
+    }
+
+    /// schedules scaling of the thumbnail for a cell that is not visible yet
+    void prefetchThumbnail(const QModelIndex &index, const QRect &cellRect) const;
+
+private:
+    QSize thumbnailSize(const QRect &paintRect) const {
+        return !m_showText ? paintRect.size() : QSize(paintRect.height(), paintRect.height());
+    }
+
+    Qt::AspectRatioMode thumbnailAspectRatioMode() const {
+        return !m_showText ? Qt::IgnoreAspectRatio : Qt::KeepAspectRatio;
+    }
+
 private:
     bool m_showText;
     bool m_useDirtyPresets;
+    mutable QPixmap m_dirtyPresetPixmap;
+    mutable QIcon m_brokenPresetIcon;
 };
 
+void KisPresetDelegate::prefetchThumbnail(const QModelIndex &index, const QRect &cellRect) const
+{
+    if (!index.isValid()) return;
+
+    KisPaintOpPreset* preset = static_cast<KisPaintOpPreset*>(index.internalPointer());
+    if (!preset) return;
+
+    const QRect paintRect = cellRect.adjusted(1, 1, -1, -1);
+    KisPresetThumbnailCache::instance()->prefetch(preset,
+                                                  thumbnailSize(paintRect),
+                                                  thumbnailAspectRatioMode());
+}
+
 void KisPresetDelegate::paint(QPainter * painter, const QStyleOptionViewItem & option, const QModelIndex & index) const
 {
     painter->save();
@@ -92,14 +127,24 @@ void KisPresetDelegate::paint(QPainter * painter, const QStyleOptionViewItem & o
     }
 
     QRect paintRect = option.rect.adjusted(1, 1, -1, -1);
-    if (!m_showText) {
-        painter->drawImage(paintRect.x(), paintRect.y(),
-                           preview.scaled(paintRect.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    const QSize pixSize = thumbnailSize(paintRect);
+
+    const QImage thumbnail =
+        KisPresetThumbnailCache::instance()->thumbnail(preset, pixSize, thumbnailAspectRatioMode());
+
+    if (!thumbnail.isNull()) {
+        painter->drawImage(paintRect.topLeft(), thumbnail);
     } else {
-        QSize pixSize(paintRect.height(), paintRect.height());
-        painter->drawImage(paintRect.x(), paintRect.y(),
-                           preview.scaled(pixSize, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+        /**
+         * The smooth thumbnail is being generated in the background,
+         * meanwhile let the painter scale the preview on the fly. It
+         * is much cheaper, though not so nice looking.
+         */
+        const QSize scaledSize = preview.size().scaled(pixSize, thumbnailAspectRatioMode());
+        painter->drawImage(QRect(paintRect.topLeft(), scaledSize), preview);
+    }
 
+    if (m_showText) {
         // Put an asterisk after the preset if it is dirty. This will help in case the pixmap icon is too small
          QString dirtyPresetIndicator = QString("");
         if (m_useDirtyPresets && preset->isPresetDirty()) {
@@ -123,14 +168,17 @@ void KisPresetDelegate::paint(QPainter * painter, const QStyleOptionViewItem & o
 
     }
     if (m_useDirtyPresets && preset->isPresetDirty()) {
-        const QIcon icon = KisIconUtils::loadIcon(koIconName("dirty-preset"));
-        QPixmap pixmap = icon.pixmap(QSize(15,15));
-        painter->drawPixmap(paintRect.x() + 3, paintRect.y() + 3, pixmap);
+        if (m_dirtyPresetPixmap.isNull()) {
+            m_dirtyPresetPixmap = KisIconUtils::loadIcon(koIconName("dirty-preset")).pixmap(QSize(15,15));
+        }
+        painter->drawPixmap(paintRect.x() + 3, paintRect.y() + 3, m_dirtyPresetPixmap);
     }
 
     if (!preset->settings() || !preset->settings()->isValid()) {
-        const QIcon icon = KisIconUtils::loadIcon("broken-preset");
-        icon.paint(painter, QRect(paintRect.x() + paintRect.height() - 25, paintRect.y() + paintRect.height() - 25, 25, 25));
+        if (m_brokenPresetIcon.isNull()) {
+            m_brokenPresetIcon = KisIconUtils::loadIcon("broken-preset");
+        }
+        m_brokenPresetIcon.paint(painter, QRect(paintRect.x() + paintRect.height() - 25, paintRect.y() + paintRect.height() - 25, 25, 25));
     }
     if (option.state & QStyle::State_Selected) {
         painter->setCompositionMode(QPainter::CompositionMode_HardLight);
@@ -232,6 +280,13 @@ KisPresetChooser::KisPresetChooser(QWidget *parent, const char *name)
     connect(KisConfigNotifier::instance(), SIGNAL(configChanged()),
             SLOT(notifyConfigChanged()));
 
+    connect(KisPresetThumbnailCache::instance(), SIGNAL(sigThumbnailReady()),
+            m_chooser->itemView()->viewport(), SLOT(update()));
+    connect(m_chooser->itemView()->verticalScrollBar(), SIGNAL(valueChanged(int)),
+            SLOT(slotPrefetchThumbnails()));
+    connect(m_chooser->itemView()->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+            SLOT(slotPrefetchThumbnails()));
+
 
     notifyConfigChanged();
 }
@@ -261,6 +316,7 @@ void KisPresetChooser::notifyConfigChanged()
 {
     KisConfig cfg;
     m_delegate->setUseDirtyPresets(cfg.useDirtyPresets());
+    m_delegate->resetIcons();
     setIconSize(cfg.presetIconSize());
 
     updateViewSettings();
@@ -288,6 +344,47 @@ void KisPresetChooser::updateViewSettings()
         m_chooser->setColumnWidth(m_chooser->viewSize().height() - 7);
         m_delegate->setShowText(false);
     }
+
+    slotPrefetchThumbnails();
+}
+
+void KisPresetChooser::slotPrefetchThumbnails()
+{
+    KoResourceItemView *view = m_chooser->itemView();
+    QAbstractItemModel *model = view->model();
+    if (!model || !model->rowCount() || !model->columnCount()) return;
+
+    /**
+     * Prefetch the cells lying within one viewport size before and
+     * after the visible area, so that small scrolls show smooth
+     * thumbnails right away.
+     */
+    const QRect viewportRect = view->viewport()->rect();
+    const QRect prefetchRect =
+        viewportRect.adjusted(-viewportRect.width(), -viewportRect.height(),
+                              viewportRect.width(), viewportRect.height());
+
+    int firstRow = view->rowAt(prefetchRect.top());
+    int lastRow = view->rowAt(prefetchRect.bottom());
+    int firstColumn = view->columnAt(prefetchRect.left());
+    int lastColumn = view->columnAt(prefetchRect.right());
+
+    if (firstRow < 0) firstRow = 0;
+    if (lastRow < 0) lastRow = model->rowCount() - 1;
+    if (firstColumn < 0) firstColumn = 0;
+    if (lastColumn < 0) lastColumn = model->columnCount() - 1;
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            const QModelIndex index = model->index(row, column);
+            const QRect cellRect = view->visualRect(index);
+
+            // visible cells are requested by the delegate itself
+            if (cellRect.isEmpty() || cellRect.intersects(viewportRect)) continue;
+
+            m_delegate->prefetchThumbnail(index, cellRect);
+        }
+    }
 }
 
 void KisPresetChooser::setCurrentResource(KoResource *resource)
@@ -78,6 +78,7 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     void notifyConfigChanged();
+    void slotPrefetchThumbnails();
 
 protected:
     void resizeEvent(QResizeEvent* event) override;
@@ -20,11 +20,76 @@
 #include <kis_preset_live_preview_view.h>
 #include <QDebug>
 #include <QGraphicsPixmapItem>
+#include <QtMath>
 #include "kis_paintop_settings.h"
+#include "kis_paint_device.h"
 #include <strokes/freehand_stroke.h>
 #include <strokes/KisFreehandStrokeInfo.h>
 #include <kis_brush.h>
 
+namespace {
+
+/**
+ * A freehand stroke that resets the preview layer to the background
+ * before painting and notifies the view when the result is ready.
+ * Cancelled strokes notify the view only about their proxy preset
+ * being free, their result is never shown.
+ */
+class LivePreviewStrokeStrategy : public FreehandStrokeStrategy
+{
+public:
+    LivePreviewStrokeStrategy(KisResourcesSnapshotSP resources,
+                              KisPaintDeviceSP device,
+                              KisPaintDeviceSP background,
+                              const QRect &bounds,
+                              KisPresetLivePreviewView *view,
+                              int generation, bool isCoarse,
+                              int proxyPresetId)
+        : FreehandStrokeStrategy(resources, new KisFreehandStrokeInfo(), kundo2_noi18n("temp_stroke")),
+          m_device(device),
+          m_background(background),
+          m_bounds(bounds),
+          m_view(view),
+          m_generation(generation),
+          m_isCoarse(isCoarse),
+          m_proxyPresetId(proxyPresetId)
+    {
+    }
+
+    void initStrokeCallback() override {
+        m_device->clear();
+        KisPainter::copyAreaOptimized(m_bounds.topLeft(), m_background, m_device, m_bounds);
+
+        FreehandStrokeStrategy::initStrokeCallback();
+    }
+
+    void finishStrokeCallback() override {
+        FreehandStrokeStrategy::finishStrokeCallback();
+
+        QMetaObject::invokeMethod(m_view, "slotStrokeFinished", Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation), Q_ARG(bool, m_isCoarse),
+                                  Q_ARG(int, m_proxyPresetId));
+    }
+
+    void cancelStrokeCallback() override {
+        FreehandStrokeStrategy::cancelStrokeCallback();
+
+        QMetaObject::invokeMethod(m_view, "slotStrokeCancelled", Qt::QueuedConnection,
+                                  Q_ARG(int, m_proxyPresetId));
+    }
+
+private:
+    KisPaintDeviceSP m_device;
+    KisPaintDeviceSP m_background;
+    QRect m_bounds;
+    KisPresetLivePreviewView *m_view;
+    int m_generation;
+    bool m_isCoarse;
+    int m_proxyPresetId;
+};
+
+}
+
 KisPresetLivePreviewView::KisPresetLivePreviewView(QWidget *parent): QGraphicsView(parent)
 {
 
@@ -32,6 +97,15 @@ KisPresetLivePreviewView::KisPresetLivePreviewView(QWidget *parent): QGraphicsVi
 
 KisPresetLivePreviewView::~KisPresetLivePreviewView()
 {
+    if (m_image) {
+        // the strokes keep a pointer to us, so wait until they are gone
+        cancelPreviewStrokes();
+        m_image->waitForDone();
+
+        // no stroke uses the proxy presets anymore
+        restoreProxyPresets(m_nextProxyPresetId - 1);
+    }
+
     delete m_noPreviewText;
     delete m_brushPreviewScene;
 }
@@ -58,6 +132,7 @@ void KisPresetLivePreviewView::setup()
 
 
     m_layer = new KisPaintLayer(m_image, "livePreviewStrokeSample", OPACITY_OPAQUE_U8, m_colorSpace);
+    m_coarseLayer = new KisPaintLayer(m_image, "livePreviewCoarseStrokeSample", OPACITY_OPAQUE_U8, m_colorSpace);
 
     // set scene for the view
     m_brushPreviewScene = new QGraphicsScene();
@@ -72,6 +147,10 @@ void KisPresetLivePreviewView::setCurrentPreset(KisPaintOpPresetSP preset)
 
 void KisPresetLivePreviewView::updateStroke()
 {
+    // the stroke for the previous settings is not needed anymore
+    cancelPreviewStrokes();
+    m_strokeGeneration++;
+
     paintBackground();
 
     // do not paint a stroke if we are any of these engines (they have some issue currently)
@@ -83,13 +162,28 @@ void KisPresetLivePreviewView::updateStroke()
     }
 
     setupAndPaintStroke();
+}
+
+void KisPresetLivePreviewView::slotStrokeFinished(int generation, bool isCoarse, int proxyPresetId)
+{
+    restoreProxyPresets(proxyPresetId);
 
+    if (generation != m_strokeGeneration) return;
+
+    if (isCoarse) {
+        m_coarseStrokeId.clear();
+    } else {
+        m_strokeId.clear();
+        m_lastStrokeTime = m_strokeTimer.elapsed();
+    }
 
-    // crop the layer so a brush stroke won't go outside of the area
-    m_layer->paintDevice()->crop(0,0, m_layer->image()->width(), m_layer->image()->height());
+    const qreal scale = isCoarse ? m_coarseScale : 1.0;
+    KisLayerSP layer = isCoarse ? m_coarseLayer : m_layer;
 
+    // read only the area of the image so a brush stroke won't go outside of it
+    const QRect bounds = previewBounds(scale);
     QImage m_temp_image;
-    m_temp_image = m_layer->paintDevice()->convertToQImage(0);
+    m_temp_image = layer->paintDevice()->convertToQImage(0, bounds.x(), bounds.y(), bounds.width(), bounds.height());
 
 
     // only add the object once...then just update the pixmap so we can move the preview around
@@ -99,9 +193,63 @@ void KisPresetLivePreviewView::updateStroke()
         m_sceneImageItem->setPixmap(QPixmap::fromImage(m_temp_image));
     }
 
+    // the coarse stroke is stretched to the size of the view
+    m_sceneImageItem->setTransformationMode(isCoarse ? Qt::FastTransformation : Qt::SmoothTransformation);
+    m_sceneImageItem->setScale(1.0 / scale);
 }
 
+void KisPresetLivePreviewView::slotStrokeCancelled(int proxyPresetId)
+{
+    restoreProxyPresets(proxyPresetId);
+}
+
+QRect KisPresetLivePreviewView::previewBounds(qreal scale) const
+{
+    return QRect(0, 0,
+                 qCeil(m_image->width() * scale),
+                 qCeil(m_image->height() * scale));
+}
+
+void KisPresetLivePreviewView::cancelPreviewStrokes()
+{
+    /**
+     * A cancelled stroke may still be running for a while, so its
+     * resources snapshot cannot be reused for the next stroke
+     */
+    if (m_coarseStrokeId) {
+        m_image->cancelStroke(m_coarseStrokeId);
+        m_coarseStrokeId.clear();
+        m_coarseResources = 0;
+    }
+
+    if (m_strokeId) {
+        m_image->cancelStroke(m_strokeId);
+        m_strokeId.clear();
+        m_resources = 0;
+    }
+}
+
+void KisPresetLivePreviewView::restoreProxyPresets(int lastProxyPresetId)
+{
+    /**
+     * The strokes are executed in the order they were started, so
+     * the strokes with the lower ids are gone as well. Some of them
+     * might have been cancelled before they even started, in which
+     * case they never report back.
+     */
 
+    // even though the brush is cloned, the proxy_preset still has some connection to the original preset which will mess brush sizing
+    // we need to return brush size to normal.The normal brush sends out a lot of extra signals, so keeping the proxy for now
+    auto it = m_proxyPresets.begin();
+    while (it != m_proxyPresets.end()) {
+        if (it.key() <= lastProxyPresetId) {
+            it.value().first->settings()->setPaintOpSize(it.value().second);
+            it = m_proxyPresets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
 
 void KisPresetLivePreviewView::paintBackground()
 {
@@ -111,36 +259,16 @@ void KisPresetLivePreviewView::paintBackground()
         m_noPreviewText = 0;
     }
 
+    bool stripedBackground = false;
+    QColor backgroundColor;
 
     if (m_currentPreset->paintOp().id() == "colorsmudge" ||
         m_currentPreset->paintOp().id() == "deformbrush" ||
         m_currentPreset->paintOp().id() == "filter") {
 
         // easier to see deformations and smudging with alternating stripes in the background
-        // paint the whole background with alternating stripes
         // filter engine may or may not show things depending on the filter...but it is better than nothing
-
-        int grayStrips = 20;
-        for (int i=0; i < grayStrips; i++ ) {
-
-            float sectionPercent = 1.0 / (float)grayStrips;
-            bool isAlternating = i % 2;
-            KoColor fillColor(m_layer->paintDevice()->colorSpace());
-
-            if (isAlternating) {
-                fillColor.fromQColor(QColor(80,80,80));
-            } else {
-                fillColor.fromQColor(QColor(140,140,140));
-            }
-
-
-            const QRect fillRect(m_layer->image()->width()*sectionPercent*i,
-                                 0,
-                                 m_layer->image()->width()*(sectionPercent*i +sectionPercent),
-                                 m_layer->image()->height());
-            m_layer->paintDevice()->fill(fillRect, fillColor);
-        }
-
+        stripedBackground = true;
         m_paintColor = KoColor(Qt::white, m_colorSpace);
 
     }
@@ -170,28 +298,89 @@ void KisPresetLivePreviewView::paintBackground()
     else {
 
         // fill with gray first to clear out what existed from previous preview
-        m_layer->paintDevice()->fill(m_image->bounds(), KoColor(palette().color(QPalette::Background) , m_colorSpace));
+        backgroundColor = palette().color(QPalette::Background);
         m_paintColor = KoColor(palette().color(QPalette::Text), m_colorSpace);
     }
+
+    // the backgrounds are copied into the layers by the strokes themselves
+    if (!m_background ||
+        stripedBackground != m_stripedBackground ||
+        backgroundColor != m_backgroundColor) {
+
+        m_stripedBackground = stripedBackground;
+        m_backgroundColor = backgroundColor;
+
+        m_background = new KisPaintDevice(m_colorSpace);
+        fillBackground(m_background, previewBounds(1.0));
+
+        m_coarseBackground = new KisPaintDevice(m_colorSpace);
+        fillBackground(m_coarseBackground, previewBounds(m_coarseScale));
+    }
+}
+
+void KisPresetLivePreviewView::fillBackground(KisPaintDeviceSP device, const QRect &bounds)
+{
+    if (m_stripedBackground) {
+        // paint the whole background with alternating stripes
+        int grayStrips = 20;
+        for (int i=0; i < grayStrips; i++ ) {
+
+            float sectionPercent = 1.0 / (float)grayStrips;
+            bool isAlternating = i % 2;
+            KoColor fillColor(device->colorSpace());
+
+            if (isAlternating) {
+                fillColor.fromQColor(QColor(80,80,80));
+            } else {
+                fillColor.fromQColor(QColor(140,140,140));
+            }
+
+
+            const QRect fillRect(bounds.width()*sectionPercent*i,
+                                 0,
+                                 bounds.width()*(sectionPercent*i +sectionPercent),
+                                 bounds.height());
+            device->fill(fillRect, fillColor);
+        }
+    } else {
+        device->fill(bounds, KoColor(m_backgroundColor, m_colorSpace));
+    }
 }
 
 void KisPresetLivePreviewView::setupAndPaintStroke()
+{
+    m_originalPresetSize = m_currentPreset->settings()->paintOpSize();
+
+    // heavy brushes get a quick half-resolution stroke first, it is
+    // executed before the full one, since strokes never overlap
+    if (m_lastStrokeTime >= m_coarseStrokeThreshold) {
+        m_coarseStrokeId = startPreviewStroke(m_coarseLayer, m_coarseBackground, m_coarseResources,
+                                              m_coarseScale, true);
+    }
+
+    m_strokeTimer.start();
+    m_strokeId = startPreviewStroke(m_layer, m_background, m_resources, 1.0, false);
+}
+
+KisStrokeId KisPresetLivePreviewView::startPreviewStroke(KisLayerSP layer,
+                                                         KisPaintDeviceSP background,
+                                                         KisResourcesSnapshotSP &resources,
+                                                         qreal previewScale, bool isCoarse)
 {
     // limit the brush stroke size. larger brush strokes just don't look good and are CPU intensive
     // we are making a proxy preset and setting it to the painter...otherwise setting the brush size of the original preset
     // will fire off signals that make this run in an infinite loop
-    qreal originalPresetSize = m_currentPreset->settings()->paintOpSize();
-    qreal previewSize = qBound(3.0, m_currentPreset->settings()->paintOpSize(), 25.0 ); // constrain live preview brush size
+    qreal previewSize = qBound(3.0, m_originalPresetSize, 25.0 ); // constrain live preview brush size
     //Except for the sketchbrush where it determine sthe history.
     if (m_currentPreset->paintOp().id() == "sketchbrush" ||
             m_currentPreset->paintOp().id() == "spraybrush") {
-        previewSize = qMax(3.0, m_currentPreset->settings()->paintOpSize());
+        previewSize = qMax(3.0, m_originalPresetSize);
     }
 
 
     KisPaintOpPresetSP proxy_preset = m_currentPreset->clone();
     KisPaintOpSettingsSP settings = proxy_preset->settings();
-    proxy_preset->settings()->setPaintOpSize(previewSize);
+    proxy_preset->settings()->setPaintOpSize(previewSize * previewScale);
     int maxTextureSize = 200;
     int textureOffsetX = settings->getInt("Texture/Pattern/MaximumOffsetX")*2;
     int textureOffsetY = settings->getInt("Texture/Pattern/MaximumOffsetY")*2;
@@ -225,7 +414,7 @@ void KisPresetLivePreviewView::setupAndPaintStroke()
                 scale = 25.0/width;
             }
         }
-        settings->setProperty("Spray/diameter", int(25.0*diameterToBrushRatio));
+        settings->setProperty("Spray/diameter", int(25.0*diameterToBrushRatio*previewScale));
 
         brush->setScale(scale);
         d.clear();
@@ -236,33 +425,39 @@ void KisPresetLivePreviewView::setupAndPaintStroke()
     }
     proxy_preset->setSettings(settings);
 
+    // the size is restored only when the stroke has finished or has been
+    // cancelled, because its jobs may still be using the preset
+    const int proxyPresetId = m_nextProxyPresetId++;
+    m_proxyPresets.insert(proxyPresetId, qMakePair(proxy_preset, m_originalPresetSize));
 
-    KisResourcesSnapshotSP resources =
-        new KisResourcesSnapshot(m_image,
-                                 m_layer);
+
+    // the snapshot is reused while no stroke is using it
+    if (!resources) {
+        resources = new KisResourcesSnapshot(m_image, layer);
+    }
 
     resources->setBrush(proxy_preset);
     resources->setFGColorOverride(m_paintColor);
-    KisFreehandStrokeInfo *strokeInfo = new KisFreehandStrokeInfo();
 
     KisStrokeStrategy *stroke =
-        new FreehandStrokeStrategy(resources, strokeInfo, kundo2_noi18n("temp_stroke"));
+        new LivePreviewStrokeStrategy(resources, layer->paintDevice(), background,
+                                      previewBounds(previewScale), this, m_strokeGeneration, isCoarse,
+                                      proxyPresetId);
 
     KisStrokeId strokeId = m_image->startStroke(stroke);
 
 
-
-    //m_brushPreviewPainter->setPaintOpPreset(proxy_preset, m_layer, m_image);
-
-
+    const QPointF center = m_canvasCenterPoint * previewScale;
+    const qreal width = this->width() * previewScale;
+    const qreal height = this->height() * previewScale;
 
     // paint the stroke. The sketchbrush gets a different shape than the others to show how it works
     if (m_currentPreset->paintOp().id() == "sketchbrush"
          || m_currentPreset->paintOp().id() == "curvebrush"
          || m_currentPreset->paintOp().id() == "particlebrush") {
-        qreal startX = m_canvasCenterPoint.x() - (this->width()*0.4);
-        qreal endX   = m_canvasCenterPoint.x() + (this->width()*0.4);
-        qreal middle = m_canvasCenterPoint.y();
+        qreal startX = center.x() - (width*0.4);
+        qreal endX   = center.x() + (width*0.4);
+        qreal middle = center.y();
         KisPaintInformation pointOne;
         pointOne.setPressure(0.0);
         pointOne.setPos(QPointF(startX, middle));
@@ -279,7 +474,7 @@ void KisPresetLivePreviewView::setupAndPaintStroke()
             qreal xPos = ((1.0/repeats) * (i+1) * (endX-startX) )+startX;
             pointTwo.setPos(QPointF(xPos, middle));
 
-            qreal offset = (this->height()/(repeats*1.5))*(i+1);
+            qreal offset = (height/(repeats*1.5))*(i+1);
             qreal handleY = middle + offset;
             if (i%2 == 0) {
                 handleY = middle - offset;
@@ -299,33 +494,27 @@ void KisPresetLivePreviewView::setupAndPaintStroke()
     } else {
 
         // paint an S curve
-        m_curvePointPI1.setPos(QPointF(m_canvasCenterPoint.x() - (this->width()*0.45),
-                                       m_canvasCenterPoint.y() + (this->height()*0.2)));
+        m_curvePointPI1.setPos(QPointF(center.x() - (width*0.45),
+                                       center.y() + (height*0.2)));
         m_curvePointPI1.setPressure(0.0);
 
 
-        m_curvePointPI2.setPos(QPointF(m_canvasCenterPoint.x() + (this->width()*0.4),
-                                       m_canvasCenterPoint.y() - (this->height()*0.2)   ));
+        m_curvePointPI2.setPos(QPointF(center.x() + (width*0.4),
+                                       center.y() - (height*0.2)   ));
 
         m_curvePointPI2.setPressure(1.0);
 
         m_image->addJob(strokeId,
             new FreehandStrokeStrategy::Data(0,
                                              m_curvePointPI1,
-                                             QPointF(m_canvasCenterPoint.x(),
-                                                     m_canvasCenterPoint.y()-this->height()),
-                                             QPointF(m_canvasCenterPoint.x(),
-                                                     m_canvasCenterPoint.y()+this->height()),
+                                             QPointF(center.x(),
+                                                     center.y()-height),
+                                             QPointF(center.x(),
+                                                     center.y()+height),
                                              m_curvePointPI2));
         m_image->addJob(strokeId, new FreehandStrokeStrategy::UpdateData(true));
     }
     m_image->endStroke(strokeId);
-    m_image->waitForDone();
-
-
-    // even though the brush is cloned, the proxy_preset still has some connection to the original preset which will mess brush sizing
-    // we need to return brush size to normal.The normal brush sends out a lot of extra signals, so keeping the proxy for now
-    proxy_preset->settings()->setPaintOpSize(originalPresetSize);
 
+    return strokeId;
 }
-
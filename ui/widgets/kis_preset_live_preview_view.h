@@ -24,6 +24,9 @@
 #include <QGraphicsView>
 #include <QPainterPath>
 #include <QGraphicsPixmapItem>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
 
 #include "kis_paintop_preset.h"
 #include "KoColorSpaceRegistry.h"
@@ -33,6 +36,7 @@
 #include "kis_painting_information_builder.h"
 #include <kis_image.h>
 #include <kis_types.h>
+#include <kis_resources_snapshot.h>
 #include <KoColor.h>
 
 /**
@@ -41,6 +45,12 @@
  * that the brush preset outputs and updates the preview
  * accordingly. This class can be added to a UI file
  * similar to how a QGraphicsView is added
+ *
+ * The stroke is painted asynchronously. When a new update
+ * arrives while the previous stroke is still being painted,
+ * the old stroke is cancelled. For heavy brushes a coarse
+ * stroke is painted in half resolution first, so the user
+ * gets some feedback while the full stroke is rendered.
  */
 class KisPresetLivePreviewView : public QGraphicsView
 {
@@ -67,6 +77,18 @@ public:
     void setCurrentPreset(KisPaintOpPresetSP preset);
     void updateStroke();
 
+private Q_SLOTS:
+    /**
+     * Called by the preview strokes when they have finished
+     * painting. Results of the outdated strokes are ignored.
+     */
+    void slotStrokeFinished(int generation, bool isCoarse, int proxyPresetId);
+
+    /**
+     * Called by the cancelled preview strokes when all their jobs
+     * are gone, so that their proxy presets can be restored
+     */
+    void slotStrokeCancelled(int proxyPresetId);
 
 private:
 
@@ -76,6 +98,40 @@ private:
     /// internally sets the layer area for brush preview
     KisLayerSP m_layer;
 
+    /// the layer for the coarse stroke, it uses only the top-left
+    /// part of the image scaled with m_coarseScale
+    KisLayerSP m_coarseLayer;
+
+    /// the backgrounds the preview layers are reset to before every stroke.
+    /// They are regenerated only when the type of the background changes
+    KisPaintDeviceSP m_background;
+    KisPaintDeviceSP m_coarseBackground;
+    bool m_stripedBackground = false;
+    QColor m_backgroundColor;
+
+    /// resources snapshots are reused while no stroke is in progress
+    KisResourcesSnapshotSP m_resources;
+    KisResourcesSnapshotSP m_coarseResources;
+
+    /// the strokes being painted at the moment, null if finished
+    KisStrokeId m_strokeId;
+    KisStrokeId m_coarseStrokeId;
+
+    /// incremented on every update, used for dropping results of
+    /// the cancelled strokes
+    int m_strokeGeneration = 0;
+
+    /// the clones of the current preset used by the strokes in progress
+    /// (including the cancelled ones), and the sizes to restore them to
+    QHash<int, QPair<KisPaintOpPresetSP, qreal>> m_proxyPresets;
+    int m_nextProxyPresetId = 0;
+    qreal m_originalPresetSize = 1.0;
+
+    /// measures the time of the full stroke to decide whether
+    /// a coarse stroke is needed at all
+    QElapsedTimer m_strokeTimer;
+    qint64 m_lastStrokeTime = 0;
+
     /// internally sets the color space for brush preview
     const KoColorSpace *m_colorSpace;
 
@@ -132,6 +188,10 @@ private:
     const float m_minStrokeScale = 0.4; // for smaller brush stroke
     const float m_maxStrokeScale = 1.0; // for larger brush stroke
 
+    /// scale of the coarse stroke and the minimum time (in ms) of
+    /// the full stroke for the coarse stroke to be painted
+    const qreal m_coarseScale = 0.5;
+    const qint64 m_coarseStrokeThreshold = 40;
 
     /**
      * @brief works as both clearing the previous stroke, providing
@@ -140,11 +200,42 @@ private:
     void paintBackground();
 
     /**
-     * @brief creates and performs the actual stroke that goes on top of the background
+     * @brief the area of the preview layer for the stroke painted with \p scale
+     */
+    QRect previewBounds(qreal scale) const;
+
+    /**
+     * @brief fills \p device with the background of the preview
+     */
+    void fillBackground(KisPaintDeviceSP device, const QRect &bounds);
+
+    /**
+     * @brief creates and starts the actual stroke that goes on top of the background
      * this is internally and should always be called after the paintBackground()
      */
     void setupAndPaintStroke();
 
+    /**
+     * @brief starts a stroke on \p layer with the preset scaled by \p previewScale
+     */
+    KisStrokeId startPreviewStroke(KisLayerSP layer,
+                                   KisPaintDeviceSP background,
+                                   KisResourcesSnapshotSP &resources,
+                                   qreal previewScale, bool isCoarse);
+
+    /**
+     * @brief cancels the strokes in progress (if any). Their presets
+     * are restored when the strokes report back
+     */
+    void cancelPreviewStrokes();
+
+    /**
+     * @brief returns the size of the proxy presets with ids up to
+     * \p lastProxyPresetId back. Must be called only when the strokes
+     * using these presets are not running anymore
+     */
+    void restoreProxyPresets(int lastProxyPresetId);
+
 };
 
 #endif
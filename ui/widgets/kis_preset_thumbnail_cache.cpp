@@ -0,0 +1,185 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "kis_preset_thumbnail_cache.h"
+
+#include <QCache>
+#include <QHash>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include <brushengine/kis_paintop_preset.h>
+
+
+Q_GLOBAL_STATIC(KisPresetThumbnailCache, s_instance)
+
+namespace {
+
+/**
+ * The maximum memory footprint of the cache in KiB. A 128x128 RGBA
+ * thumbnail takes 64 KiB, so it is enough for about a thousand of
+ * presets at the biggest icon size.
+ */
+const int maxCacheCost = 64 * 1024;
+
+struct ThumbnailEntry {
+    qint64 sourceKey;
+    QImage image;
+};
+
+struct ScaleResult {
+    QByteArray key;
+    qint64 sourceKey;
+    QImage image;
+};
+
+ScaleResult scaleThumbnail(const QByteArray &key, const QImage &source,
+                           const QSize &size, Qt::AspectRatioMode mode)
+{
+    ScaleResult result;
+    result.key = key;
+    result.sourceKey = source.cacheKey();
+    result.image = source.scaled(size, mode, Qt::SmoothTransformation);
+    return result;
+}
+
+QByteArray thumbnailKey(KisPaintOpPreset *preset, const QSize &size, Qt::AspectRatioMode mode)
+{
+    /**
+     * Presets that have never been saved have no md5 yet, so use their
+     * filename instead.
+     */
+    QByteArray key = preset->md5();
+    if (key.isEmpty()) {
+        key = preset->filename().toUtf8();
+    }
+
+    key += QByteArray::number(size.width());
+    key += 'x';
+    key += QByteArray::number(size.height());
+    key += mode == Qt::KeepAspectRatio ? 'k' : 'i';
+
+    return key;
+}
+
+}
+
+struct KisPresetThumbnailCache::Private
+{
+    QCache<QByteArray, ThumbnailEntry> cache;
+
+    /// source keys of the thumbnails being scaled at the moment
+    QHash<QByteArray, qint64> pendingThumbnails;
+
+    const ThumbnailEntry* fetchEntry(const QByteArray &key, const QImage &source) const;
+    bool schedule(KisPresetThumbnailCache *q,
+                  const QByteArray &key, const QImage &source,
+                  const QSize &size, Qt::AspectRatioMode mode);
+};
+
+const ThumbnailEntry* KisPresetThumbnailCache::Private::fetchEntry(const QByteArray &key, const QImage &source) const
+{
+    const ThumbnailEntry *entry = cache.object(key);
+    return entry && entry->sourceKey == source.cacheKey() ? entry : 0;
+}
+
+bool KisPresetThumbnailCache::Private::schedule(KisPresetThumbnailCache *q,
+                                                const QByteArray &key, const QImage &source,
+                                                const QSize &size, Qt::AspectRatioMode mode)
+{
+    auto it = pendingThumbnails.find(key);
+    if (it != pendingThumbnails.end() && it.value() == source.cacheKey()) {
+        return false;
+    }
+
+    pendingThumbnails.insert(key, source.cacheKey());
+
+    QFutureWatcher<ScaleResult> *watcher = new QFutureWatcher<ScaleResult>(q);
+    QObject::connect(watcher, SIGNAL(finished()), q, SLOT(slotThumbnailScaled()));
+    watcher->setFuture(QtConcurrent::run(scaleThumbnail, key, source, size, mode));
+
+    return true;
+}
+
+KisPresetThumbnailCache::KisPresetThumbnailCache()
+    : m_d(new Private)
+{
+    m_d->cache.setMaxCost(maxCacheCost);
+}
+
+KisPresetThumbnailCache::~KisPresetThumbnailCache()
+{
+}
+
+KisPresetThumbnailCache* KisPresetThumbnailCache::instance()
+{
+    return s_instance;
+}
+
+QImage KisPresetThumbnailCache::thumbnail(KisPaintOpPreset *preset, const QSize &size, Qt::AspectRatioMode mode)
+{
+    const QImage source = preset->image();
+    if (source.isNull() || size.isEmpty()) return QImage();
+
+    const QByteArray key = thumbnailKey(preset, size, mode);
+
+    const ThumbnailEntry *entry = m_d->fetchEntry(key, source);
+    if (entry) {
+        return entry->image;
+    }
+
+    m_d->schedule(this, key, source, size, mode);
+    return QImage();
+}
+
+void KisPresetThumbnailCache::prefetch(KisPaintOpPreset *preset, const QSize &size, Qt::AspectRatioMode mode)
+{
+    const QImage source = preset->image();
+    if (source.isNull() || size.isEmpty()) return;
+
+    const QByteArray key = thumbnailKey(preset, size, mode);
+
+    if (!m_d->fetchEntry(key, source)) {
+        m_d->schedule(this, key, source, size, mode);
+    }
+}
+
+void KisPresetThumbnailCache::slotThumbnailScaled()
+{
+    QFutureWatcher<ScaleResult> *watcher =
+        static_cast<QFutureWatcher<ScaleResult>*>(sender());
+
+    const ScaleResult result = watcher->result();
+    watcher->deleteLater();
+
+    /**
+     * The image of the preset might have been changed while we were
+     * scaling it. In such a case a newer job is already pending, so
+     * just drop the result.
+     */
+    auto it = m_d->pendingThumbnails.find(result.key);
+    if (it == m_d->pendingThumbnails.end() || it.value() != result.sourceKey) {
+        return;
+    }
+    m_d->pendingThumbnails.erase(it);
+
+    const int cost = qMax(1, result.image.byteCount() / 1024);
+    m_d->cache.insert(result.key, new ThumbnailEntry({result.sourceKey, result.image}), cost);
+
+    emit sigThumbnailReady();
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __KIS_PRESET_THUMBNAIL_CACHE_H
+#define __KIS_PRESET_THUMBNAIL_CACHE_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QImage>
+#include "kritaui_export.h"
+
+class KisPaintOpPreset;
+
+/**
+ * A cache of preset thumbnails scaled to the size of the cells of
+ * the preset choosers. It is shared by all the choosers, so the same
+ * preset shown in the popup and in the docker is scaled only once.
+ *
+ * The thumbnails are keyed by the md5 of the preset and the target
+ * size. Scaling happens in a worker thread; while a thumbnail is not
+ * ready, thumbnail() returns a null image and the caller is expected to
+ * paint some cheap approximation. sigThumbnailReady() is emitted when
+ * new thumbnails arrive.
+ *
+ * Every entry remembers QImage::cacheKey() of the source image it was
+ * created from, so when the image of the preset changes, the entry is
+ * considered stale and is regenerated.
+ */
+class KRITAUI_EXPORT KisPresetThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    KisPresetThumbnailCache();
+    ~KisPresetThumbnailCache() override;
+
+    static KisPresetThumbnailCache* instance();
+
+    /**
+     * \return the thumbnail of \p preset scaled to \p size or a null
+     *         image if it is not ready yet. In the latter case the
+     *         thumbnail is scheduled for generation.
+     */
+    QImage thumbnail(KisPaintOpPreset *preset, const QSize &size, Qt::AspectRatioMode mode);
+
+    /**
+     * Schedules generation of the thumbnail if it is not present in
+     * the cache. Used for the cells that are not visible yet.
+     */
+    void prefetch(KisPaintOpPreset *preset, const QSize &size, Qt::AspectRatioMode mode);
+
+Q_SIGNALS:
+    void sigThumbnailReady();
+
+private Q_SLOTS:
+    void slotThumbnailScaled();
+
+private:
+    struct Private;
+    const QScopedPointer<Private> m_d;
+};
+
+#endif /* __KIS_PRESET_THUMBNAIL_CACHE_H */